@@ -0,0 +1,60 @@
+#ifndef COSC522_LODI_ID_SET_H
+#define COSC522_LODI_ID_SET_H
+#include <stdbool.h>
+
+/**
+ * Defines the interface for a compact set of unsigned int ids, e.g. a user's followers.
+ */
+typedef struct IdSet {
+  int count; // number of ids in the set
+
+  /**
+   * Adds an id. Adding an id that's already in the set does nothing.
+   *
+   * @param set Base set
+   * @param id Id to add
+   * @return SUCCESS or ERROR
+   */
+  int (*add)(struct IdSet *set, unsigned int id);
+
+  /**
+   * Removes an id.
+   *
+   * @param set Base set
+   * @param id Id to remove
+   * @return SUCCESS, or NOT_FOUND if it isn't in the set
+   */
+  int (*remove)(struct IdSet *set, unsigned int id);
+
+  /**
+   * @param set Base set
+   * @param id Id to look for
+   * @return whether the id is in the set
+   */
+  bool (*contains)(struct IdSet *set, unsigned int id);
+
+  /**
+   * Copies the ids out in ascending order.
+   *
+   * @param set Base set
+   * @param ids Output, room for count ids
+   */
+  void (*toArray)(struct IdSet *set, unsigned int *ids);
+
+  /**
+   * Deallocates the set.
+   *
+   * @param set To destroy
+   */
+  void (*destroy)(struct IdSet **set);
+} IdSet;
+
+/**
+ * Creates a new, empty IdSet.
+ *
+ * @param set The new IdSet
+ * @return SUCCESS or ERROR
+ */
+int createIdSet(IdSet **set);
+
+#endif
@@ -16,7 +16,7 @@ typedef struct IntMap {
   int (*get)(struct IntMap *map, unsigned int key, void **element);
 
   /**
-   * Adds an element.
+   * Adds an element, replacing the element already stored under key, if any. The replaced element is not freed.
    *
    * @param map Base map to operate on
    * @param key Element's key
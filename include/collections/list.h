@@ -1,9 +1,19 @@
 #ifndef COSC522_LODI_LINKED_LIST_H
 #define COSC522_LODI_LINKED_LIST_H
+#include <stdbool.h>
 #include <stddef.h>
 
 /**
- * Defines the interface for the Linked List
+ * Position of an iteration over a List. Start one with LIST_CURSOR_START.
+ */
+typedef struct ListCursor {
+  int index; // index of the element the next call to next returns
+} ListCursor;
+
+#define LIST_CURSOR_START ((ListCursor) {0})
+
+/**
+ * Defines the interface for the List, a growable array of caller-owned element pointers
  */
 typedef struct List {
   int length; // length of the list - can't be less than 0
@@ -18,7 +28,7 @@ typedef struct List {
   int (*append)(struct List *list, void *element);
 
   /**
-   * Gets a single element from the list
+   * Gets a single element from the list, in constant time
    *
    * @param list Base list
    * @param element Pointer to stored element
@@ -27,7 +37,8 @@ typedef struct List {
   int (*get)(struct List *list, int idx, void **element);
 
   /**
-   * Removes an item from a list, and optionally frees its memory. Optionally retrieves the element for the caller.
+   * Removes an item from a list, shifting the elements after it down to keep their order. The element itself is not
+   * freed. Optionally retrieves the element for the caller.
    *
    * @param list Base list
    * @param element Optional pointer to stored element. If non-null, the caller must manage the lifecycle of the element.
@@ -35,6 +46,48 @@ typedef struct List {
    */
   int (*remove)(struct List *list, int idx, void **element);
 
+  /**
+   * Removes an item from a list in constant time by moving the last element into its place, for lists whose order
+   * doesn't matter. The element itself is not freed.
+   *
+   * @param list Base list
+   * @param element Optional pointer to stored element. If non-null, the caller must manage the lifecycle of the element.
+   * @return SUCCESS or ERROR
+   */
+  int (*swapRemove)(struct List *list, int idx, void **element);
+
+  /**
+   * Advances a cursor, e.g. while (list->next(list, &cursor, &element)) { ... }
+   *
+   * @param list Base list
+   * @param cursor Iteration position, advanced past the returned element
+   * @param element Pointer to the next stored element
+   * @return true if an element was returned, false once the cursor is past the end
+   */
+  bool (*next)(struct List *list, ListCursor *cursor, void **element);
+
+  /**
+   * Removes the element the cursor last returned, keeping the order of the rest. The iteration carries on with the
+   * element that followed it.
+   *
+   * @param list Base list
+   * @param cursor Iteration position
+   * @param element Optional pointer to stored element. If non-null, the caller must manage the lifecycle of the element.
+   * @return SUCCESS, or ERROR if the cursor hasn't returned an element
+   */
+  int (*removeCurrent)(struct List *list, ListCursor *cursor, void **element);
+
+  /**
+   * Removes the element the cursor last returned by moving the last element into its place. The iteration carries on
+   * with the moved element, so every element is still visited exactly once.
+   *
+   * @param list Base list
+   * @param cursor Iteration position
+   * @param element Optional pointer to stored element. If non-null, the caller must manage the lifecycle of the element.
+   * @return SUCCESS, or ERROR if the cursor hasn't returned an element
+   */
+  int (*swapRemoveCurrent)(struct List *list, ListCursor *cursor, void **element);
+
   /**
   * Deallocates the list.
   *
@@ -45,9 +98,9 @@ typedef struct List {
 } List;
 
 /**
- * Creates a new Linked List.
+ * Creates a new List.
  *
- * @param list The new Linked List
+ * @param list The new List
  * @return SUCCESS or ERROR
  */
 int createList(List **list);
@@ -0,0 +1,52 @@
+#ifndef COSC522_LODI_MPSC_QUEUE_H
+#define COSC522_LODI_MPSC_QUEUE_H
+
+/**
+ * Link embedded in every element of an MpscQueue. The queue never allocates - elements are owned by the caller, and
+ * handed over to the consumer by pop().
+ */
+typedef struct MpscNode {
+  struct MpscNode *next;
+} MpscNode;
+
+/**
+ * Defines the interface for an intrusive, lock-free, multi-producer single-consumer FIFO queue.
+ */
+typedef struct MpscQueue {
+  /**
+   * Appends an element. Safe to call from any thread.
+   *
+   * @param queue Base queue to append to
+   * @param node Element's embedded link
+   */
+  void (*push)(struct MpscQueue *queue, MpscNode *node);
+
+  /**
+   * Removes the oldest element. May only be called from the queue's single consumer thread.
+   *
+   * A producer that has been preempted midway through push() briefly hides the elements behind its own, in which case
+   * NOT_FOUND is returned - producers are expected to notify the consumer after pushing, so it will come back for them.
+   *
+   * @param queue Base queue
+   * @param node The removed element
+   * @return SUCCESS or NOT_FOUND
+   */
+  int (*pop)(struct MpscQueue *queue, MpscNode **node);
+
+  /**
+   * Deallocates the queue. Elements still queued are not freed.
+   *
+   * @param queue To destroy
+   */
+  void (*destroy)(struct MpscQueue **queue);
+} MpscQueue;
+
+/**
+ * Creates a new MpscQueue.
+ *
+ * @param queue The new queue
+ * @return SUCCESS or ERROR
+ */
+int createMpscQueue(MpscQueue **queue);
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * Macro-generated containers that store their values inline, for elements small enough that List and IntMap's
+ * pointer-per-element layout costs more than the element itself: a malloc'd unsigned int is 4 bytes of data behind an
+ * 8-byte pointer and a 16-byte allocation header.
+ *
+ * DEFINE_VECTOR(Name, prefix, Type) generates a growable array of Type:
+ *   Name vector = {0};
+ *   prefixAppend(&vector, value), prefixRemove(&vector, idx), prefixSwapRemove(&vector, idx), prefixDestroy(&vector)
+ *
+ * DEFINE_U32_MAP(Name, prefix, Type) generates an unsigned int -> Type hash table, open-addressed with linear probing:
+ *   Name map = {0};
+ *   prefixGet(&map, key) - pointer to the stored value or NULL, valid until the next prefixPut or prefixRemove
+ *   prefixPut(&map, key, value), prefixRemove(&map, key), prefixDestroy(&map)
+ *
+ * Neither is thread-safe. U32Map, the unsigned int -> unsigned int instantiation, is defined here; others are defined
+ * next to their one user.
+ */
+
+#ifndef COSC522_LODI_SPECIALIZED_H
+#define COSC522_LODI_SPECIALIZED_H
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared.h"
+
+#define SPECIALIZED_INITIAL_CAPACITY 8
+
+#define DEFINE_VECTOR(Name, prefix, Type) \
+  typedef struct Name { \
+    Type *items; \
+    int length; \
+    int capacity; \
+  } Name; \
+  \
+  /** @return SUCCESS, or ERROR if the vector couldn't grow */ \
+  static inline int prefix##Append(Name *vector, const Type value) { \
+    if (vector->length == vector->capacity) { \
+      const int capacity = vector->capacity == 0 ? SPECIALIZED_INITIAL_CAPACITY : vector->capacity * 2; \
+      Type *items = realloc(vector->items, capacity * sizeof(Type)); \
+      if (items == NULL) { \
+        return ERROR; \
+      } \
+      vector->items = items; \
+      vector->capacity = capacity; \
+    } \
+    vector->items[vector->length++] = value; \
+    return SUCCESS; \
+  } \
+  \
+  /** Removes the value at idx, shifting the values after it down. @return SUCCESS or ERROR */ \
+  static inline int prefix##Remove(Name *vector, const int idx) { \
+    if (idx < 0 || idx >= vector->length) { \
+      return ERROR; \
+    } \
+    vector->length--; \
+    memmove(&vector->items[idx], &vector->items[idx + 1], (vector->length - idx) * sizeof(Type)); \
+    return SUCCESS; \
+  } \
+  \
+  /** Removes the value at idx by moving the last value into its place. @return SUCCESS or ERROR */ \
+  static inline int prefix##SwapRemove(Name *vector, const int idx) { \
+    if (idx < 0 || idx >= vector->length) { \
+      return ERROR; \
+    } \
+    vector->items[idx] = vector->items[--vector->length]; \
+    return SUCCESS; \
+  } \
+  \
+  static inline void prefix##Destroy(Name *vector) { \
+    free(vector->items); \
+    *vector = (Name) {0}; \
+  }
+
+#define DEFINE_U32_MAP(Name, prefix, Type) \
+  typedef struct Name##Entry { \
+    unsigned int key; \
+    unsigned int isUsed; \
+    Type value; \
+  } Name##Entry; \
+  \
+  typedef struct Name { \
+    Name##Entry *entries; \
+    unsigned int capacity; /* a power of 2 */ \
+    unsigned int count; \
+  } Name; \
+  \
+  static inline unsigned int prefix##Home(const Name *map, const unsigned int key) { \
+    return (key * 2654435769u) >> (32 - __builtin_ctz(map->capacity)); \
+  } \
+  \
+  static inline Type *prefix##Get(const Name *map, const unsigned int key) { \
+    if (map->entries == NULL) { \
+      return NULL; \
+    } \
+    const unsigned int mask = map->capacity - 1; \
+    for (unsigned int i = prefix##Home(map, key); map->entries[i].isUsed; i = (i + 1) & mask) { \
+      if (map->entries[i].key == key) { \
+        return &map->entries[i].value; \
+      } \
+    } \
+    return NULL; \
+  } \
+  \
+  static inline void prefix##Insert(Name *map, const unsigned int key, const Type value) { \
+    const unsigned int mask = map->capacity - 1; \
+    unsigned int i = prefix##Home(map, key); \
+    while (map->entries[i].isUsed) { \
+      i = (i + 1) & mask; \
+    } \
+    map->entries[i] = (Name##Entry) {.key = key, .isUsed = 1, .value = value}; \
+    map->count++; \
+  } \
+  \
+  /** Stores value under key, replacing any value already stored. @return SUCCESS, or ERROR if the map couldn't grow */ \
+  static inline int prefix##Put(Name *map, const unsigned int key, const Type value) { \
+    Type *stored = prefix##Get(map, key); \
+    if (stored != NULL) { \
+      *stored = value; \
+      return SUCCESS; \
+    } \
+    if ((map->count + 1) * 4 > map->capacity * 3) { /* keep probes short by growing at 3/4 load */ \
+      const Name old = *map; \
+      map->capacity = old.capacity == 0 ? SPECIALIZED_INITIAL_CAPACITY : old.capacity * 2; \
+      map->entries = calloc(map->capacity, sizeof(Name##Entry)); \
+      if (map->entries == NULL) { \
+        *map = old; \
+        return ERROR; \
+      } \
+      map->count = 0; \
+      for (unsigned int i = 0; i < old.capacity; i++) { \
+        if (old.entries[i].isUsed) { \
+          prefix##Insert(map, old.entries[i].key, old.entries[i].value); \
+        } \
+      } \
+      free(old.entries); \
+    } \
+    prefix##Insert(map, key, value); \
+    return SUCCESS; \
+  } \
+  \
+  /** @return SUCCESS, or NOT_FOUND if nothing is stored under key */ \
+  static inline int prefix##Remove(Name *map, const unsigned int key) { \
+    Type *stored = prefix##Get(map, key); \
+    if (stored == NULL) { \
+      return NOT_FOUND; \
+    } \
+    /* backward-shift the entries after the hole that would otherwise no longer be reachable from their home */ \
+    const unsigned int mask = map->capacity - 1; \
+    unsigned int hole = (Name##Entry *) ((char *) stored - offsetof(Name##Entry, value)) - map->entries; \
+    for (unsigned int i = (hole + 1) & mask; map->entries[i].isUsed; i = (i + 1) & mask) { \
+      const unsigned int home = prefix##Home(map, map->entries[i].key); \
+      if (((i - home) & mask) >= ((i - hole) & mask)) { \
+        map->entries[hole] = map->entries[i]; \
+        hole = i; \
+      } \
+    } \
+    map->entries[hole].isUsed = 0; \
+    map->count--; \
+    return SUCCESS; \
+  } \
+  \
+  static inline void prefix##Destroy(Name *map) { \
+    free(map->entries); \
+    *map = (Name) {0}; \
+  }
+
+DEFINE_U32_MAP(U32Map, u32Map, unsigned int)
+
+#endif
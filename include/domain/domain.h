@@ -11,6 +11,7 @@
 
 #include "collections/list.h"
 #include "domain/domain.h"
+#include "domain/timer_wheel.h"
 #include "util/network.h"
 
 
@@ -24,6 +25,17 @@
 
 #define DEFAULT_TIMEOUT_MS 500
 
+#define DEFAULT_OUTPUT_HIGH_WATERMARK 64
+
+/**
+ * What a Stream server does with a new outbound message when a client's output queue is full.
+ */
+enum SlowConsumerPolicy {
+  DROP_OLDEST, // discard the oldest queued message that hasn't started transmitting
+  COALESCE, // overwrite the newest queued message that hasn't started transmitting
+  DISCONNECT // close the client's connection
+};
+
 /**
  * Responsible for serializing user struct into network-portable bytes
  */
@@ -38,6 +50,15 @@ typedef struct MessageSerializer {
   * @return MESSAGE_SERIALIZER_SUCCESS or MESSAGE_SERIALIZER_FAILURE
   */
   int (*serializer)(void *input, char *output);
+
+  /**
+  * Optional - overwrites the userID of an already serialized message, letting DomainServer#broadcast address each
+  * recipient's copy without serializing it again.
+  *
+  * @param output Serialized bytes, size is messageSize
+  * @param userID userID to write
+  */
+  void (*userIDPatcher)(char *output, unsigned int userID);
 } MessageSerializer;
 
 typedef struct MessageDeserializer {
@@ -55,7 +76,8 @@ typedef struct MessageDeserializer {
 typedef struct {
   unsigned int messageType; /* placeholder for implementations */
   unsigned int userID; /* user identifier, common to all messages*/
-  // struct may have arbitrary fields contiguously in memory after the userID
+  unsigned int requestID; /* correlates a response with its request, 0 if the message isn't part of one */
+  // struct may have arbitrary fields contiguously in memory after the requestID
 } UserMessage;
 
 /**
@@ -68,6 +90,12 @@ typedef struct DomainServiceOpts {
   enum ConnectionType connectionType; // required
   MessageSerializer outgoingSerializer; // required
   MessageDeserializer incomingDeserializer; // required
+  int outputHighWatermark; // optional, Stream servers only - max messages queued per client
+  int outputLowWatermark; // optional, Stream servers only - depth at which a full queue has drained, default high/4
+  enum SlowConsumerPolicy slowConsumerPolicy; // optional, Stream servers only
+  bool reusePort; // optional, servers only - lets several servers in one process share the local port
+  int idleTimeoutMs; // optional, Stream servers only - connections with no traffic for this long are closed
+  int responseCacheTtlMs; // optional, Datagram servers only - how long responses are kept to answer retransmits
 } DomainServiceOpts;
 
 /**
@@ -87,9 +115,12 @@ typedef struct DomainService {
   enum ConnectionType connectionType;
   struct sockaddr_in localAddr;
   struct timeval receiveTimeout;
+  bool reusePort;
 
   MessageSerializer outgoingSerializer;
   MessageDeserializer incomingDeserializer;
+  char *serializeBuffer; // owned by the service, outgoingSerializer.messageSize bytes
+  char *deserializeBuffer; // owned by the service, incomingDeserializer.messageSize bytes
 
   /**
    * Starts the service, putting it in a state where it can start processing messages
@@ -143,6 +174,47 @@ typedef struct DomainClient {
   *         server has been closed by the server.
   */
   int (*receive)(struct DomainClient *self, UserMessage *receivedOut);
+
+  /**
+  * Sends a request and waits for its response, retransmitting with exponential backoff until it arrives or the
+  * client's receive timeout (DEFAULT_TIMEOUT_MS if it has none) runs out. The request is tagged with a fresh
+  * requestID, and responses carrying any other requestID are discarded.
+  *
+  * A DATAGRAM server only handles a retransmitted request once if it has a response cache - see responseCacheTtlMs.
+  *
+  * @param self specific client instance
+  * @param request Input message to be sent to the server, its requestID is assigned by the call
+  * @param responseOut Caller-allocated space for the response
+  * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
+  */
+  int (*request)(struct DomainClient *self, UserMessage *request, UserMessage *responseOut);
+
+  /**
+  * Sends a request without waiting for its response, which is delivered by DomainClient#receiveAvailable. Until then,
+  * the request is retransmitted with exponential backoff by timers on the given wheel, and after timeoutMs it's given
+  * up on - the caller is expected to time it out too. Responses to requests that are no longer outstanding are
+  * discarded by DomainClient#receiveAvailable, so each request is answered at most once. Only supported by DATAGRAM
+  * clients.
+  *
+  * @param self specific client instance
+  * @param request Input message to be sent to the server, its requestID is assigned by the call
+  * @param timers wheel of the event loop that receives the response
+  * @param timeoutMs how long to keep retransmitting
+  * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
+  */
+  int (*submit)(struct DomainClient *self, UserMessage *request, TimerWheel *timers, int timeoutMs);
+
+  /**
+  * Receives a message from the client's server only if one has already arrived, never blocking. Lets an event loop
+  * watching the client's socket drain its replies. Responses to requests that aren't outstanding, having already been
+  * answered or given up on, are skipped. Only supported by DATAGRAM clients.
+  *
+  * @param self specific client instance
+  * @param receivedOut Caller-allocated space for the message received from the server
+  * @return DOMAIN_SUCCESS when a message has been received and deserialized, WOULD_BLOCK when no message is waiting,
+  *         or DOMAIN_FAILURE when a message was consumed but couldn't be received or deserialized
+  */
+  int (*receiveAvailable)(struct DomainClient *self, UserMessage *receivedOut);
 } DomainClient;
 
 /**
@@ -152,8 +224,20 @@ typedef struct ClientHandle {
   unsigned int userID; // OPTIONAL - will be set to NO_USER if the userID is unknown
   struct sockaddr_in clientAddr; // client's network address details
   int clientSock; // OPTIONAL - only used if ConnectionType is STREAM
+  unsigned int connectionID; // OPTIONAL - only used if ConnectionType is STREAM, tells apart connections reusing a socket
 } ClientHandle;
 
+struct DomainServer;
+
+/**
+ * Callback for a file descriptor watched by a DomainServer's event loop.
+ *
+ * @param server server whose event loop observed the descriptor becoming readable
+ * @param fd the watched descriptor
+ * @param context caller-supplied context
+ */
+typedef void (*DomainWatchHandler)(struct DomainServer *server, int fd, void *context);
+
 /**
  * Interface for interacting with a Datagram or Stream server.
  */
@@ -161,9 +245,20 @@ typedef struct DomainServer {
   DomainService base;
   List *clients;
 
+  /**
+  * Timers belonging to the server's event loop, created along with the server. The loop wakes for the next timer as
+  * well as for messages and expires due timers from within DomainServer#receive or DomainServer#receiveBatch, on the
+  * thread that's receiving, so timers should only be scheduled or cancelled from that thread - e.g. from a watch
+  * handler, a timer handler, or between receives. A receive timeout still applies to the call as a whole.
+  */
+  TimerWheel *timers;
+
   /**
   * Sends a message to the client represented by a ClientHandle.
   *
+  * If server's ConnectionType is STREAM, the message is appended to the client's output queue and written as the
+  * socket allows, so the call never blocks; once the queue is full the server's SlowConsumerPolicy applies.
+  *
   * @param self specific server instance
   * @param message Input message to be sent to the client
   * @param clientHandle Client details
@@ -171,6 +266,39 @@ typedef struct DomainServer {
   */
   int (*send)(struct DomainServer *self, UserMessage *message, ClientHandle *clientHandle);
 
+  /**
+  * Sends several messages, each to its own client. If server's ConnectionType is DATAGRAM, the messages are written
+  * with a single system call.
+  *
+  * A STREAM server writes consecutive messages for the same client with one gathered write. Instead of applying the
+  * SlowConsumerPolicy it stops at the first message whose client's output queue is full, leaving the rest unsent;
+  * DomainServer#onDrained is called once that client has caught up.
+  *
+  * @param self specific server instance
+  * @param messages Array of messageCount messages
+  * @param messageStride Size of each element of messages
+  * @param clientHandles Array of messageCount ClientHandles, the recipient of each message
+  * @param messageCount Number of messages to send
+  * @param sentCountOut Number of messages sent
+  * @return DOMAIN_SUCCESS if every message was sent, otherwise DOMAIN_FAILURE
+  */
+  int (*sendBatch)(struct DomainServer *self, void *messages, size_t messageStride, ClientHandle *clientHandles,
+                   int messageCount, int *sentCountOut);
+
+  /**
+  * Sends one message to many clients, serializing it only once. If the outgoing serializer has a userIDPatcher, each
+  * recipient's copy is addressed to the recipient's userID, otherwise every recipient is sent identical bytes.
+  *
+  * @param self specific server instance
+  * @param message Input message to be sent
+  * @param clientHandles Array of recipientCount ClientHandles
+  * @param recipientCount Number of recipients
+  * @param sentCountOut Number of recipients the message was sent to
+  * @return DOMAIN_SUCCESS if every recipient was sent the message, otherwise DOMAIN_FAILURE
+  */
+  int (*broadcast)(struct DomainServer *self, UserMessage *message, ClientHandle *clientHandles, int recipientCount,
+                   int *sentCountOut);
+
   /**
   * Receives inbound messages from a client.
   *
@@ -180,9 +308,58 @@ typedef struct DomainServer {
   * @return DOMAIN_SUCCESS when a message has been successfully received and deserialized
   *         DOMAIN_FAILURE when message reception or deserialization has failed
   *         If server's ConnectionType is STREAM, TERMINATED may be returned when persistent connection has been closed
-  *         by the client.
+  *         by the client, or closed by the server after idleTimeoutMs without traffic.
   */
   int (*receive)(struct DomainServer *self, UserMessage *receivedOut, ClientHandle *clientCallbackOut);
+
+  /**
+  * Receives as many inbound messages as are available, up to maxMessages, blocking only until the first arrives.
+  *
+  * If server's ConnectionType is DATAGRAM, the messages are pulled in with a single system call. A STREAM server
+  * returns one message per call, and TERMINATED as DomainServer#receive does.
+  *
+  * @param self specific server instance
+  * @param receivedOut Caller-allocated array of maxMessages messages
+  * @param messageStride Size of each element of receivedOut
+  * @param clientCallbacksOut Caller-allocated array of maxMessages ClientHandles, one per message received
+  * @param maxMessages Capacity of the arrays
+  * @param receivedCountOut Number of messages received - datagrams that fail to deserialize are skipped
+  * @return DOMAIN_SUCCESS, DOMAIN_FAILURE, or TERMINATED
+  */
+  int (*receiveBatch)(struct DomainServer *self, void *receivedOut, size_t messageStride,
+                      ClientHandle *clientCallbacksOut, int maxMessages, int *receivedCountOut);
+
+  /**
+  * Adds a descriptor to the server's event loop. Whenever it becomes readable, the handler is called from within
+  * DomainServer#receive or DomainServer#receiveBatch, on the thread that's receiving. A STREAM server's loop is
+  * edge-triggered, so the handler should consume everything that's available. A DATAGRAM server can watch up to 8
+  * descriptors.
+  *
+  * @param self specific server instance
+  * @param fd descriptor to watch
+  * @param onReadable handler to call
+  * @param context passed through to the handler
+  * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
+  */
+  int (*watch)(struct DomainServer *self, int fd, DomainWatchHandler onReadable, void *context);
+
+  /**
+  * Removes a descriptor previously added with DomainServer#watch.
+  *
+  * @param self specific server instance
+  * @param fd descriptor to stop watching
+  * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
+  */
+  int (*unwatch)(struct DomainServer *self, int fd);
+
+  /**
+  * Optional, set by the caller. A STREAM server calls it from within DomainServer#receive once a client's output queue
+  * has filled up and then drained to the low watermark, e.g. to resume a DomainServer#sendBatch that was cut short.
+  *
+  * @param self specific server instance
+  * @param clientHandle client whose queue has drained
+  */
+  void (*onDrained)(struct DomainServer *self, const ClientHandle *clientHandle);
 } DomainServer;
 
 /**
@@ -10,11 +10,11 @@
 
 #define LODI_MESSAGE_LENGTH 100
 
-#define LODI_CLIENT_REQUEST_SIZE ((3 * sizeof(uint32_t) + 2 * sizeof(uint64_t)) + LODI_MESSAGE_LENGTH * sizeof(char))
-#define LODI_SERVER_RESPONSE_SIZE ((3 * sizeof(uint32_t)) + LODI_MESSAGE_LENGTH * sizeof(char))
+#define LODI_CLIENT_REQUEST_SIZE ((4 * sizeof(uint32_t) + 2 * sizeof(uint64_t)) + LODI_MESSAGE_LENGTH * sizeof(char))
+#define LODI_SERVER_RESPONSE_SIZE ((4 * sizeof(uint32_t)) + LODI_MESSAGE_LENGTH * sizeof(char))
 
 enum LodiClientMessageType {
-  login, post, feed, follow, unfollow, logout
+  login, post, feed, follow, unfollow, logout, resume
 };
 
 enum LodiServerMessageType {
@@ -24,19 +24,40 @@ enum LodiServerMessageType {
 typedef struct {
   enum LodiServerMessageType messageType; /* same size as an unsigned int */
   unsigned int userID; /* user identifier */
+  unsigned int requestID; /* requestID of the request being answered, 0 for feed messages */
   unsigned int recipientID;
-  char message[100]; /* text message*/
+  char message[100]; /* text message, or an ackLogin's resumption ticket */
 } LodiServerMessage;
 
 typedef struct {
   enum LodiClientMessageType messageType;
   unsigned int userID; /* user identifier */
+  unsigned int requestID; /* chosen by the client, echoed in the response */
   unsigned int recipientID; /* message recipient identifier */
-  unsigned long timestamp; /* timestamp */
-  unsigned long digitalSig; /* encrypted timestamp */
+  unsigned long timestamp; /* timestamp, or a resume's ticketExpiry */
+  unsigned long digitalSig; /* encrypted timestamp, or a resume's ticketMac */
   char message[100]; /* text message*/
 } PClientToLodiServer;
 
+/**
+ * Writes a resumption ticket into an ackLogin, which has no text to send, as two big-endian u64s at the start of its
+ * message. Every other response stays the same size.
+ *
+ * @param response ackLogin to write the ticket into
+ * @param expiry the ticket's expiry
+ * @param mac the ticket's MAC
+ */
+void setLoginTicket(LodiServerMessage *response, unsigned long expiry, unsigned long mac);
+
+/**
+ * Reads the resumption ticket written by setLoginTicket.
+ *
+ * @param response ackLogin carrying the ticket
+ * @param expiryOut the ticket's expiry
+ * @param macOut the ticket's MAC
+ */
+void getLoginTicket(const LodiServerMessage *response, unsigned long *expiryOut, unsigned long *macOut);
+
 int initLodiClient(DomainClient **domainClient);
 
 int initLodiServer(DomainServer **server);
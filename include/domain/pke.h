@@ -6,21 +6,25 @@
 #ifndef COSC522_LODI_PKEMESSAGING_H
 #define COSC522_LODI_PKEMESSAGING_H
 
-#define PK_CLIENT_REQUEST_SIZE (3 * sizeof(uint32_t))
-#define PK_SERVER_RESPONSE_SIZE (3 * sizeof(uint32_t))
+#define PK_CLIENT_REQUEST_SIZE (4 * sizeof(uint32_t))
+#define PK_SERVER_RESPONSE_SIZE (4 * sizeof(uint32_t))
+
+#define PK_SUBSCRIPTION_TTL_MS 60000 // a subscribeKeys must be repeated within this long to keep receiving invalidateKey
 #include "domain/domain.h"
 
 typedef struct {
-  enum { ackRegisterKey, responsePublicKey, ackPKFail} messageType; /* same as unsigned int */
+  enum { ackRegisterKey, responsePublicKey, ackPKFail, invalidateKey } messageType; /* same as unsigned int */
   unsigned int userID; /* user identifier or user identifier of requested public key*/
+  unsigned int requestID; /* requestID of the request being answered, 0 for invalidateKey */
   unsigned int publicKey; /* registered public key or requested public key */
 } PKServerToLodiClient;
 
 typedef PKServerToLodiClient PKServerToPClientOrLodiServer;
 
 typedef struct {
-  enum { registerKey, requestKey } messageType; /* same size as an unsigned int */
-  unsigned int userID; /* user's identifier or requested user identifier*/
+  enum { registerKey, requestKey, subscribeKeys } messageType; /* same size as an unsigned int */
+  unsigned int userID; /* user's identifier or requested user identifier, 0 for subscribeKeys */
+  unsigned int requestID; /* chosen by the client, echoed in the response - 0 for subscribeKeys, which has none */
   unsigned int publicKey; /* user's public key or 0 if message_type is request_key */
 } PClientToPKServer;
 
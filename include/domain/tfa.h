@@ -6,13 +6,16 @@
 #ifndef COSC522_LODI_TFAMESSAGING_H
 #define COSC522_LODI_TFAMESSAGING_H
 
-#define TFA_CLIENT_REQUEST_SIZE (2 * sizeof(uint32_t) + 2 * sizeof(uint64_t))
-#define TFA_SERVER_RESPONSE_SIZE (2 * sizeof(uint32_t))
+#define TFA_CLIENT_REQUEST_SIZE (3 * sizeof(uint32_t) + 2 * sizeof(uint64_t))
+#define TFA_SERVER_RESPONSE_SIZE (3 * sizeof(uint32_t))
+
+#define TFA_PUSH_TIMEOUT_MS 10000 // a person has to approve the push on their TFA client
 #include "domain/domain.h"
 
 typedef struct {
   enum { registerTFA, ackRegTFA, ackPushTFA, requestAuth } messageType; /* same size as an unsigned int */
   unsigned int userID; /* user identifier */
+  unsigned int requestID; /* chosen by the sender, echoed in the response - 0 for ackPushTFA, which has none */
   unsigned long timestamp; /* timestamp */
   unsigned long digitalSig; /* encrypted timestamp */
 } TFAClientOrLodiServerToTFAServer;
@@ -20,11 +23,13 @@ typedef struct {
 typedef struct {
   enum { confirmTFA, pushTFA, tfaFailure} messageType; /* same as unsigned int */
   unsigned int userID; /* user identifier*/
+  unsigned int requestID; /* requestID of the request being answered, 0 for pushTFA */
 } TFAServerToTFAClient;
 
 typedef struct {
   enum { responseAuth } messageType; /* same size as an unsigned int */
   unsigned int userID; /* user's identifier or requested user identifier*/
+  unsigned int requestID; /* requestID of the requestAuth being answered */
 } TFAServerToLodiServer;
 
 int initTfaClient(DomainClient **client);
@@ -0,0 +1,112 @@
+/**
+ * Hierarchical timing wheel for per-request deadlines: call timeouts, retransmit schedules, approval expiry and idle
+ * connection reaping. Scheduling and cancelling a timer are O(1), as is advancing past a tick with nothing due, so an
+ * event loop can keep one timer per request no matter how many requests are outstanding.
+ *
+ * Timers are intrusive - the caller embeds a Timer in whatever it's tracking, so the wheel never allocates.
+ * Deadlines are absolute milliseconds on the clock returned by monotonicMs.
+ */
+
+#ifndef COSC522_LODI_TIMER_WHEEL_H
+#define COSC522_LODI_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOTS 64 // per level; a level's slot spans every slot of the level below
+
+struct TimerWheel;
+struct Timer;
+
+/**
+ * Called once a timer's deadline has passed. The timer is no longer scheduled, so the handler may schedule it again or
+ * free the struct embedding it.
+ *
+ * @param wheel wheel the timer was scheduled on
+ * @param timer the expired timer
+ * @param context passed through from TimerWheel#schedule
+ */
+typedef void (*TimerHandler)(struct TimerWheel *wheel, struct Timer *timer, void *context);
+
+/**
+ * A single timer, embedded by the caller. Must be zeroed before its first use.
+ */
+typedef struct Timer {
+  uint64_t deadlineMs;
+  TimerHandler onExpired;
+  void *context;
+  struct Timer *previous; // links within the wheel slot the timer is filed under
+  struct Timer *next;
+  struct Timer **slot; // NULL while the timer isn't scheduled
+} Timer;
+
+/**
+ * Interface for a timer wheel. Not thread-safe - a wheel belongs to the event loop that advances it.
+ */
+typedef struct TimerWheel {
+  int length; // number of scheduled timers
+
+  /**
+   * Schedules a timer, rescheduling it if it's already scheduled. A deadline that has already passed expires on the
+   * next TimerWheel#advance.
+   *
+   * @param self wheel to schedule on
+   * @param timer caller-owned timer, must stay valid until it expires or is cancelled
+   * @param deadlineMs when the timer expires, from monotonicMs
+   * @param onExpired handler to call once it has
+   * @param context passed through to the handler
+   */
+  void (*schedule)(struct TimerWheel *self, Timer *timer, uint64_t deadlineMs, TimerHandler onExpired, void *context);
+
+  /**
+   * Cancels a timer. Does nothing if the timer isn't scheduled.
+   *
+   * @param self wheel the timer was scheduled on
+   * @param timer timer to cancel
+   */
+  void (*cancel)(struct TimerWheel *self, Timer *timer);
+
+  /**
+   * Moves the wheel forward, calling the handler of every timer whose deadline is at or before nowMs, in deadline
+   * order.
+   *
+   * @param self wheel to advance
+   * @param nowMs current time, from monotonicMs
+   * @return number of timers that expired
+   */
+  int (*advance)(struct TimerWheel *self, uint64_t nowMs);
+
+  /**
+   * Tells an event loop how long it can block before the wheel needs advancing again. The wheel may need advancing
+   * before any timer is actually due, to move timers with distant deadlines onto a finer level.
+   *
+   * @param self wheel to inspect
+   * @param nowMs current time, from monotonicMs
+   * @return timeout in ms, or -1 if no timers are scheduled
+   */
+  int (*nextTimeoutMs)(struct TimerWheel *self, uint64_t nowMs);
+
+  /**
+   * Destroys and deallocates a wheel. Timers still scheduled are forgotten without expiring.
+   *
+   * @param self wheel to destroy
+   */
+  void (*destroy)(struct TimerWheel **self);
+} TimerWheel;
+
+/**
+ * Creates a new TimerWheel.
+ *
+ * @param nowMs current time, from monotonicMs
+ * @param wheel Output - points to the new wheel
+ * @return SUCCESS or ERROR
+ */
+int createTimerWheel(uint64_t nowMs, TimerWheel **wheel);
+
+/**
+ * @return milliseconds on CLOCK_MONOTONIC, the clock timer deadlines are measured on
+ */
+uint64_t monotonicMs();
+
+#endif
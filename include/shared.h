@@ -9,5 +9,6 @@
 #define TERMINATED 2
 #define ERROR (-1)
 #define NOT_FOUND (3)
+#define WOULD_BLOCK (4)
 
 #endif
\ No newline at end of file
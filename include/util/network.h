@@ -5,6 +5,9 @@
 #ifndef COSC522_LODI_NETWORK_H
 #define COSC522_LODI_NETWORK_H
 #include <arpa/inet.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #define LOCALHOST "127.0.0.1"
 
@@ -12,7 +15,8 @@ enum ConnectionType {
   STREAM, DATAGRAM
 };
 
-int getSocket(const struct sockaddr_in *address, const struct timeval *timeout, enum ConnectionType connectionType);
+int getSocket(const struct sockaddr_in *address, const struct timeval *timeout, enum ConnectionType connectionType,
+              bool reusePort);
 
 struct sockaddr_in getNetworkAddress(const char *ipAddress, unsigned short serverPort);
 
@@ -21,14 +25,30 @@ int receiveUdpMessage(int socket, char *message, size_t messageSize, struct sock
 int sendUdpMessage(int socket, const char *messageBuffer, size_t messageSize,
                    const struct sockaddr_in *destinationAddress);
 
+int receiveUdpAvailable(int socket, char *message, size_t messageSize, struct sockaddr_in *clientAddress);
+
+int receiveUdpBatch(int socket, struct mmsghdr *messages, unsigned int messageCount);
+
+int sendUdpBatch(int socket, struct mmsghdr *messages, unsigned int messageCount);
+
+int udpConnect(int sock, const struct sockaddr_in *serverAddress);
+
 int tcpConnect(int sock, const struct sockaddr_in *serverAddress);
 
 int tcpListen(int sock);
 
 int tcpAccept(int sock, struct sockaddr_in *clientAddress, int *clientSock);
 
+int setNonBlocking(int sock);
+
 int sendTcpMessage(int socket, const char *messageBuffer, size_t messageSize);
 
 int receiveTcpMessage(int socket, char *message, size_t messageSize);
 
+int sendTcpAvailable(int socket, const struct iovec *segments, int segmentCount, size_t *sent);
+
+int receiveTcpAvailable(int socket, const struct iovec *segments, int segmentCount, size_t *received);
+
+bool isTcpPeerClosed(int socket);
+
 #endif
@@ -3,24 +3,85 @@
  */
 
 #ifndef COSC522_LODI_RSA_H
+#include <stdbool.h>
 
 // TODO remove hard-coding p and q - generate these when necessary
 #define P 1000117
 #define Q 1000151
 #define MODULUS ((unsigned long) P * (unsigned long) Q)
 
+/**
+ * A private key in Chinese Remainder Theorem form, which signs with two exponentiations modulo p and q - each with an
+ * exponent half the length of the private exponent's.
+ */
+typedef struct {
+  unsigned long p;
+  unsigned long q;
+  unsigned long dP; // privateKey mod (p - 1)
+  unsigned long dQ; // privateKey mod (q - 1)
+  unsigned long qInv; // q^-1 mod p
+} CrtPrivateKey;
+
 typedef struct {
   unsigned long private;
   unsigned long public;
   unsigned long modulus;
+  CrtPrivateKey crt;
 } KeyGenResult;
 
 KeyGenResult generateKeys(const unsigned int p, const unsigned int q);
 
+/**
+ * @param privateKey private exponent
+ * @param p prime factor of the modulus
+ * @param q the other prime factor
+ * @return the private key in CRT form
+ */
+CrtPrivateKey toCrtPrivateKey(unsigned long privateKey, unsigned int p, unsigned int q);
+
 unsigned long encryptTimestamp(unsigned long timestamp, unsigned long privateKey, unsigned long modulus);
 
+/**
+ * Encrypts a timestamp with a CRT private key, several times quicker than encryptTimestamp with the same key.
+ *
+ * @param timestamp timestamp to sign
+ * @param key private key, as given by toCrtPrivateKey or generateKeys
+ * @return the same signature encryptTimestamp produces
+ */
+unsigned long encryptTimestampCrt(unsigned long timestamp, const CrtPrivateKey *key);
+
 unsigned long decryptTimestamp(unsigned long encrypted, unsigned long publicKey, unsigned long modulus);
 
+/**
+ * A signature to verify: valid if decrypting digitalSig with publicKey yields timestamp.
+ */
+typedef struct {
+  unsigned long digitalSig;
+  unsigned long publicKey;
+  unsigned long timestamp;
+} SignatureCheck;
+
+/**
+ * Verifies many signatures at once. Their exponentiations are independent, so they're run side by side - in the
+ * 52-bit lanes of AVX-512 IFMA where the CPU supports it, otherwise interleaved on the scalar multiplier - for several
+ * times the throughput of decrypting them one at a time.
+ *
+ * @param checks array of count signatures
+ * @param count number of signatures
+ * @param modulus modulus shared by every key
+ * @param validOut caller-allocated array of count results
+ * @return the number of valid signatures
+ */
+int verifySignatures(const SignatureCheck *checks, int count, unsigned long modulus, bool *validOut);
+
+unsigned long modPow(unsigned long base, unsigned long exponent, unsigned long modulus);
+
+/**
+ * modPow reducing with a 128-bit division after every step - used for moduli Montgomery form can't handle, and as the
+ * baseline rsa_benchmark measures against.
+ */
+unsigned long modPowByDivision(unsigned long base, unsigned long exponent, unsigned long modulus);
+
 #define COSC522_LODI_RSA_H
 
 #endif
@@ -66,7 +66,9 @@ int main() {
             case LOGIN_OPTION:
                 privateKey = getLongInput("private key");
                 time(&timestamp);
-                digitalSignature = encryptTimestamp(timestamp, privateKey, MODULUS);
+                // MODULUS's factors are known, so the CRT form of the key is always available
+                const CrtPrivateKey crtKey = toCrtPrivateKey(privateKey, P, Q);
+                digitalSignature = encryptTimestampCrt(timestamp, &crtKey);
                 unsigned long decrypted = decryptTimestamp(digitalSignature, publicKey, MODULUS);
                 lodiLogin(userID, timestamp, digitalSignature);
                 break;
@@ -112,9 +114,9 @@ int lodiLogout(const unsigned int userID, const unsigned long timestamp, const u
  */
 int registerPublicKey(const unsigned int userID, const unsigned int publicKey) {
     const PClientToPKServer requestMessage = {
-        registerKey,
-        userID,
-        publicKey
+        .messageType = registerKey,
+        .userID = userID,
+        .publicKey = publicKey
     };
     PKServerToLodiClient responseMessage;
     const int status = lodiClientPkeSend(&requestMessage, &responseMessage);
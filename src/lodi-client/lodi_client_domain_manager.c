@@ -4,59 +4,345 @@
 
 #include "lodi_client_domain_manager.h"
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "shared.h"
 #include "domain/domain.h"
 #include "domain/lodi.h"
 #include "domain/pke.h"
 
-static DomainClient *lodiClient = NULL;
+/**
+ * A persistent connection to the Lodi Server. Responses are matched to requests by requestID, so responses that arrive
+ * while waiting on a different request are stashed until their own await.
+ */
+typedef struct {
+  DomainClient *client;
+  bool isStarted;
+  unsigned int epoch; // incremented every time the connection is opened
+  unsigned int nextRequestID;
+  unsigned int inFlight[LODI_CLIENT_MAX_IN_FLIGHT]; // requestIDs submitted but not yet awaited
+  int inFlightCount;
+  LodiServerMessage stash[LODI_CLIENT_MAX_IN_FLIGHT]; // responses received ahead of their await
+  int stashCount;
+} LodiConnection;
+
+/**
+ * The resumption ticket from a user's last ackLogin, and the connection epoch the session it resumes was established
+ * over. Once the connection has been reopened, the ticket is presented to re-establish the session over the new one.
+ */
+typedef struct {
+  bool isSet;
+  unsigned int userID;
+  unsigned long expiry;
+  unsigned long mac;
+  unsigned int epoch;
+} ResumptionTicket;
+
+static LodiConnection pool[LODI_CLIENT_POOL_SIZE];
+static ResumptionTicket tickets[LODI_CLIENT_MAX_TICKETS]; // direct-mapped by userID, a collision only costs a login
 static DomainClient *pkeClient = NULL;
 
+static LodiConnection *getConnection(unsigned int userID);
+
+static int submitOnConnection(LodiConnection *connection, PClientToLodiServer *request, unsigned int *requestIDOut);
+
+static int awaitOnConnection(LodiConnection *connection, unsigned int requestID, LodiServerMessage *outResponse);
+
+static void resumeSession(LodiConnection *connection, unsigned int userID);
+
+static void updateTicket(const LodiConnection *connection, const LodiServerMessage *response);
+
+static ResumptionTicket *findTicket(unsigned int userID);
+
+static int openConnection(LodiConnection *connection);
+
+static void closeConnection(LodiConnection *connection);
+
+static bool isInFlight(const LodiConnection *connection, unsigned int requestID);
+
+static void retire(LodiConnection *connection, unsigned int requestID);
+
 int lodiClientSend(const PClientToLodiServer *inRequest, LodiServerMessage *outResponse) {
-  int status = SUCCESS;
-  if (lodiClient == NULL && initLodiClient(&lodiClient) == ERROR) {
-    printf("Failed to initialize Lodi Client\n");
+  unsigned int requestID;
+  if (lodiClientSubmit(inRequest, &requestID) != SUCCESS) {
     return ERROR;
   }
+  return lodiClientAwait(inRequest->userID, requestID, outResponse);
+}
 
-  if (lodiClient->base.start(&lodiClient->base) == DOMAIN_FAILURE) {
-    printf("Failed to start Lodi Client\n");
+int lodiClientSubmit(const PClientToLodiServer *inRequest, unsigned int *requestIDOut) {
+  LodiConnection *connection = getConnection(inRequest->userID);
+  if (connection == NULL) {
     return ERROR;
-  };
-
-  if (lodiClient->send(lodiClient, (UserMessage *) inRequest) != DOMAIN_SUCCESS) {
-    printf("Failed to send from Lodi Client\n");
-    status = ERROR;
   }
 
-  if (status == SUCCESS && lodiClient->receive(lodiClient, (UserMessage *) outResponse) != DOMAIN_SUCCESS) {
-    printf("Failed to receive from Lodi Client\n");
-    status = ERROR;
+  // the server may have closed an idle connection, e.g. on restart - find out before writing into it
+  if (connection->isStarted && connection->client->isConnected
+      && isTcpPeerClosed(connection->client->base.sock)) {
+    printf("[DEBUG] Lodi connection closed by the server, reconnecting...\n");
+    closeConnection(connection);
+  }
+  if (inRequest->messageType != login && inRequest->messageType != resume) {
+    resumeSession(connection, inRequest->userID);
   }
 
-  if (lodiClient->base.stop(&lodiClient->base) == DOMAIN_FAILURE) {
-    printf("Failed to stop Lodi Client\n");
-    status = ERROR;
+  PClientToLodiServer request = *inRequest;
+  return submitOnConnection(connection, &request, requestIDOut);
+}
+
+int lodiClientAwait(const unsigned int userID, const unsigned int requestID, LodiServerMessage *outResponse) {
+  LodiConnection *connection = getConnection(userID);
+  if (connection == NULL) {
+    return ERROR;
+  }
+  const int status = awaitOnConnection(connection, requestID, outResponse);
+  if (status == SUCCESS) {
+    updateTicket(connection, outResponse);
   }
   return status;
 }
 
+int lodiClientGetTicket(const unsigned int userID, unsigned long *expiryOut, unsigned long *macOut) {
+  const ResumptionTicket *ticket = findTicket(userID);
+  if (ticket == NULL) {
+    return NOT_FOUND;
+  }
+  *expiryOut = ticket->expiry;
+  *macOut = ticket->mac;
+  return SUCCESS;
+}
+
 int lodiClientPkeSend(const PClientToPKServer *inRequest, PKServerToLodiClient *responseOut) {
   if (pkeClient == NULL) {
     initPkeClient(&pkeClient);
   }
 
   pkeClient->base.start(&pkeClient->base);
-  if (pkeClient->send(pkeClient, (UserMessage *) inRequest) == DOMAIN_FAILURE) {
+  PClientToPKServer request = *inRequest;
+  const int status = pkeClient->request(pkeClient, (UserMessage *) &request, (UserMessage *) responseOut);
+  pkeClient->base.stop(&pkeClient->base);
+
+  return status == DOMAIN_SUCCESS ? SUCCESS : ERROR;
+}
+
+/**
+ * Tags a request with the connection's next requestID and sends it, (re)opening the connection if needed.
+ *
+ * @param connection connection to send over
+ * @param request request to send, its requestID is assigned by the call
+ * @param requestIDOut the request's requestID
+ * @return SUCCESS or ERROR
+ */
+static int submitOnConnection(LodiConnection *connection, PClientToLodiServer *request, unsigned int *requestIDOut) {
+  if (connection->inFlightCount + connection->stashCount == LODI_CLIENT_MAX_IN_FLIGHT) {
+    printf("[ERROR] Too many Lodi requests in flight for userID=%u\n", request->userID);
     return ERROR;
   }
 
-  if (pkeClient->receive(pkeClient, (UserMessage *) responseOut) == DOMAIN_FAILURE) {
+  request->requestID = connection->nextRequestID++;
+  if (connection->nextRequestID == 0) {
+    connection->nextRequestID = 1; // 0 is reserved for feed messages
+  }
+
+  // a request that couldn't be written never reached the server, so it's safe to retry on a fresh connection
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (!connection->isStarted && openConnection(connection) == ERROR) {
+      return ERROR;
+    }
+    if (connection->client->send(connection->client, (UserMessage *) request) == DOMAIN_SUCCESS) {
+      connection->inFlight[connection->inFlightCount++] = request->requestID;
+      *requestIDOut = request->requestID;
+      return SUCCESS;
+    }
+    closeConnection(connection);
+  }
+  printf("Failed to send from Lodi Client\n");
+  return ERROR;
+}
+
+/**
+ * Waits for the response to a request submitted over a connection, stashing responses to other requests that arrive
+ * first.
+ *
+ * @param connection connection the request was submitted over
+ * @param requestID as assigned by submitOnConnection
+ * @param outResponse caller-allocated space for the response
+ * @return SUCCESS or ERROR
+ */
+static int awaitOnConnection(LodiConnection *connection, const unsigned int requestID,
+                             LodiServerMessage *outResponse) {
+  for (int i = 0; i < connection->stashCount; i++) {
+    if (connection->stash[i].requestID == requestID) {
+      *outResponse = connection->stash[i];
+      connection->stash[i] = connection->stash[--connection->stashCount];
+      return SUCCESS;
+    }
+  }
+  if (!isInFlight(connection, requestID)) {
+    // never submitted, already awaited, or lost along with a closed connection
+    printf("Failed to receive from Lodi Client, requestID=%u isn't in flight\n", requestID);
     return ERROR;
   }
-  pkeClient->base.stop(&pkeClient->base);
 
+  while (true) {
+    LodiServerMessage response;
+    const int status = connection->client->receive(connection->client, (UserMessage *) &response);
+    if (status == TERMINATED) {
+      printf("Failed to receive from Lodi Client, connection closed by the server\n");
+      closeConnection(connection);
+      return ERROR;
+    }
+    if (status != DOMAIN_SUCCESS) {
+      printf("Failed to receive from Lodi Client\n");
+      // a late response is discarded rather than mistaken for the answer to a later request
+      retire(connection, requestID);
+      return ERROR;
+    }
+    if (response.requestID == requestID) {
+      retire(connection, requestID);
+      *outResponse = response;
+      return SUCCESS;
+    }
+    if (isInFlight(connection, response.requestID)) {
+      retire(connection, response.requestID);
+      connection->stash[connection->stashCount++] = response;
+    } else {
+      printf("[DEBUG] Discarding unexpected Lodi response, requestID=%u\n", response.requestID);
+    }
+  }
+}
+
+/**
+ * Re-establishes a user's session after their connection has been reopened, by presenting the resumption ticket from
+ * their last login. If the ticket is rejected it's dropped, and the user's requests fail until they log in again, as
+ * they would have without one.
+ *
+ * @param connection the user's connection
+ * @param userID user about to make a request
+ */
+static void resumeSession(LodiConnection *connection, const unsigned int userID) {
+  ResumptionTicket *ticket = findTicket(userID);
+  if (ticket == NULL || (connection->isStarted && ticket->epoch == connection->epoch)) {
+    return;
+  }
+  if (ticket->expiry < (unsigned long) time(NULL)) {
+    ticket->isSet = false;
+    return;
+  }
+
+  PClientToLodiServer request = {
+    .messageType = resume,
+    .userID = userID,
+    .timestamp = ticket->expiry,
+    .digitalSig = ticket->mac
+  };
+  unsigned int requestID;
+  LodiServerMessage response;
+  if (submitOnConnection(connection, &request, &requestID) == SUCCESS
+      && awaitOnConnection(connection, requestID, &response) == SUCCESS
+      && response.messageType == ackLogin) {
+    printf("[DEBUG] Resumed Lodi session for userID=%u\n", userID);
+    updateTicket(connection, &response);
+  } else {
+    printf("[WARNING] Failed to resume Lodi session for userID=%u\n", userID);
+    ticket->isSet = false;
+  }
+}
+
+/**
+ * Keeps the ticket issued with an ackLogin, and forgets the user's ticket once they've logged out.
+ *
+ * @param connection connection the response arrived on
+ * @param response response received
+ */
+static void updateTicket(const LodiConnection *connection, const LodiServerMessage *response) {
+  ResumptionTicket *slot = &tickets[response->userID % LODI_CLIENT_MAX_TICKETS];
+  if (response->messageType == ackLogin) {
+    *slot = (ResumptionTicket){
+      .isSet = true,
+      .userID = response->userID,
+      .epoch = connection->epoch
+    };
+    getLoginTicket(response, &slot->expiry, &slot->mac);
+  } else if (response->messageType == ackLogout && slot->userID == response->userID) {
+    slot->isSet = false;
+  }
+}
+
+/**
+ * @param userID user to find the ticket of
+ * @return the user's ticket, or NULL if they don't hold one
+ */
+static ResumptionTicket *findTicket(const unsigned int userID) {
+  ResumptionTicket *ticket = &tickets[userID % LODI_CLIENT_MAX_TICKETS];
+  return ticket->isSet && ticket->userID == userID ? ticket : NULL;
+}
+
+/**
+ * Gets the pooled connection for a user, creating its client on first use. A user always maps to the same connection,
+ * so their requests are processed by the server in the order they're submitted.
+ *
+ * @param userID user making the request
+ * @return the connection, or NULL if its client couldn't be created
+ */
+static LodiConnection *getConnection(const unsigned int userID) {
+  LodiConnection *connection = &pool[userID % LODI_CLIENT_POOL_SIZE];
+  if (connection->client == NULL) {
+    if (initLodiClient(&connection->client) == ERROR) {
+      printf("Failed to initialize Lodi Client\n");
+      return NULL;
+    }
+    connection->nextRequestID = 1;
+  }
+  return connection;
+}
+
+/**
+ * Starts a connection's client; the TCP connection itself is opened by the next send.
+ *
+ * @param connection connection to start
+ * @return SUCCESS or ERROR
+ */
+static int openConnection(LodiConnection *connection) {
+  if (connection->client->base.start(&connection->client->base) == DOMAIN_FAILURE) {
+    printf("Failed to start Lodi Client\n");
+    return ERROR;
+  }
+  connection->isStarted = true;
+  connection->epoch++;
   return SUCCESS;
 }
+
+/**
+ * Closes a connection. Responses still owed on it will never arrive, so its in-flight requests are forgotten and their
+ * awaits fail immediately.
+ *
+ * @param connection connection to close
+ */
+static void closeConnection(LodiConnection *connection) {
+  if (connection->isStarted && connection->client->base.stop(&connection->client->base) == DOMAIN_FAILURE) {
+    printf("Failed to stop Lodi Client\n");
+  }
+  connection->isStarted = false;
+  connection->inFlightCount = 0;
+}
+
+static bool isInFlight(const LodiConnection *connection, const unsigned int requestID) {
+  for (int i = 0; i < connection->inFlightCount; i++) {
+    if (connection->inFlight[i] == requestID) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void retire(LodiConnection *connection, const unsigned int requestID) {
+  for (int i = 0; i < connection->inFlightCount; i++) {
+    if (connection->inFlight[i] == requestID) {
+      connection->inFlight[i] = connection->inFlight[--connection->inFlightCount];
+      return;
+    }
+  }
+}
@@ -1,5 +1,12 @@
 /**
  * Manages interactions with the Lodi Server.
+ *
+ * Requests travel over a small pool of persistent connections, one per group of users, that are reopened transparently
+ * when the server has closed them. Each request is tagged with a requestID that the server echoes back, so several
+ * requests can be in flight on one connection: submit them all, then await each response.
+ *
+ * The resumption ticket that comes with a user's ackLogin is kept, and presented to the server when the user's
+ * connection has been reopened, so their session survives the reconnect without another login.
  */
 
 #ifndef COSC522_LODI_LODI_SERVICE_H
@@ -7,8 +14,47 @@
 #include "domain/lodi.h"
 #include "domain/pke.h"
 
+#define LODI_CLIENT_POOL_SIZE 4
+#define LODI_CLIENT_MAX_IN_FLIGHT 16 // per connection
+#define LODI_CLIENT_MAX_TICKETS 16
+
+/**
+ * Sends a request and waits for its response.
+ *
+ * @param inRequest request to send, its requestID is assigned by the call
+ * @param outResponse caller-allocated space for the response
+ * @return SUCCESS or ERROR
+ */
 int lodiClientSend(const PClientToLodiServer *inRequest, LodiServerMessage *outResponse);
 
+/**
+ * Sends a request without waiting for its response.
+ *
+ * @param inRequest request to send, its requestID is assigned by the call
+ * @param requestIDOut the request's requestID, to be passed to lodiClientAwait
+ * @return SUCCESS or ERROR
+ */
+int lodiClientSubmit(const PClientToLodiServer *inRequest, unsigned int *requestIDOut);
+
+/**
+ * Waits for the response to a submitted request. Responses to other requests that arrive first are held for their own
+ * awaits.
+ *
+ * @param userID userID of the submitted request
+ * @param requestID as returned by lodiClientSubmit
+ * @param outResponse caller-allocated space for the response
+ * @return SUCCESS, or ERROR if the response didn't arrive within the receive timeout or the connection was lost
+ */
+int lodiClientAwait(unsigned int userID, unsigned int requestID, LodiServerMessage *outResponse);
+
+/**
+ * @param userID user to get the resumption ticket of
+ * @param expiryOut the ticket's expiry
+ * @param macOut the ticket's MAC
+ * @return SUCCESS, or NOT_FOUND if the user hasn't logged in
+ */
+int lodiClientGetTicket(unsigned int userID, unsigned long *expiryOut, unsigned long *macOut);
+
 int lodiClientPkeSend(const PClientToPKServer *inRequest, PKServerToLodiClient *responseOut);
 
 #endif
@@ -12,6 +12,7 @@
 #include <sys/prctl.h>
 #include <sys/wait.h>
 
+#include "lodi_client_domain_manager.h"
 #include "shared.h"
 #include "domain/lodi.h"
 
@@ -22,6 +23,9 @@ static volatile sig_atomic_t isRunning = 0;
 static int handleClientFeed(unsigned int userId, unsigned long timestamp,
                             unsigned long digitalSig);
 
+static void sendResume(DomainClient *client, unsigned int userId, unsigned long ticketExpiry,
+                       unsigned long ticketMac);
+
 static void handleSigterm(int sig);
 
 int startStreamFeed(const unsigned int userId, const unsigned long timestamp, const unsigned long digitalSignature) {
@@ -52,6 +56,9 @@ void stopStreamFeed(const int pid) {
  * the server for followed idols. The server immediately streams all existing followed idols' messages, and then streams
  * additional messages in real time as they're posted.
  *
+ * When the connection is lost, e.g. to a server restart, the reconnected feed first resumes the session with the
+ * resumption ticket from the login, so the feed request is accepted without logging in again.
+ *
  * @param userId User to start stream messages for
  * @param timestamp Login timestamp
  * @param digitalSig Login digital signature
@@ -72,12 +79,20 @@ static int handleClientFeed(const unsigned int userId, const unsigned long times
     .timestamp = timestamp,
     .digitalSig = digitalSig
   };
+  // the forked feed inherits the ticket issued with the login, and keeps the fresh ones issued with each resume
+  unsigned long ticketExpiry;
+  unsigned long ticketMac;
+  const bool isTicketHeld = lodiClientGetTicket(userId, &ticketExpiry, &ticketMac) == SUCCESS;
+  bool isReconnect = false;
 
   while (isRunning) {
     int clientRet;
     if (!client->isConnected) {
       client->base.start(&client->base);
       client->base.changeTimeout(&client->base, DEFAULT_TIMEOUT_MS);
+      if (isReconnect && isTicketHeld) {
+        sendResume(client, userId, ticketExpiry, ticketMac);
+      }
       clientRet = client->send(client, (UserMessage *) &request);
       if (clientRet != SUCCESS) {
         printf("[FEED DEBUG] Failed to send feed request... Retrying in %d seconds...\n", CONNECT_BACKOFF);
@@ -92,6 +107,9 @@ static int handleClientFeed(const unsigned int userId, const unsigned long times
     clientRet = client->receive(client, (UserMessage *) &response);
     if (clientRet == DOMAIN_FAILURE) {
       printf("[FEED DEBUG] Failed to receive feed message...\n");
+    } else if (clientRet == DOMAIN_SUCCESS && response.messageType == ackLogin) {
+      printf("[FEED DEBUG] Resumed session after reconnecting\n");
+      getLoginTicket(&response, &ticketExpiry, &ticketMac);
     } else if (clientRet == DOMAIN_SUCCESS) {
       printf("[FEED MESSAGE] [From Idol %u]: %s\n", response.recipientID, response.message);
       if (response.messageType == failure) {
@@ -100,6 +118,7 @@ static int handleClientFeed(const unsigned int userId, const unsigned long times
       }
     } else if (clientRet == TERMINATED) {
       client->base.stop(&client->base);
+      isReconnect = true;
       if (isRunning) {
         printf("[FEED DEBUG] Connection has been unexpectedly terminated, will attempt to reconnect in %d seconds.\n",
                CONNECT_BACKOFF);
@@ -116,6 +135,28 @@ static int handleClientFeed(const unsigned int userId, const unsigned long times
   return SUCCESS;
 }
 
+/**
+ * Presents the resumption ticket over a reconnected feed. The server handles it before the feed request that follows,
+ * and its ackLogin arrives ahead of the feed.
+ *
+ * @param client reconnected client
+ * @param userId user the feed is for
+ * @param ticketExpiry expiry of the user's ticket
+ * @param ticketMac MAC of the user's ticket
+ */
+static void sendResume(DomainClient *client, const unsigned int userId, const unsigned long ticketExpiry,
+                       const unsigned long ticketMac) {
+  PClientToLodiServer request = {
+    .messageType = resume,
+    .userID = userId,
+    .timestamp = ticketExpiry,
+    .digitalSig = ticketMac
+  };
+  if (client->send(client, (UserMessage *) &request) != DOMAIN_SUCCESS) {
+    printf("[FEED DEBUG] Failed to resume session, the feed request may be rejected\n");
+  }
+}
+
 static void handleSigterm(const int sig) {
   if (sig == SIGTERM) {
     const char message[] = "[FEED DEBUG] received shutdown signal, exiting...\n";
@@ -2,202 +2,187 @@
  * See follower_repository.h
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "collections/list.h"
 #include "collections/int_map.h"
+#include "collections/id_set.h"
 #include "follower_repository.h"
+#include "repository_shard.h"
 #include "shared.h"
 
-static IntMap *idolMap = NULL;
-static IntMap *followerMap = NULL;
+static RepositoryShard idolShards[REPOSITORY_SHARDS]; // idolId -> IdSet of followerIds
+static RepositoryShard followerShards[REPOSITORY_SHARDS]; // followerId -> IdSet of idolIds
+static bool isInitialized = false;
 
-static int addFollowerIdol(unsigned int idolId, unsigned int followerId);
+static int copyIds(RepositoryShard *shards, unsigned int key, unsigned int **ids, int *count);
 
-static int addIdolFollower(unsigned int idolId, unsigned int followerId);
+static int updateShard(RepositoryShard *shards, unsigned int key,
+                       int (*update)(IntMap *map, unsigned int idolId, unsigned int followerId),
+                       unsigned int idolId, unsigned int followerId);
 
-static int removeFollowerIdol(unsigned int idolId, unsigned int followerId);
+static int addFollowerIdol(IntMap *map, unsigned int idolId, unsigned int followerId);
 
-static int removeIdolFollower(unsigned int idolId, unsigned int followerId);
+static int addIdolFollower(IntMap *map, unsigned int idolId, unsigned int followerId);
+
+static int removeFollowerIdol(IntMap *map, unsigned int idolId, unsigned int followerId);
+
+static int removeIdolFollower(IntMap *map, unsigned int idolId, unsigned int followerId);
+
+static int addId(IntMap *map, unsigned int key, unsigned int id);
+
+static int removeId(IntMap *map, unsigned int key, unsigned int id);
 
 /**
  *  Constructor
  */
 void initFollowerRepository() {
-  createMap(&idolMap);
-  createMap(&followerMap);
+  if (initShards(idolShards) == SUCCESS && initShards(followerShards) == SUCCESS) {
+    isInitialized = true;
+  }
 }
 
-int getIdolFollowers(const unsigned int idolId, List **followers) {
-  if (!idolMap) {
-    return ERROR;
-  }
-  const int rt = idolMap->get(idolMap, idolId, (void **) followers);
-  if (rt == ERROR || rt == NOT_FOUND) {
-    return rt;
-  }
-  if ((*followers)->length == 0) {
-    return NOT_FOUND;
-  }
-  return SUCCESS;
+int getIdolFollowers(const unsigned int idolId, unsigned int **followers, int *count) {
+  return copyIds(idolShards, idolId, followers, count);
 }
 
-int getFollowerIdols(const unsigned int followerId, List **idols) {
-  if (!followerMap) {
-    return ERROR;
-  }
-  const int rt = followerMap->get(followerMap, followerId, (void **) idols);
-  if (rt == ERROR || rt == NOT_FOUND) {
-    return rt;
-  }
-  if ((*idols)->length == 0) {
-    return NOT_FOUND;
-  }
-  return SUCCESS;
+int getFollowerIdols(const unsigned int followerId, unsigned int **idols, int *count) {
+  return copyIds(followerShards, followerId, idols, count);
 }
 
 int addFollower(unsigned int idolId, unsigned int followerId) {
-  const int ret = addIdolFollower(idolId, followerId);
+  const int ret = updateShard(idolShards, idolId, addIdolFollower, idolId, followerId);
   if (ret != SUCCESS) {
     return ret;
   }
-  return addFollowerIdol(idolId, followerId);
+  return updateShard(followerShards, followerId, addFollowerIdol, idolId, followerId);
 }
 
 int removeFollower(unsigned int idolId, unsigned int followerId) {
-  if (removeIdolFollower(idolId, followerId) == ERROR) {
+  if (updateShard(idolShards, idolId, removeIdolFollower, idolId, followerId) == ERROR) {
     return ERROR;
   }
-  return removeFollowerIdol(idolId, followerId);
+  return updateShard(followerShards, followerId, removeFollowerIdol, idolId, followerId);
 }
 
 /*
  * Private helper functions
  */
 
-static int addFollowerIdol(unsigned int idolId, unsigned int followerId) {
-  if (!followerMap) {
-    return ERROR;
-  }
-  List *idols = NULL;
-  int rt = followerMap->get(followerMap, followerId, (void **) &idols);
-  if (rt == ERROR) {
+/**
+ * Copies out the ids stored under a key, so the caller can iterate them without holding the shard's lock.
+ */
+static int copyIds(RepositoryShard *shards, const unsigned int key, unsigned int **ids, int *count) {
+  if (!isInitialized) {
     return ERROR;
   }
-  if (rt == NOT_FOUND) {
-    if (createList(&idols) != SUCCESS) {
-      return ERROR;
-    }
-    followerMap->add(followerMap, followerId, idols);
-  }
-  for (int i = 0; i < idols->length; i++) {
-    int *idol = NULL;
-    idols->get(idols, i, (void **) &idol);
-    if (*idol == idolId) {
-      printf("Warning - idolId=%u already added to idol list for followerId=%u\n",
-             idolId, followerId);
-      return SUCCESS;
+  RepositoryShard *shard = getShard(shards, key);
+  pthread_rwlock_rdlock(&shard->lock);
+  IdSet *stored = NULL;
+  int rt = shard->map->get(shard->map, key, (void **) &stored);
+  if (rt == SUCCESS && stored->count == 0) {
+    rt = NOT_FOUND;
+  }
+  if (rt == SUCCESS) {
+    *ids = malloc(stored->count * sizeof(unsigned int));
+    if (*ids == NULL) {
+      rt = ERROR;
+    } else {
+      stored->toArray(stored, *ids);
+      *count = stored->count;
     }
   }
-  unsigned int *persistedIdolId = malloc(sizeof(unsigned int));
-  if (!persistedIdolId) {
+  pthread_rwlock_unlock(&shard->lock);
+  return rt;
+}
+
+/**
+ * Applies one side of a follow/unfollow under the write lock of the shard owning the key.
+ */
+static int updateShard(RepositoryShard *shards, const unsigned int key,
+                       int (*update)(IntMap *map, unsigned int idolId, unsigned int followerId),
+                       const unsigned int idolId, const unsigned int followerId) {
+  if (!isInitialized) {
     return ERROR;
   }
-  *persistedIdolId = idolId;
-  idols->append(idols, persistedIdolId);
-  return SUCCESS;
+  RepositoryShard *shard = getShard(shards, key);
+  pthread_rwlock_wrlock(&shard->lock);
+  const int rt = update(shard->map, idolId, followerId);
+  pthread_rwlock_unlock(&shard->lock);
+  return rt;
 }
 
-static int addIdolFollower(unsigned int idolId, unsigned int followerId) {
-  if (!idolMap) {
-    return ERROR;
+static int addFollowerIdol(IntMap *map, unsigned int idolId, unsigned int followerId) {
+  return addId(map, followerId, idolId);
+}
+
+static int addIdolFollower(IntMap *map, unsigned int idolId, unsigned int followerId) {
+  return addId(map, idolId, followerId);
+}
+
+static int removeFollowerIdol(IntMap *map, unsigned int idolId, unsigned int followerId) {
+  const int rt = removeId(map, followerId, idolId);
+  if (rt == SUCCESS) {
+    printf("Removed idolId=%u from list for followerId=%u\n", idolId, followerId);
+  } else if (rt == NOT_FOUND) {
+    printf("Warning... idolId=%u not found for followerId=%u\n", idolId, followerId);
+  }
+  return rt;
+}
+
+static int removeIdolFollower(IntMap *map, unsigned int idolId, unsigned int followerId) {
+  const int rt = removeId(map, idolId, followerId);
+  if (rt == SUCCESS) {
+    printf("Removed followerId=%u from list for idolId=%u\n", followerId, idolId);
+  } else if (rt == NOT_FOUND) {
+    printf("Warning... followerId=%u not found for idolId=%u\n", followerId, idolId);
   }
-  List *followers = NULL;
-  int rt = idolMap->get(idolMap, idolId, (void **) &followers);
+  return rt;
+}
+
+/**
+ * Adds id to the ids stored under key, unless it's already there.
+ */
+static int addId(IntMap *map, const unsigned int key, const unsigned int id) {
+  IdSet *ids = NULL;
+  const int rt = map->get(map, key, (void **) &ids);
   if (rt == ERROR) {
     return ERROR;
   }
   if (rt == NOT_FOUND) {
-    if (createList(&followers) != SUCCESS) {
+    if (createIdSet(&ids) != SUCCESS) {
       return ERROR;
     }
-    idolMap->add(idolMap, idolId, followers);
-  }
-  for (int i = 0; i < followers->length; i++) {
-    int *follower = NULL;
-    followers->get(followers, i, (void **) &follower);
-    if (*follower == followerId) {
-      printf("Warning - followerId=%u already added to follower list for idolId=%u\n",
-             followerId, idolId);
-      return SUCCESS;
+    if (map->add(map, key, ids) == ERROR) {
+      ids->destroy(&ids);
+      return ERROR;
     }
   }
-  unsigned int *persistedFollowerId = malloc(sizeof(unsigned int));
-  if (!persistedFollowerId) {
+  const int previousCount = ids->count;
+  if (ids->add(ids, id) == ERROR) {
     return ERROR;
   }
-  *persistedFollowerId = followerId;
-  followers->append(followers, persistedFollowerId);
+  if (ids->count == previousCount) {
+    printf("Warning - id=%u already added to list for userId=%u\n", id, key);
+  }
   return SUCCESS;
 }
 
-static int removeFollowerIdol(unsigned int idolId, unsigned int followerId) {
-  if (!followerMap) {
-    return ERROR;
-  }
-  List *idols = NULL;
-  int rt = followerMap->get(followerMap, followerId, (void **) &idols);
+/**
+ * Removes id from the ids stored under key, dropping the set once it's empty.
+ */
+static int removeId(IntMap *map, const unsigned int key, const unsigned int id) {
+  IdSet *ids = NULL;
+  const int rt = map->get(map, key, (void **) &ids);
   if (rt == ERROR || rt == NOT_FOUND) {
     return rt;
   }
-  for (int i = 0; i < idols->length; i++) {
-    int *idol = NULL;
-    idols->get(idols, i, (void **) &idol);
-    if (*idol == idolId) {
-      int *persistedIdolId = NULL;
-      idols->remove(idols, i, (void **) &persistedIdolId);
-      if (persistedIdolId) {
-        free(persistedIdolId);
-      } else {
-        printf("Failed to retrieve id on removal, returning error...\n");
-        return ERROR;
-      }
-      printf("Removed idolId=%u from list for followerId=%u\n",
-             idolId, followerId);
-      return SUCCESS;
-    }
-  }
-  printf("Warning... idolId=%u not found for followerId=%u\n", idolId, followerId);
-  return NOT_FOUND;
-}
-
-static int removeIdolFollower(unsigned int idolId, unsigned int followerId) {
-  if (!idolMap) {
-    return ERROR;
-  }
-  List *followers = NULL;
-  int rt = idolMap->get(idolMap, idolId, (void **) &followers);
-  if (rt == ERROR || rt == NOT_FOUND) {
-    return rt;
+  if (ids->remove(ids, id) == NOT_FOUND) {
+    return NOT_FOUND;
   }
-  for (int i = 0; i < followers->length; i++) {
-    int *follower = NULL;
-    followers->get(followers, i, (void **) &follower);
-    if (*follower == followerId) {
-      int *persistedFollowerId = NULL;
-      followers->remove(followers, i, (void **) &persistedFollowerId);
-      if (persistedFollowerId) {
-        free(persistedFollowerId);
-      } else {
-        printf("Failed to retrieve id on removal, returning error...\n");
-        return ERROR;
-      }
-      printf("Removed followerId=%u from list for idolId=%u\n",
-             followerId, idolId);
-      return SUCCESS;
-    }
+  if (ids->count == 0 && map->remove(map, key, (void **) &ids) == SUCCESS) {
+    ids->destroy(&ids);
   }
-  printf("Warning... followerId=%u not found for idolId=%u\n", followerId, idolId);
-  return NOT_FOUND;
+  return SUCCESS;
 }
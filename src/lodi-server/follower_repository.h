@@ -4,13 +4,22 @@
 
 #ifndef COSC522_LODI_FOLLOWER_REPOSITORY_H
 #define COSC522_LODI_FOLLOWER_REPOSITORY_H
-#include "collections/list.h"
 
 void initFollowerRepository();
 
-int getIdolFollowers(unsigned int idolId, List **followers);
+/**
+ * Snapshots an idol's followers, in ascending order. The caller frees the array.
+ *
+ * @return SUCCESS, NOT_FOUND or ERROR
+ */
+int getIdolFollowers(unsigned int idolId, unsigned int **followers, int *count);
 
-int getFollowerIdols(unsigned int followerId, List **idols);
+/**
+ * Snapshots the idols a user follows, in ascending order. The caller frees the array.
+ *
+ * @return SUCCESS, NOT_FOUND or ERROR
+ */
+int getFollowerIdols(unsigned int followerId, unsigned int **idols, int *count);
 
 int addFollower(unsigned int idolId, unsigned int followerId);
 
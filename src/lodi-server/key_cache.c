@@ -0,0 +1,71 @@
+/*
+ * See key_cache.h
+ */
+
+#include "key_cache.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "shared.h"
+
+#define KEY_OF_TIMER(timerRef) ((CachedKey *) ((char *) (timerRef) - offsetof(CachedKey, expiry)))
+
+static void onKeyExpired(TimerWheel *timers, Timer *timer, void *context);
+
+int initKeyCache(KeyCache *cache, TimerWheel *timers, const int ttlMs, const int negativeTtlMs) {
+  cache->timers = timers;
+  cache->ttlMs = ttlMs;
+  cache->negativeTtlMs = negativeTtlMs;
+  return createMap(&cache->keys);
+}
+
+const CachedKey *findCachedKey(KeyCache *cache, const unsigned int userID) {
+  CachedKey *key;
+  if (cache->keys->get(cache->keys, userID, (void **) &key) != SUCCESS) {
+    return NULL;
+  }
+  return key;
+}
+
+void cacheKey(KeyCache *cache, const unsigned int userID, const bool isFound, const unsigned int publicKey) {
+  const int ttlMs = isFound ? cache->ttlMs : cache->negativeTtlMs;
+  if (ttlMs <= 0) {
+    evictCachedKey(cache, userID);
+    return;
+  }
+  CachedKey *key;
+  if (cache->keys->get(cache->keys, userID, (void **) &key) != SUCCESS) {
+    key = calloc(1, sizeof(CachedKey));
+    if (key == NULL || cache->keys->add(cache->keys, userID, key) == ERROR) {
+      free(key);
+      return;
+    }
+    key->userID = userID;
+  }
+  key->isFound = isFound;
+  key->publicKey = isFound ? publicKey : 0;
+  cache->timers->schedule(cache->timers, &key->expiry, monotonicMs() + ttlMs, onKeyExpired, cache);
+}
+
+void evictCachedKey(KeyCache *cache, const unsigned int userID) {
+  CachedKey *key;
+  if (cache->keys->remove(cache->keys, userID, (void **) &key) == SUCCESS) {
+    cache->timers->cancel(cache->timers, &key->expiry);
+    free(key);
+  }
+}
+
+/**
+ * Evicts an entry whose TTL has run out.
+ *
+ * @param timers the worker's timers
+ * @param timer the entry's expiry
+ * @param context cache holding the entry
+ */
+static void onKeyExpired(TimerWheel *timers, Timer *timer, void *context) {
+  KeyCache *cache = context;
+  CachedKey *key = KEY_OF_TIMER(timer);
+  cache->keys->remove(cache->keys, key->userID, (void **) &key);
+  free(key);
+}
@@ -0,0 +1,68 @@
+/**
+ * A Lodi worker's cache of public keys looked up from the PKE server, so that a user's requests after the first are
+ * authenticated without a round trip. Users the PKE server has no key for are cached too, for a shorter time, so a
+ * stream of requests from an unregistered user doesn't turn into a stream of lookups.
+ *
+ * Entries expire on timers on the worker's TimerWheel. The PKE server also pushes an invalidation whenever a user's key
+ * is registered or replaced, which bounds how long a stale key is used by the delivery of that push rather than by the
+ * TTL.
+ */
+
+#ifndef COSC522_LODI_KEY_CACHE_H
+#define COSC522_LODI_KEY_CACHE_H
+#include <stdbool.h>
+
+#include "collections/int_map.h"
+#include "domain/timer_wheel.h"
+
+typedef struct CachedKey {
+  unsigned int userID;
+  bool isFound; // false if the PKE server has no key for the user
+  unsigned int publicKey; // only set if isFound
+  Timer expiry;
+} CachedKey;
+
+typedef struct KeyCache {
+  IntMap *keys; // userID -> CachedKey
+  TimerWheel *timers;
+  int ttlMs; // how long a key is cached
+  int negativeTtlMs; // how long a missing key is cached
+} KeyCache;
+
+/**
+ * Initializes an empty cache.
+ *
+ * @param cache cache to initialize
+ * @param timers wheel the entries' expiries are scheduled on
+ * @param ttlMs how long a key is cached
+ * @param negativeTtlMs how long a missing key is cached, 0 to not cache missing keys
+ * @return SUCCESS or ERROR
+ */
+int initKeyCache(KeyCache *cache, TimerWheel *timers, int ttlMs, int negativeTtlMs);
+
+/**
+ * @param cache cache to search
+ * @param userID user whose key to look up
+ * @return the user's entry, or NULL if the key has to be looked up
+ */
+const CachedKey *findCachedKey(KeyCache *cache, unsigned int userID);
+
+/**
+ * Caches the outcome of a key lookup, replacing any entry for the user and restarting its TTL.
+ *
+ * @param cache cache to add to
+ * @param userID user the lookup was for
+ * @param isFound whether the PKE server had a key for the user
+ * @param publicKey the user's key, ignored unless isFound
+ */
+void cacheKey(KeyCache *cache, unsigned int userID, bool isFound, unsigned int publicKey);
+
+/**
+ * Evicts a user's entry, if they have one.
+ *
+ * @param cache cache to evict from
+ * @param userID user whose key has changed
+ */
+void evictCachedKey(KeyCache *cache, unsigned int userID);
+
+#endif
@@ -2,50 +2,249 @@
  * See listener_repository.h
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "collections/id_set.h"
+#include "collections/specialized.h"
 #include "listener_repository.h"
+#include "repository_shard.h"
+#include "shared.h"
 
-#include <string.h>
+DEFINE_VECTOR(ListenerVector, listenerVector, Listener)
 
-#include "shared.h"
+static RepositoryShard shards[REPOSITORY_SHARDS]; // userID -> ListenerVector, one Listener per connection
+static IdSet *onlineUsers[REPOSITORY_SHARDS]; // each shard's users with a listener, guarded by the shard's lock
+static bool isInitialized = false;
 
-static List *listeners = NULL;
+static int appendOnline(int shardIndex, const unsigned int *userIDs, int userCount, ListenerVector *snapshot);
+
+static int appendListeners(const RepositoryShard *shard, unsigned int userID, ListenerVector *snapshot);
+
+static bool containsSorted(const unsigned int *ids, int count, unsigned int id);
 
 /**
  *  Constructor
  */
 void initListenerRepository() {
-  createList(&listeners);
+  if (initShards(shards) != SUCCESS) {
+    return;
+  }
+  for (int i = 0; i < REPOSITORY_SHARDS; i++) {
+    if (createIdSet(&onlineUsers[i]) != SUCCESS) {
+      return;
+    }
+  }
+  isInitialized = true;
 }
 
-int addListener(ClientHandle *listener) {
-  ClientHandle *toAppend = malloc(sizeof(ClientHandle));
-  memcpy(toAppend, listener, sizeof(ClientHandle));
-  listeners->append(listeners, toAppend);
-  return SUCCESS;
+int addListener(const ClientHandle *listener, const int workerId) {
+  if (!isInitialized) {
+    return ERROR;
+  }
+  const Listener toAppend = {.handle = *listener, .workerId = workerId};
+
+  RepositoryShard *shard = getShard(shards, listener->userID);
+  IdSet *online = onlineUsers[shard - shards];
+  pthread_rwlock_wrlock(&shard->lock);
+  ListenerVector *listeners = NULL;
+  int rv = shard->map->get(shard->map, listener->userID, (void **) &listeners);
+  if (rv == NOT_FOUND) {
+    listeners = calloc(1, sizeof(ListenerVector));
+    rv = listeners == NULL ? ERROR : shard->map->add(shard->map, listener->userID, listeners);
+    if (rv != SUCCESS) {
+      free(listeners);
+    }
+  }
+  if (rv == SUCCESS) {
+    rv = listenerVectorAppend(listeners, toAppend);
+  }
+  if (rv == SUCCESS && listeners->length == 1) {
+    rv = online->add(online, listener->userID);
+    if (rv != SUCCESS) {
+      listenerVectorRemove(listeners, 0);
+    }
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  return rv;
 }
 
-int removeListener(ClientHandle *listener) {
-  for (int i = 0; i < listeners->length; i++) {
-    ClientHandle *removalCandidate = NULL;
-    listeners->get(listeners, i, (void **) &removalCandidate);
-    if (removalCandidate == NULL) {
-      printf("Unexpected error while retrieving listeners...\n");
-      return ERROR;
+int removeListener(const ClientHandle *listener) {
+  if (!isInitialized) {
+    return ERROR;
+  }
+  RepositoryShard *shard = getShard(shards, listener->userID);
+  IdSet *online = onlineUsers[shard - shards];
+  pthread_rwlock_wrlock(&shard->lock);
+  ListenerVector *listeners = NULL;
+  int rv = shard->map->get(shard->map, listener->userID, (void **) &listeners);
+  if (rv == NOT_FOUND) {
+    rv = SUCCESS;
+  } else if (rv == SUCCESS) {
+    // only the user's own connections are scanned, rarely more than one
+    for (int i = 0; i < listeners->length; i++) {
+      const ClientHandle *candidate = &listeners->items[i].handle;
+      if (candidate->clientSock == listener->clientSock && candidate->connectionID == listener->connectionID) {
+        // listeners are notified in no particular order
+        listenerVectorSwapRemove(listeners, i);
+        if (listeners->length == 0) {
+          online->remove(online, listener->userID);
+          listenerVectorDestroy(listeners);
+          shard->map->remove(shard->map, listener->userID, NULL); // the map frees the emptied vector
+        }
+        break;
+      }
     }
-    if (removalCandidate->userID == listener->userID
-        && removalCandidate->clientSock == listener->clientSock) {
-      listeners->remove(listeners, i, NULL);
-      free(removalCandidate);
-      return SUCCESS;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  return rv;
+}
+
+int removeUserListeners(const unsigned int userID, const ClientHandle *login) {
+  if (!isInitialized) {
+    return ERROR;
+  }
+  RepositoryShard *shard = getShard(shards, userID);
+  IdSet *online = onlineUsers[shard - shards];
+  pthread_rwlock_wrlock(&shard->lock);
+  ListenerVector *listeners = NULL;
+  int rv = shard->map->get(shard->map, userID, (void **) &listeners);
+  if (rv == NOT_FOUND) {
+    rv = SUCCESS;
+  } else if (rv == SUCCESS) {
+    int keptCount = 0;
+    for (int i = 0; i < listeners->length; i++) {
+      if (login != NULL
+          && listeners->items[i].handle.clientAddr.sin_addr.s_addr == login->clientAddr.sin_addr.s_addr) {
+        listeners->items[keptCount++] = listeners->items[i];
+      }
+    }
+    listeners->length = keptCount;
+    if (listeners->length == 0) {
+      online->remove(online, userID);
+      listenerVectorDestroy(listeners);
+      shard->map->remove(shard->map, userID, NULL); // the map frees the emptied vector
     }
   }
-  return SUCCESS;
+  pthread_rwlock_unlock(&shard->lock);
+  return rv;
 }
 
-int getAllListeners(List **listenersOut) {
-  *listenersOut = listeners;
+int getListenersOf(const unsigned int *userIDs, const int userCount, Listener **listenersOut, int *count) {
+  if (!isInitialized) {
+    return ERROR;
+  }
+  // group the users by shard, keeping each group in ascending order, so each shard is locked once per call
+  int groupStarts[REPOSITORY_SHARDS + 1] = {0};
+  for (int i = 0; i < userCount; i++) {
+    groupStarts[getShard(shards, userIDs[i]) - shards + 1]++;
+  }
+  for (int i = 0; i < REPOSITORY_SHARDS; i++) {
+    groupStarts[i + 1] += groupStarts[i];
+  }
+  unsigned int *grouped = malloc((userCount > 0 ? userCount : 1) * sizeof(unsigned int));
+  if (grouped == NULL) {
+    return ERROR;
+  }
+  int groupEnds[REPOSITORY_SHARDS];
+  memcpy(groupEnds, groupStarts, sizeof(groupEnds));
+  for (int i = 0; i < userCount; i++) {
+    grouped[groupEnds[getShard(shards, userIDs[i]) - shards]++] = userIDs[i];
+  }
+
+  ListenerVector snapshot = {0};
+  int rv = SUCCESS;
+  for (int i = 0; i < REPOSITORY_SHARDS && rv == SUCCESS; i++) {
+    if (groupEnds[i] > groupStarts[i]) {
+      rv = appendOnline(i, &grouped[groupStarts[i]], groupEnds[i] - groupStarts[i], &snapshot);
+    }
+  }
+  free(grouped);
+
+  if (rv == SUCCESS && snapshot.length == 0) {
+    rv = NOT_FOUND;
+  }
+  if (rv != SUCCESS) {
+    listenerVectorDestroy(&snapshot);
+    return rv;
+  }
+  *listenersOut = snapshot.items;
+  *count = snapshot.length;
   return SUCCESS;
 }
+
+/*
+ * Private helper functions
+ */
+
+/**
+ * Appends the listeners of the users in one shard that are online. Walks whichever of the users and the shard's online
+ * set is smaller, looking each entry up in the other, so a post by an idol with many followers but few of them online
+ * costs only as much as the online ones.
+ *
+ * @param shardIndex shard owning every one of the users
+ * @param userIDs users to look up, in ascending order
+ * @param snapshot vector to append to
+ * @return SUCCESS or ERROR
+ */
+static int appendOnline(const int shardIndex, const unsigned int *userIDs, const int userCount,
+                        ListenerVector *snapshot) {
+  RepositoryShard *shard = &shards[shardIndex];
+  IdSet *online = onlineUsers[shardIndex];
+  int rv = SUCCESS;
+  pthread_rwlock_rdlock(&shard->lock);
+  if (online->count < userCount) {
+    unsigned int *onlineIDs = malloc((online->count > 0 ? online->count : 1) * sizeof(unsigned int));
+    if (onlineIDs == NULL) {
+      rv = ERROR;
+    } else {
+      const int onlineCount = online->count;
+      online->toArray(online, onlineIDs);
+      for (int i = 0; i < onlineCount && rv == SUCCESS; i++) {
+        if (containsSorted(userIDs, userCount, onlineIDs[i])) {
+          rv = appendListeners(shard, onlineIDs[i], snapshot);
+        }
+      }
+      free(onlineIDs);
+    }
+  } else {
+    for (int i = 0; i < userCount && rv == SUCCESS; i++) {
+      if (online->contains(online, userIDs[i])) {
+        rv = appendListeners(shard, userIDs[i], snapshot);
+      }
+    }
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  return rv;
+}
+
+/**
+ * @param shard locked shard owning an online user
+ * @return SUCCESS or ERROR
+ */
+static int appendListeners(const RepositoryShard *shard, const unsigned int userID, ListenerVector *snapshot) {
+  ListenerVector *listeners = NULL;
+  int rv = shard->map->get(shard->map, userID, (void **) &listeners);
+  for (int i = 0; rv == SUCCESS && i < listeners->length; i++) {
+    rv = listenerVectorAppend(snapshot, listeners->items[i]);
+  }
+  return rv;
+}
+
+static bool containsSorted(const unsigned int *ids, const int count, const unsigned int id) {
+  int low = 0;
+  int high = count - 1;
+  while (low <= high) {
+    const int middle = (low + high) / 2;
+    if (ids[middle] < id) {
+      low = middle + 1;
+    } else if (ids[middle] > id) {
+      high = middle - 1;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
@@ -4,12 +4,35 @@
 
 #ifndef COSC522_LODI_LISTENER_REPOSITORY_H
 #define COSC522_LODI_LISTENER_REPOSITORY_H
-#include "collections/list.h"
 #include "domain/domain.h"
 
+typedef struct {
+  ClientHandle handle;
+  int workerId; // worker thread owning the listener's connection
+} Listener;
+
 void initListenerRepository();
-int addListener(ClientHandle *listener);
-int removeListener(ClientHandle *listener);
-int getAllListeners(List **listenersOut);
+int addListener(const ClientHandle *listener, int workerId);
+int removeListener(const ClientHandle *listener);
+
+/**
+ * Drops the listeners a user's logout or re-login leaves behind, so every listener belongs to a logged-in user. A user
+ * is logged in from one address at a time: a re-login keeps the listeners connected from its address.
+ *
+ * @param userID user logging out or in
+ * @param login connection the user logged in over, or NULL to drop all of their listeners
+ * @return SUCCESS or ERROR
+ */
+int removeUserListeners(unsigned int userID, const ClientHandle *login);
+
+/**
+ * Snapshots the listeners registered for any of a set of users, e.g. an idol's followers. Users without a listener are
+ * skipped without being looked up one by one. The caller frees the array.
+ *
+ * @param userIDs users to look up, in ascending order
+ * @param userCount number of users
+ * @return SUCCESS, NOT_FOUND if none of them has a listener, or ERROR
+ */
+int getListenersOf(const unsigned int *userIDs, int userCount, Listener **listenersOut, int *count);
 
 #endif
@@ -6,12 +6,34 @@
  *   2)  Performs TFA after the digital signature is validated
  *   3)  Responds to the user with a "success" message if both phases succeed
  * After login, handles Lodi Post, Follow, Unfollow, and Logout
+ *
+ * Neither the PKE lookup every request is authenticated with nor the TFA push a login waits on blocks the worker: the
+ * request is parked in a pending-call table and resumed from the event loop when the reply arrives, or failed once the
+ * call times out. Keys that have been looked up are cached for LODI_KEY_TTL_MS, and users without a key for
+ * LODI_NEGATIVE_KEY_TTL_MS, so a user's requests after the first are authenticated in place. Each worker subscribes to
+ * the PKE server's key invalidations to hear when a cached key is replaced.
+ *
+ * A login establishes a session bound to the connection it arrived over. Once it has, the user's other requests over
+ * that connection skip authentication entirely - no key lookup, and no signature check. Every ackLogin carries a
+ * resumption ticket, which re-establishes the session over a new connection without another login, so clients
+ * reconnecting after a restart don't each wait on a TFA push.
+ *
+ * Requests are served by LODI_WORKERS worker threads (one per online CPU by default). Every worker listens on the
+ * Lodi port through its own SO_REUSEPORT socket and event loop, so the kernel spreads connections across workers, and
+ * a connection is only ever read from and written to by the worker that accepted it. Feed messages for followers
+ * connected to another worker are handed to that worker through its lock-free inbox.
  **/
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
+#include "collections/int_map.h"
+#include "collections/mpsc_queue.h"
 #include "domain/lodi.h"
 #include "domain/pke.h"
 #include "domain/tfa.h"
@@ -19,20 +41,115 @@
 #include "util/rsa.h"
 
 #include "follower_repository.h"
+#include "key_cache.h"
 #include "listener_repository.h"
 #include "login_repository.h"
 #include "message_repository.h"
+#include "pending_calls.h"
+#include "resumption_tickets.h"
+#include "sessions.h"
+
+/**
+ * A feed message bound for followers whose connections are owned by another worker.
+ */
+typedef struct {
+  MpscNode node; // must be first
+  LodiServerMessage message; // userID is filled in per recipient
+  int recipientCount;
+  int recipientCapacity;
+  ClientHandle recipients[];
+} FeedDelivery;
+
+/**
+ * Position of a login feed replay. Replays are sent in batches, and one that outruns its client is parked until the
+ * client's output queue drains.
+ */
+typedef struct {
+  ClientHandle handle;
+  unsigned int *idols; // snapshot of the idols followed
+  int idolCount;
+  int idolIndex; // next idol to load messages for
+  unsigned int idolId; // idol whose messages are being replayed
+  char (*messages)[LODI_MESSAGE_LENGTH]; // snapshot of idolId's messages
+  int messageCount;
+  int messageIndex; // next message to send
+} FeedReplay;
+
+#define VERIFY_BATCH_SIZE 64
+
+/**
+ * Requests whose signatures are verified together once the PKE replies at hand have all been read.
+ */
+typedef struct {
+  SignatureCheck checks[VERIFY_BATCH_SIZE];
+  PendingRequest *requests[VERIFY_BATCH_SIZE]; // owned by the key lookups the replies answered
+  int count;
+} VerificationBatch;
+
+typedef struct {
+  int id;
+  pthread_t thread;
+  MpscQueue *inbox; // FeedDeliveries pushed by other workers
+  int inboxFd; // eventfd signalled after every push to the inbox
+} LodiWorker;
+
+static int getWorkerCount();
+
+static int getConfiguredMs(const char *name, int defaultMs);
+
+static void *runWorker(void *worker);
+
+static void drainInbox(DomainServer *server, int inboxFd, void *worker);
 
-static int authenticate(PClientToLodiServer *request);
+static int appendRecipient(FeedDelivery **delivery, const LodiServerMessage *message, const ClientHandle *recipient);
+
+static void broadcastFeedMessage(FeedDelivery *delivery);
+
+static void awaitPublicKey(PClientToLodiServer *request, ClientHandle *clientHandle);
+
+static void onPublicKeyReply(DomainServer *server, int pkeFd, void *context);
+
+static void authenticateRequest(PClientToLodiServer *request, ClientHandle *clientHandle, bool isKeyFound,
+                                unsigned int publicKey);
+
+static void queueVerification(VerificationBatch *batch, PendingRequest *pending, unsigned int publicKey);
+
+static void flushVerifications(VerificationBatch *batch);
+
+static void refreshKeySubscription(TimerWheel *timers, Timer *timer, void *context);
+
+static int verifySignature(const PClientToLodiServer *request, unsigned int publicKey);
+
+static void dispatchRequest(PClientToLodiServer *request, ClientHandle *clientHandle);
+
+static void awaitPush(PClientToLodiServer *request, ClientHandle *clientHandle);
+
+static void onPushReply(DomainServer *server, int tfaFd, void *context);
+
+static void onPublicKeyTimeout(PendingCalls *table, PendingCall *lookup);
+
+static void onPushTimeout(PendingCalls *table, PendingCall *push);
+
+static void failExpiredCall(PendingCall *call, const char *callName);
 
 static void pushFeedMessage(unsigned int idolId, char *message);
 
 static void handleFeed(unsigned int userId, ClientHandle *remoteHandle);
 
-static int sendPushRequest(unsigned int userID);
+static int continueReplay(FeedReplay *replay);
+
+static void resumeReplay(DomainServer *server, const ClientHandle *clientHandle);
+
+static void cancelReplay(const ClientHandle *clientHandle);
+
+static void releaseReplay(FeedReplay *replay);
 
 static void handleLogin(PClientToLodiServer *request, ClientHandle *clientHandle);
 
+static void handleResume(PClientToLodiServer *request, ClientHandle *clientHandle);
+
+static void establishSession(PClientToLodiServer *request, ClientHandle *clientHandle);
+
 static void handleLogout(PClientToLodiServer *request, ClientHandle *clientHandle);
 
 static void handlePost(PClientToLodiServer *request, ClientHandle *clientHandle);
@@ -43,22 +160,112 @@ static void handleUnfollow(PClientToLodiServer *request, ClientHandle *clientHan
 
 static void handleFailure(PClientToLodiServer *request, ClientHandle *clientHandle);
 
-static DomainClient *pkeClient = NULL;
-static DomainServer *lodiServer = NULL;
-static DomainClient *tfaClient = NULL;
+#define FEED_REPLAY_BATCH 64
+#define PUSH_TIMEOUT_MS TFA_PUSH_TIMEOUT_MS
+#define DEFAULT_KEY_TTL_MS 30000
+#define DEFAULT_NEGATIVE_KEY_TTL_MS 2000
+#define KEY_SUBSCRIPTION_REFRESH_MS (PK_SUBSCRIPTION_TTL_MS / 3) // a lost renewal is made up for before it lapses
+
+static LodiWorker *workers = NULL;
+static int workerCount = 0;
+
+static __thread LodiWorker *currentWorker = NULL;
+static __thread DomainClient *pkeClient = NULL;
+static __thread DomainServer *lodiServer = NULL;
+static __thread DomainClient *tfaClient = NULL;
+static __thread IntMap *replays = NULL; // socket -> FeedReplay waiting for its client to catch up
+static __thread PendingCalls keyLookups; // PKE lookups, each resuming every request waiting on the user's key
+static __thread PendingCalls pushes; // TFA pushes, each resuming a login
+static __thread KeyCache keys; // public keys looked up from the PKE server
+static __thread Timer keySubscription; // renews the worker's subscription to key invalidations
+static __thread Sessions sessions; // users logged in over the worker's connections
 
 int main() {
-  if (initPkeClient(&pkeClient) == ERROR
+  initFollowerRepository();
+  initListenerRepository();
+  initLoginRepository();
+  initMessageRepository();
+  if (initResumptionTickets() == ERROR) {
+    printf("Error: Failed to initialize Lodi Server.\n");
+    exit(ERROR);
+  }
+
+  workerCount = getWorkerCount();
+  workers = calloc(workerCount, sizeof(LodiWorker));
+  if (workers == NULL) {
+    printf("Error: Failed to initialize Lodi Server.\n");
+    exit(ERROR);
+  }
+  for (int i = 0; i < workerCount; i++) {
+    workers[i].id = i;
+    workers[i].inboxFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (createMpscQueue(&workers[i].inbox) == ERROR || workers[i].inboxFd < 0) {
+      printf("Error: Failed to initialize Lodi Server.\n");
+      exit(ERROR);
+    }
+  }
+  printf("[DEBUG] Starting Lodi Server with %d workers\n", workerCount);
+  for (int i = 1; i < workerCount; i++) {
+    if (pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]) != 0) {
+      printf("Error: Failed to start Lodi Server worker %d.\n", i);
+      exit(ERROR);
+    }
+  }
+  // the main thread serves as worker 0
+  runWorker(&workers[0]);
+}
+
+/**
+ * @return LODI_WORKERS if set, otherwise the number of online CPUs
+ */
+static int getWorkerCount() {
+  const char *configured = getenv("LODI_WORKERS");
+  long count = configured != NULL ? strtol(configured, NULL, 10) : 0;
+  if (count <= 0) {
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  return count > 0 ? (int) count : 1;
+}
+
+/**
+ * @param name environment variable holding a duration in ms
+ * @param defaultMs duration to use if it isn't set
+ * @return the configured duration, or defaultMs
+ */
+static int getConfiguredMs(const char *name, const int defaultMs) {
+  const char *configured = getenv(name);
+  const long durationMs = configured != NULL ? strtol(configured, NULL, 10) : -1;
+  return durationMs >= 0 && durationMs <= INT32_MAX ? (int) durationMs : defaultMs;
+}
+
+/**
+ * Event loop of a single worker - owns its own Lodi listening socket and the connections accepted on it, as well as
+ * its own PKE and TFA clients.
+ *
+ * @param worker LodiWorker to run as
+ */
+static void *runWorker(void *worker) {
+  currentWorker = worker;
+  if (createMap(&replays) == ERROR
+      || initPkeClient(&pkeClient) == ERROR
       || pkeClient->base.start(&pkeClient->base) == ERROR
       || initLodiServer(&lodiServer) == ERROR
       || lodiServer->base.start(&lodiServer->base) == ERROR
+      || initPendingCalls(&keyLookups, lodiServer->timers, DEFAULT_TIMEOUT_MS, onPublicKeyTimeout) == ERROR
+      || initPendingCalls(&pushes, lodiServer->timers, PUSH_TIMEOUT_MS, onPushTimeout) == ERROR
+      || initSessions(&sessions) == ERROR
+      || initKeyCache(&keys, lodiServer->timers, getConfiguredMs("LODI_KEY_TTL_MS", DEFAULT_KEY_TTL_MS),
+                      getConfiguredMs("LODI_NEGATIVE_KEY_TTL_MS", DEFAULT_NEGATIVE_KEY_TTL_MS)) == ERROR
       || initTfaClient(&tfaClient) == ERROR
-      || tfaClient->base.start(&tfaClient->base) == ERROR) {
-    printf("Error: Failed to initialize Lodi Server.\n");
+      || tfaClient->base.start(&tfaClient->base) == ERROR
+      || lodiServer->watch(lodiServer, currentWorker->inboxFd, drainInbox, currentWorker) == DOMAIN_FAILURE
+      || lodiServer->watch(lodiServer, pkeClient->base.sock, onPublicKeyReply, NULL) == DOMAIN_FAILURE
+      || lodiServer->watch(lodiServer, tfaClient->base.sock, onPushReply, NULL) == DOMAIN_FAILURE) {
+    printf("Error: Failed to initialize Lodi Server worker %d.\n", currentWorker->id);
     exit(ERROR);
   }
-  initFollowerRepository();
-  initListenerRepository();
+  lodiServer->onDrained = resumeReplay;
+  refreshKeySubscription(lodiServer->timers, &keySubscription, NULL);
 
   while (true) {
     PClientToLodiServer request;
@@ -73,38 +280,249 @@ int main() {
       printf("Connection terminated for userId=%d, socket %d\n",
              remoteHandle.userID, remoteHandle.clientSock);
       removeListener(&remoteHandle);
+      if (hasSession(&sessions, remoteHandle.userID, &remoteHandle)) {
+        unbindSession(&sessions, remoteHandle.userID);
+      }
+      cancelReplay(&remoteHandle);
+      cancelPendingRequests(&keyLookups, &remoteHandle);
+      cancelPendingRequests(&pushes, &remoteHandle);
       continue;
     }
 
-    if (request.messageType == login) {
-      handleLogin(&request, &remoteHandle);
-    } else if (authenticate(&request) == ERROR || !isUserLoggedIn(&remoteHandle)) {
-      printf("Authentication failed for userId=%d", request.userID);
-      handleFailure(&request, &remoteHandle);
-    } else if (request.messageType == logout) {
-      handleLogout(&request, &remoteHandle);
-    } else if (request.messageType == post) {
-      handlePost(&request, &remoteHandle);
-    } else if (request.messageType == follow) {
-      handleFollow(&request, &remoteHandle);
-    } else if (request.messageType == unfollow) {
-      handleUnfollow(&request, &remoteHandle);
-    } else if (request.messageType == feed) {
-      handleFeed(request.userID, &remoteHandle);
+    if (request.messageType == resume) {
+      handleResume(&request, &remoteHandle);
+    } else if (request.messageType != login && hasSession(&sessions, request.userID, &remoteHandle)) {
+      dispatchRequest(&request, &remoteHandle);
     } else {
-      printf("Unrecognized request message type, messageType=%d, userId=%d",
-             request.messageType, request.userID);
-      handleFailure(&request, &remoteHandle);
+      awaitPublicKey(&request, &remoteHandle);
     }
   }
 }
 
-static int authenticate(PClientToLodiServer *request) {
-  unsigned int publicKey;
-  if (getPublicKey(pkeClient, request->userID, &publicKey) == ERROR) {
-    printf("[ERROR] Failed to retrieve public key!\n");
-    return ERROR;
+/**
+ * Handles a request whose digital signature has been authenticated.
+ *
+ * @param request authenticated request
+ * @param clientHandle client that sent the request
+ */
+static void dispatchRequest(PClientToLodiServer *request, ClientHandle *clientHandle) {
+  if (request->messageType == login) {
+    awaitPush(request, clientHandle);
+  } else if (!isUserLoggedIn(clientHandle)) {
+    printf("Authentication failed for userId=%d", request->userID);
+    handleFailure(request, clientHandle);
+  } else if (request->messageType == logout) {
+    handleLogout(request, clientHandle);
+  } else if (request->messageType == post) {
+    handlePost(request, clientHandle);
+  } else if (request->messageType == follow) {
+    handleFollow(request, clientHandle);
+  } else if (request->messageType == unfollow) {
+    handleUnfollow(request, clientHandle);
+  } else if (request->messageType == feed) {
+    handleFeed(request->userID, clientHandle);
+  } else {
+    printf("Unrecognized request message type, messageType=%d, userId=%d",
+           request->messageType, request->userID);
+    handleFailure(request, clientHandle);
+  }
+}
+
+/**
+ * Called from the worker's event loop whenever another worker has signalled its inbox. Delivers every queued feed
+ * message to the recipients, all of which are connected to this worker.
+ *
+ * @param server the worker's Lodi server
+ * @param inboxFd the worker's eventfd
+ * @param worker the LodiWorker owning the inbox
+ */
+static void drainInbox(DomainServer *server, const int inboxFd, void *worker) {
+  MpscQueue *inbox = ((LodiWorker *) worker)->inbox;
+  uint64_t signalCount;
+  // resets the eventfd before draining, so a push racing with the drain signals it afresh
+  read(inboxFd, &signalCount, sizeof(signalCount));
+
+  MpscNode *node;
+  while (inbox->pop(inbox, &node) == SUCCESS) {
+    FeedDelivery *delivery = (FeedDelivery *) node;
+    broadcastFeedMessage(delivery);
+    free(delivery);
+  }
+}
+
+/**
+ * Starts authenticating a request by looking up its sender's public key. A cached key authenticates the request right
+ * away. Otherwise the request is resumed by onPublicKeyReply, and requests from a user whose key is already being
+ * looked up share that lookup.
+ *
+ * @param request request to authenticate
+ * @param clientHandle client that sent the request
+ */
+static void awaitPublicKey(PClientToLodiServer *request, ClientHandle *clientHandle) {
+  const CachedKey *cached = findCachedKey(&keys, request->userID);
+  if (cached != NULL) {
+    authenticateRequest(request, clientHandle, cached->isFound, cached->publicKey);
+    return;
+  }
+  PendingCall *lookup = findPendingCall(&keyLookups, request->userID);
+  if (lookup == NULL) {
+    PClientToPKServer keyRequest = {
+      .messageType = requestKey,
+      .userID = request->userID
+    };
+    if (pkeClient->submit(pkeClient, (UserMessage *) &keyRequest, lodiServer->timers, DEFAULT_TIMEOUT_MS)
+        == DOMAIN_FAILURE) {
+      printf("[ERROR] Failed to request public key!\n");
+      handleFailure(request, clientHandle);
+      return;
+    }
+    lookup = addPendingCall(&keyLookups, request->userID);
+    if (lookup == NULL) {
+      handleFailure(request, clientHandle);
+      return;
+    }
+  }
+  if (appendPendingRequest(&keyLookups, lookup, request, clientHandle) == ERROR) {
+    handleFailure(request, clientHandle);
+  }
+}
+
+/**
+ * Called from the worker's event loop whenever the PKE server has replied. Caches each public key received, then
+ * authenticates and handles every request waiting on it. Also evicts the keys the PKE server invalidates.
+ *
+ * The signatures of the requests waiting on every reply at hand are verified in batches, which is several times
+ * quicker than one at a time when a login storm has many lookups answered at once.
+ *
+ * @param server the worker's Lodi server
+ * @param pkeFd the PKE client's socket
+ * @param context unused
+ */
+static void onPublicKeyReply(DomainServer *server, const int pkeFd, void *context) {
+  VerificationBatch batch = {.count = 0};
+  PendingCall *answered = NULL; // lookups taken from keyLookups, linked through next until the batch is flushed
+  PKServerToLodiClient response;
+  int receiveStatus;
+  while ((receiveStatus = pkeClient->receiveAvailable(pkeClient, (UserMessage *) &response)) != WOULD_BLOCK) {
+    if (receiveStatus != DOMAIN_SUCCESS) {
+      continue;
+    }
+    if (response.messageType == invalidateKey) {
+      printf("[DEBUG] Public key invalidated for userID=%u\n", response.userID);
+      evictCachedKey(&keys, response.userID);
+      continue;
+    }
+    cacheKey(&keys, response.userID, response.messageType != ackPKFail, response.publicKey);
+    PendingCall *lookup = takePendingCall(&keyLookups, response.userID);
+    if (lookup == NULL) {
+      printf("[WARNING] Discarding public key nobody is waiting for, userID=%u\n", response.userID);
+      continue;
+    }
+    if (response.messageType == ackPKFail) {
+      printf("[ERROR] Public Key not found for userID=%u\n", response.userID);
+    } else {
+      printf("[DEBUG] Received public key successfully! Received: messageType=%u, userID=%u, publicKey=%u\n",
+             response.messageType, response.userID, response.publicKey);
+    }
+    for (PendingRequest *pending = lookup->waitingHead; pending != NULL; pending = pending->next) {
+      if (pending->isCancelled) {
+        continue;
+      }
+      if (response.messageType == ackPKFail) {
+        authenticateRequest(&pending->request, &pending->handle, false, 0);
+      } else {
+        queueVerification(&batch, pending, response.publicKey);
+      }
+    }
+    lookup->next = answered;
+    answered = lookup;
+  }
+
+  flushVerifications(&batch);
+  while (answered != NULL) {
+    PendingCall *next = answered->next;
+    releasePendingCall(answered);
+    answered = next;
+  }
+}
+
+/**
+ * Checks a request's digital signature against its sender's public key, handling the request if it's authentic.
+ *
+ * @param request request to authenticate
+ * @param clientHandle client that sent the request
+ * @param isKeyFound whether the sender has a public key
+ * @param publicKey the sender's public key, ignored unless isKeyFound
+ */
+static void authenticateRequest(PClientToLodiServer *request, ClientHandle *clientHandle, const bool isKeyFound,
+                                const unsigned int publicKey) {
+  if (!isKeyFound || verifySignature(request, publicKey) == ERROR) {
+    printf("Authentication failed for userId=%d", request->userID);
+    handleFailure(request, clientHandle);
+  } else {
+    dispatchRequest(request, clientHandle);
+  }
+}
+
+/**
+ * Adds a request to be verified against its sender's public key, verifying the batch if it's full.
+ *
+ * @param batch batch to add to
+ * @param pending request waiting on the key
+ * @param publicKey the sender's public key
+ */
+static void queueVerification(VerificationBatch *batch, PendingRequest *pending, const unsigned int publicKey) {
+  batch->checks[batch->count] = (SignatureCheck){
+    .digitalSig = pending->request.digitalSig,
+    .publicKey = publicKey,
+    .timestamp = pending->request.timestamp
+  };
+  batch->requests[batch->count++] = pending;
+  if (batch->count == VERIFY_BATCH_SIZE) {
+    flushVerifications(batch);
+  }
+}
+
+/**
+ * Verifies every request in a batch, in the order they were queued, handling the ones that are authentic.
+ *
+ * @param batch batch to verify, emptied by the call
+ */
+static void flushVerifications(VerificationBatch *batch) {
+  bool isValid[VERIFY_BATCH_SIZE];
+  verifySignatures(batch->checks, batch->count, MODULUS, isValid);
+  for (int i = 0; i < batch->count; i++) {
+    PendingRequest *pending = batch->requests[i];
+    if (isValid[i]) {
+      printf("[DEBUG] Verified signature successfully! userId=%u, timestamp=%lu\n", pending->request.userID,
+             pending->request.timestamp);
+      dispatchRequest(&pending->request, &pending->handle);
+    } else {
+      printf("Authentication failed for userId=%u\n", pending->request.userID);
+      handleFailure(&pending->request, &pending->handle);
+    }
+  }
+  batch->count = 0;
+}
+
+/**
+ * (Re)subscribes the worker to the PKE server's key invalidations, then schedules the next renewal.
+ *
+ * @param timers the worker's timers
+ * @param timer keySubscription
+ * @param context unused
+ */
+static void refreshKeySubscription(TimerWheel *timers, Timer *timer, void *context) {
+  const PClientToPKServer subscription = {
+    .messageType = subscribeKeys
+  };
+  if (pkeClient->send(pkeClient, (UserMessage *) &subscription) == DOMAIN_FAILURE) {
+    printf("[WARNING] Failed to subscribe to key invalidations, retrying in %dms\n", KEY_SUBSCRIPTION_REFRESH_MS);
   }
+  timers->schedule(timers, timer, monotonicMs() + KEY_SUBSCRIPTION_REFRESH_MS, refreshKeySubscription, NULL);
+}
+
+static int verifySignature(const PClientToLodiServer *request, const unsigned int publicKey) {
   const unsigned long decrypted = decryptTimestamp(request->digitalSig, publicKey, MODULUS);
   if (decrypted == request->timestamp) {
     printf("[DEBUG] Decrypted timestamp successfully! timestamp=%lu \n", decrypted);
@@ -115,33 +533,161 @@ static int authenticate(PClientToLodiServer *request) {
   return ERROR;
 }
 
-static void handleLogin(PClientToLodiServer *request, ClientHandle *clientHandle) {
-  printf("[LODI_SERVER] attempting to login user...\n");
-
-  LodiServerMessage responseMessage = {
+/**
+ * Sends a login's push request to the TFA server. The login is completed by onPushReply once the user approves, or
+ * failed by onPushTimeout.
+ *
+ * @param request authenticated login request
+ * @param clientHandle client logging in
+ */
+static void awaitPush(PClientToLodiServer *request, ClientHandle *clientHandle) {
+  if (findPendingCall(&pushes, request->userID) != NULL) {
+    printf("[ERROR] A login for userId=%u is already waiting on push confirmation!\n", request->userID);
+    handleFailure(request, clientHandle);
+    return;
+  }
+  printf("[DEBUG] Sending push request to TFA server\n");
+  TFAClientOrLodiServerToTFAServer pushRequest = {
+    .messageType = requestAuth,
     .userID = request->userID
   };
-  if (authenticate(request) == SUCCESS) {
-    responseMessage.messageType = ackLogin;
-  } else {
-    responseMessage.messageType = failure;
+  if (tfaClient->submit(tfaClient, (UserMessage *) &pushRequest, lodiServer->timers, PUSH_TIMEOUT_MS)
+      == DOMAIN_FAILURE) {
+    printf("[ERROR] Unable to send push notification, aborting...\n");
+    handleFailure(request, clientHandle);
+    return;
   }
-  if (responseMessage.messageType == ackLogin && sendPushRequest(request->userID) == ERROR) {
-    printf("[ERROR] Failed to authenticate with push confirmation!\n");
-    responseMessage.messageType = failure;
-  } else if (responseMessage.messageType == ackLogin) {
-    printf("[DEBUG] Validated TFA successfully!\n");
+  PendingCall *push = addPendingCall(&pushes, request->userID);
+  if (push == NULL || appendPendingRequest(&pushes, push, request, clientHandle) == ERROR) {
+    handleFailure(request, clientHandle);
+  }
+}
+
+/**
+ * Called from the worker's event loop whenever the TFA server has replied. Completes the login waiting on each push
+ * confirmation received.
+ *
+ * @param server the worker's Lodi server
+ * @param tfaFd the TFA client's socket
+ * @param context unused
+ */
+static void onPushReply(DomainServer *server, const int tfaFd, void *context) {
+  TFAServerToLodiServer response;
+  int receiveStatus;
+  while ((receiveStatus = tfaClient->receiveAvailable(tfaClient, (UserMessage *) &response)) != WOULD_BLOCK) {
+    if (receiveStatus != DOMAIN_SUCCESS) {
+      continue;
+    }
+    printf("[DEBUG] Push auth confirmation received! Received: messageType=%u, userID=%u\n", response.messageType,
+           response.userID);
+    PendingCall *push = takePendingCall(&pushes, response.userID);
+    if (push == NULL) {
+      printf("[WARNING] Discarding push confirmation nobody is waiting for, userID=%u\n", response.userID);
+      continue;
+    }
+    for (PendingRequest *pending = push->waitingHead; pending != NULL; pending = pending->next) {
+      if (!pending->isCancelled) {
+        handleLogin(&pending->request, &pending->handle);
+      }
+    }
+    releasePendingCall(push);
+  }
+}
+
+/**
+ * Called from the worker's event loop when a public key lookup times out.
+ *
+ * @param table keyLookups
+ * @param lookup the expired lookup
+ */
+static void onPublicKeyTimeout(PendingCalls *table, PendingCall *lookup) {
+  failExpiredCall(lookup, "public key");
+}
+
+/**
+ * Called from the worker's event loop when a login's push confirmation times out.
+ *
+ * @param table pushes
+ * @param push the expired push
+ */
+static void onPushTimeout(PendingCalls *table, PendingCall *push) {
+  failExpiredCall(push, "push confirmation");
+}
+
+/**
+ * Fails every request waiting on a call that has timed out, then releases the call.
+ *
+ * @param call the expired call
+ * @param callName what the call was waiting for
+ */
+static void failExpiredCall(PendingCall *call, const char *callName) {
+  printf("[ERROR] Timed out waiting for %s, userId=%u\n", callName, call->userID);
+  for (PendingRequest *pending = call->waitingHead; pending != NULL; pending = pending->next) {
+    if (!pending->isCancelled) {
+      handleFailure(&pending->request, &pending->handle);
+    }
+  }
+  releasePendingCall(call);
+}
+
+/**
+ * Completes a login whose signature and push confirmation have both been validated.
+ *
+ * @param request login request
+ * @param clientHandle client logging in
+ */
+static void handleLogin(PClientToLodiServer *request, ClientHandle *clientHandle) {
+  printf("[DEBUG] Validated TFA successfully!\n");
+  establishSession(request, clientHandle);
+}
+
+/**
+ * Re-establishes a session from the resumption ticket presented in place of a resume request's signature. The ticket
+ * stands in for both the signature and the TFA push, so no call is made to either server.
+ *
+ * @param request resume request
+ * @param clientHandle client resuming
+ */
+static void handleResume(PClientToLodiServer *request, ClientHandle *clientHandle) {
+  if (!isTicketValid(request->userID, getTicketGeneration(request->userID), clientHandle, request->timestamp,
+                     request->digitalSig)) {
+    printf("[ERROR] Invalid or expired resumption ticket for userId=%u\n", request->userID);
+    handleFailure(request, clientHandle);
+    return;
   }
+  printf("[DEBUG] Resumed session for userId=%u\n", request->userID);
+  establishSession(request, clientHandle);
+}
 
-  if (responseMessage.messageType == ackLogin && isUserLoggedIn(clientHandle)) {
+/**
+ * Logs a user in over the connection their login or resume arrived on, and acknowledges it with a fresh resumption
+ * ticket.
+ *
+ * @param request authenticated login or resume request
+ * @param clientHandle client logging in
+ */
+static void establishSession(PClientToLodiServer *request, ClientHandle *clientHandle) {
+  LodiServerMessage responseMessage = {
+    .messageType = ackLogin,
+    .userID = request->userID,
+    .requestID = request->requestID
+  };
+  unsigned long ticketExpiry;
+  unsigned long ticketMac;
+  issueTicket(request->userID, getTicketGeneration(request->userID), clientHandle, &ticketExpiry, &ticketMac);
+  setLoginTicket(&responseMessage, ticketExpiry, ticketMac);
+
+  if (isUserLoggedIn(clientHandle)) {
     printf("[WARNING] User is already logged in, invalidating previous session.\n");
     userLogout(clientHandle);
   }
-
-  if (responseMessage.messageType == ackLogin) {
-    userLogin(clientHandle);
-  } else {
-    printf("[ERROR] Login failed!\n");
+  userLogin(clientHandle);
+  if (removeUserListeners(request->userID, clientHandle) == ERROR) {
+    printf("[WARNING] Unable to drop stale listeners for userId=%u\n", request->userID);
+  }
+  if (bindSession(&sessions, request->userID, clientHandle) == ERROR) {
+    // the user's requests are still served, they're just authenticated one by one
+    printf("[WARNING] Unable to establish a session for userId=%u\n", request->userID);
   }
 
   if (lodiServer->send(lodiServer, (UserMessage *) &responseMessage, clientHandle) == ERROR) {
@@ -153,20 +699,23 @@ static void handleLogout(PClientToLodiServer *request, ClientHandle *clientHandl
   printf("[DEBUG] logging out user with userId=%u\n", request->userID);
 
   LodiServerMessage responseMessage = {
-    .userID = request->userID
+    .messageType = ackLogout,
+    .userID = request->userID,
+    .requestID = request->requestID
   };
-  if (authenticate(request) == SUCCESS) {
-    responseMessage.messageType = ackLogout;
-  } else {
-    printf("[ERROR] User with userId=%u, failed authentication\n", request->userID);
-    responseMessage.messageType = failure;
-  }
 
   if (isUserLoggedIn(clientHandle)) {
     userLogout(clientHandle);
   } else {
     printf("[WARNING] User with userId=%u was already logged out\n", request->userID);
   }
+  unbindSession(&sessions, request->userID);
+  if (removeUserListeners(request->userID, NULL) == ERROR) {
+    printf("[WARNING] Unable to drop listeners for userId=%u\n", request->userID);
+  }
+  if (revokeTickets(request->userID) == ERROR) {
+    printf("[WARNING] Unable to revoke resumption tickets for userId=%u\n", request->userID);
+  }
 
   if (lodiServer->send(lodiServer, (UserMessage *) &responseMessage, clientHandle) == ERROR) {
     printf("[WARNING] Error while sending Lodi logout response for userId=%u.\n", request->userID);
@@ -178,6 +727,7 @@ static void handlePost(PClientToLodiServer *request, ClientHandle *clientHandle)
   LodiServerMessage responseMessage = {
     .messageType = ackPost,
     .userID = request->userID,
+    .requestID = request->requestID
   };
   if (addMessage(request->userID, request->message) == ERROR) {
     responseMessage.messageType = failure;
@@ -194,6 +744,7 @@ static void handleFollow(PClientToLodiServer *request, ClientHandle *clientHandl
   LodiServerMessage responseMessage = {
     .messageType = ackFollow,
     .userID = request->userID,
+    .requestID = request->requestID
   };
   if (addFollower(request->recipientID, request->userID) == ERROR) {
     responseMessage.messageType = failure;
@@ -208,6 +759,7 @@ static void handleUnfollow(PClientToLodiServer *request, ClientHandle *clientHan
   LodiServerMessage responseMessage = {
     .messageType = ackUnfollow,
     .userID = request->userID,
+    .requestID = request->requestID
   };
   if (removeFollower(request->recipientID, request->userID) == ERROR) {
     responseMessage.messageType = failure;
@@ -221,6 +773,7 @@ static void handleFailure(PClientToLodiServer *request, ClientHandle *clientHand
   LodiServerMessage responseMessage = {
     .messageType = failure,
     .userID = request->userID,
+    .requestID = request->requestID
   };
   if (lodiServer->send(lodiServer, (UserMessage *) &responseMessage, clientHandle) == ERROR) {
     printf("[WARNING] Error while sending Lodi failure.\n");
@@ -235,100 +788,198 @@ static void handleFailure(PClientToLodiServer *request, ClientHandle *clientHand
  */
 static void handleFeed(const unsigned int userId, ClientHandle *remoteHandle) {
   printf("[DEBUG] Handling feed subscription request.\n");
-  addListener(remoteHandle);
-  List *idols;
-  if (getFollowerIdols(userId, &idols) != SUCCESS) {
+  addListener(remoteHandle, currentWorker->id);
+  cancelReplay(remoteHandle);
+  FeedReplay *replay = calloc(1, sizeof(FeedReplay));
+  if (replay == NULL) {
     return;
   }
-  LodiServerMessage responseMessage = {
-    .messageType = ackFeed,
-    .userID = userId
-  };
-  for (int i = 0; i < idols->length; i++) {
-    int *idolId;
-    idols->get(idols, i, (void **) &idolId);
-    responseMessage.recipientID = *idolId;
-    List *messages;
-    if (getMessages(*idolId, &messages) != SUCCESS) {
+  replay->handle = *remoteHandle;
+  replay->handle.userID = userId;
+  if (getFollowerIdols(userId, &replay->idols, &replay->idolCount) != SUCCESS
+      || continueReplay(replay) != WOULD_BLOCK
+      || replays->add(replays, remoteHandle->clientSock, replay) == ERROR) {
+    releaseReplay(replay);
+  }
+}
+
+/**
+ * Sends as much of a feed replay as the client's output queue will take, a batch at a time.
+ *
+ * @param replay replay to advance
+ * @return SUCCESS once every message has been sent, WOULD_BLOCK if the rest has to wait for the client to catch up
+ */
+static int continueReplay(FeedReplay *replay) {
+  LodiServerMessage batch[FEED_REPLAY_BATCH];
+  ClientHandle recipients[FEED_REPLAY_BATCH];
+  while (true) {
+    if (replay->messageIndex == replay->messageCount) {
+      free(replay->messages);
+      replay->messages = NULL;
+      replay->messageCount = 0;
+      replay->messageIndex = 0;
+      if (replay->idolIndex == replay->idolCount) {
+        return SUCCESS;
+      }
+      replay->idolId = replay->idols[replay->idolIndex++];
+      if (getMessages(replay->idolId, &replay->messages, &replay->messageCount) != SUCCESS) {
+        replay->messages = NULL;
+        replay->messageCount = 0;
+      }
       continue;
     }
-    for (int j = 0; j < messages->length; j++) {
-      char *message = NULL;
-      messages->get(messages, j, (void **) &message);
-      memcpy(responseMessage.message, message, LODI_MESSAGE_LENGTH * sizeof(char));
-      if (lodiServer->send(lodiServer, (UserMessage *) &responseMessage, remoteHandle) == ERROR) {
-        printf("[WARNING] Error while responding to initial feed request. Continuing...\n");
-      }
+
+    const int remaining = replay->messageCount - replay->messageIndex;
+    const int batchSize = remaining < FEED_REPLAY_BATCH ? remaining : FEED_REPLAY_BATCH;
+    for (int i = 0; i < batchSize; i++) {
+      batch[i].messageType = ackFeed;
+      batch[i].userID = replay->handle.userID;
+      batch[i].requestID = 0;
+      batch[i].recipientID = replay->idolId;
+      memcpy(batch[i].message, replay->messages[replay->messageIndex + i], LODI_MESSAGE_LENGTH * sizeof(char));
+      recipients[i] = replay->handle;
+    }
+    int sentCount;
+    const int sendStatus = lodiServer->sendBatch(lodiServer, batch, sizeof(LodiServerMessage), recipients, batchSize,
+                                                 &sentCount);
+    replay->messageIndex += sentCount;
+    if (sendStatus != DOMAIN_SUCCESS) {
+      // either the client's queue is full, or its connection is gone and the replay is cancelled on TERMINATED
+      return WOULD_BLOCK;
     }
   }
 }
 
 /**
- * Send a push request to the TFA server
- * @param userID user to authenticate
- * @return ERROR or SUCCESS
+ * DomainServer#onDrained handler - picks a parked feed replay back up.
  */
-static int sendPushRequest(const unsigned int userID) {
-  printf("[DEBUG] Sending push request to TFA server\n");
-  const TFAClientOrLodiServerToTFAServer requestMessage = {
-    .messageType = requestAuth,
-    .userID = userID
-  };
-
-  if (tfaClient->send(tfaClient, (UserMessage *) &requestMessage) == DOMAIN_FAILURE) {
-    printf("[ERROR] Unable to send push notification, aborting...\n");
-    return ERROR;
+static void resumeReplay(DomainServer *server, const ClientHandle *clientHandle) {
+  FeedReplay *replay = NULL;
+  if (replays->get(replays, clientHandle->clientSock, (void **) &replay) != SUCCESS
+      || replay->handle.connectionID != clientHandle->connectionID) {
+    return;
   }
-
-  TFAServerToLodiServer response;
-  if (tfaClient->receive(tfaClient, (UserMessage *) &response) == DOMAIN_FAILURE) {
-    printf("[ERROR] Unable to receive push notification response, aborting...\n");
-    return ERROR;
+  if (continueReplay(replay) == SUCCESS) {
+    printf("[DEBUG] Finished feed replay for userId=%u\n", replay->handle.userID);
+    replays->remove(replays, clientHandle->clientSock, (void **) &replay);
+    releaseReplay(replay);
   }
+}
 
-  printf("[DEBUG] Push auth confirmation received! Received: messageType=%u, userID=%u\n", response.messageType,
-         response.userID);
+/**
+ * Drops the parked feed replay of a connection, if there is one.
+ */
+static void cancelReplay(const ClientHandle *clientHandle) {
+  FeedReplay *replay = NULL;
+  if (replays->remove(replays, clientHandle->clientSock, (void **) &replay) == SUCCESS) {
+    releaseReplay(replay);
+  }
+}
 
-  return SUCCESS;
+static void releaseReplay(FeedReplay *replay) {
+  free(replay->idols);
+  free(replay->messages);
+  free(replay);
 }
 
 /**
  * Responsible for handling the COSC 522 requirement of streaming new messages automatically to logged-in followers.
  *
+ * Followers connected to this worker are sent the message directly. The rest are batched per owning worker, and each
+ * batch is handed off to that worker's inbox.
+ *
  * @param idolId The idol that just made a post
  * @param message The idol's new post
  */
 static void pushFeedMessage(const unsigned int idolId, char *message) {
   printf("[DEBUG] Publishing messages to idol followers\n");
-  List *followers;
-  if (getIdolFollowers(idolId, &followers) != SUCCESS) {
+  unsigned int *followers;
+  int followerCount;
+  if (getIdolFollowers(idolId, &followers, &followerCount) != SUCCESS) {
     return;
   }
-  List *listeners;
-  getAllListeners(&listeners);
   LodiServerMessage responseMessage = {
     .messageType = ackFeed,
     .recipientID = idolId
   };
   memcpy(responseMessage.message, message,LODI_MESSAGE_LENGTH * sizeof(char));
   printf("[DEBUG] Publishing messages to all logged-in listening idol followers, idolId=%u, followerCount=%d\n",
-         idolId, followers->length);
-  for (int i = 0; i < followers->length; i++) {
-    int *followerId = NULL;
-    followers->get(followers, i, (void **) &followerId);
-
-    for (int j = 0; j < listeners->length; j++) {
-      ClientHandle *listener;
-      listeners->get(listeners, j, (void **) &listener);
-      if (isUserLoggedIn(listener) && listener->userID == *followerId) {
-        responseMessage.userID = *followerId;
-        const int sendStatus = lodiServer->send(lodiServer, (UserMessage *) &responseMessage, listener);
-        if (sendStatus != DOMAIN_SUCCESS) {
-          printf("[WARNING] Wasn't able to send message to followerId=%d\n", *followerId);
-        } else {
-          printf("[DEBUG] Pushed messagwe to followerId=%d\n", *followerId);
-        }
+         idolId, followerCount);
+
+  // recipients grouped by the worker owning their connection
+  FeedDelivery **deliveries = calloc(workerCount, sizeof(FeedDelivery *));
+  if (deliveries == NULL) {
+    free(followers);
+    return;
+  }
+  Listener *listeners;
+  int listenerCount;
+  if (getListenersOf(followers, followerCount, &listeners, &listenerCount) == SUCCESS) {
+    for (int i = 0; i < listenerCount; i++) {
+      if (appendRecipient(&deliveries[listeners[i].workerId], &responseMessage, &listeners[i].handle) == ERROR) {
+        printf("[WARNING] Wasn't able to send message to followerId=%u\n", listeners[i].handle.userID);
       }
     }
+    free(listeners);
+  }
+  for (int i = 0; i < workerCount; i++) {
+    if (deliveries[i] == NULL) {
+      continue;
+    }
+    if (i == currentWorker->id) {
+      broadcastFeedMessage(deliveries[i]);
+      free(deliveries[i]);
+    } else {
+      printf("[DEBUG] Handing off idolId=%u message to worker %d, recipientCount=%d\n",
+             idolId, i, deliveries[i]->recipientCount);
+      workers[i].inbox->push(workers[i].inbox, &deliveries[i]->node);
+      const uint64_t signal = 1;
+      write(workers[i].inboxFd, &signal, sizeof(signal));
+    }
   }
+  free(deliveries);
+  free(followers);
+}
+
+/**
+ * Sends a feed message to every recipient, serializing it once. Must be called by the worker owning the recipients'
+ * connections.
+ *
+ * @param delivery feed message and recipients
+ */
+static void broadcastFeedMessage(FeedDelivery *delivery) {
+  int sentCount;
+  if (lodiServer->broadcast(lodiServer, (UserMessage *) &delivery->message, delivery->recipients,
+                            delivery->recipientCount, &sentCount) != DOMAIN_SUCCESS) {
+    printf("[WARNING] Wasn't able to send message to %d of %d followers of idolId=%u\n",
+           delivery->recipientCount - sentCount, delivery->recipientCount, delivery->message.recipientID);
+  } else {
+    printf("[DEBUG] Pushed message to %d followers of idolId=%u\n", sentCount, delivery->message.recipientID);
+  }
+}
+
+/**
+ * Adds a recipient to a pending hand-off, allocating or growing it as needed.
+ *
+ * @param delivery hand-off being built for one worker, NULL if none yet
+ * @param message feed message to deliver
+ * @param recipient listener to deliver to
+ * @return SUCCESS or ERROR
+ */
+static int appendRecipient(FeedDelivery **delivery, const LodiServerMessage *message, const ClientHandle *recipient) {
+  if (*delivery == NULL || (*delivery)->recipientCount == (*delivery)->recipientCapacity) {
+    const int capacity = *delivery == NULL ? 4 : (*delivery)->recipientCapacity * 2;
+    FeedDelivery *resized = realloc(*delivery, sizeof(FeedDelivery) + capacity * sizeof(ClientHandle));
+    if (resized == NULL) {
+      return ERROR;
+    }
+    if (*delivery == NULL) {
+      resized->message = *message;
+      resized->recipientCount = 0;
+    }
+    resized->recipientCapacity = capacity;
+    *delivery = resized;
+  }
+  (*delivery)->recipients[(*delivery)->recipientCount++] = *recipient;
+  return SUCCESS;
 }
@@ -9,25 +9,56 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "repository_shard.h"
 #include "shared.h"
 
-IntMap *userStore = NULL;
+static RepositoryShard shards[REPOSITORY_SHARDS]; // userID -> ClientHandle
+static RepositoryShard generationShards[REPOSITORY_SHARDS]; // userID -> ticket generation, kept across logouts
+static bool isInitialized = false;
+
+/**
+ *  Constructor
+ */
+void initLoginRepository() {
+  if (initShards(shards) == SUCCESS && initShards(generationShards) == SUCCESS) {
+    isInitialized = true;
+  }
+}
 
 int userLogin(const ClientHandle *userClient) {
-  if (!userStore) {
-    createMap(&userStore);
+  if (!isInitialized) {
+    return ERROR;
   }
   ClientHandle *toPersist = malloc(sizeof(ClientHandle));
+  if (toPersist == NULL) {
+    return ERROR;
+  }
   memcpy(toPersist, userClient, sizeof(ClientHandle));
-  return userStore->add(userStore, userClient->userID, toPersist);
+
+  RepositoryShard *shard = getShard(shards, userClient->userID);
+  pthread_rwlock_wrlock(&shard->lock);
+  ClientHandle *previous = NULL;
+  if (shard->map->remove(shard->map, userClient->userID, (void **) &previous) == SUCCESS) {
+    // another worker may have logged the same user in since the caller checked
+    free(previous);
+  }
+  const int rv = shard->map->add(shard->map, userClient->userID, toPersist);
+  pthread_rwlock_unlock(&shard->lock);
+  if (rv != SUCCESS) {
+    free(toPersist);
+  }
+  return rv;
 }
 
 int userLogout(const ClientHandle *userClient) {
-  if (!userStore) {
-    createMap(&userStore);
+  if (!isInitialized) {
+    return ERROR;
   }
+  RepositoryShard *shard = getShard(shards, userClient->userID);
+  pthread_rwlock_wrlock(&shard->lock);
   ClientHandle *persisted = NULL;
-  int rv = userStore->remove(userStore, userClient->userID, (void **) &persisted);
+  int rv = shard->map->remove(shard->map, userClient->userID, (void **) &persisted);
+  pthread_rwlock_unlock(&shard->lock);
   if (rv == SUCCESS) {
     free(persisted);
   } else {
@@ -38,13 +69,48 @@ int userLogout(const ClientHandle *userClient) {
 }
 
 int isUserLoggedIn(const ClientHandle *userClient) {
-  if (!userStore) {
-    createMap(&userStore);
+  if (!isInitialized) {
+    return false;
   }
+  RepositoryShard *shard = getShard(shards, userClient->userID);
+  pthread_rwlock_rdlock(&shard->lock);
   ClientHandle *persisted = NULL;
-  if (userStore->get(userStore, userClient->userID, (void **) &persisted) == SUCCESS
-      && persisted->clientAddr.sin_addr.s_addr == userClient->clientAddr.sin_addr.s_addr) {
-    return true;
+  const int isLoggedIn = shard->map->get(shard->map, userClient->userID, (void **) &persisted) == SUCCESS
+                         && persisted->clientAddr.sin_addr.s_addr == userClient->clientAddr.sin_addr.s_addr;
+  pthread_rwlock_unlock(&shard->lock);
+  return isLoggedIn;
+}
+
+unsigned int getTicketGeneration(const unsigned int userID) {
+  if (!isInitialized) {
+    return 0;
+  }
+  RepositoryShard *shard = getShard(generationShards, userID);
+  pthread_rwlock_rdlock(&shard->lock);
+  unsigned int *generation = NULL;
+  const unsigned int rv = shard->map->get(shard->map, userID, (void **) &generation) == SUCCESS ? *generation : 0;
+  pthread_rwlock_unlock(&shard->lock);
+  return rv;
+}
+
+int revokeTickets(const unsigned int userID) {
+  if (!isInitialized) {
+    return ERROR;
+  }
+  RepositoryShard *shard = getShard(generationShards, userID);
+  pthread_rwlock_wrlock(&shard->lock);
+  unsigned int *generation = NULL;
+  int rv = shard->map->get(shard->map, userID, (void **) &generation);
+  if (rv == NOT_FOUND) {
+    generation = calloc(1, sizeof(unsigned int));
+    rv = generation == NULL ? ERROR : shard->map->add(shard->map, userID, generation);
+    if (rv != SUCCESS) {
+      free(generation);
+    }
+  }
+  if (rv == SUCCESS) {
+    (*generation)++;
   }
-  return false;
+  pthread_rwlock_unlock(&shard->lock);
+  return rv;
 }
@@ -6,9 +6,25 @@
 #define COSC522_LODI_LOGIN_REPOSITORY_H
 #include "domain/domain.h"
 
+void initLoginRepository();
+
 int userLogin(const ClientHandle *userClient);
 
 int userLogout(const ClientHandle *userClient);
 
 int isUserLoggedIn(const ClientHandle *userClient);
+
+/**
+ * @param userID user to look up
+ * @return the generation the user's resumption tickets are issued under, 0 until revokeTickets is first called
+ */
+unsigned int getTicketGeneration(unsigned int userID);
+
+/**
+ * Invalidates every resumption ticket issued to the user so far, by moving them on to the next generation.
+ *
+ * @param userID user logging out
+ * @return SUCCESS or ERROR
+ */
+int revokeTickets(unsigned int userID);
 #endif
@@ -3,55 +3,86 @@
  */
 #include "message_repository.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "shared.h"
 #include "collections/int_map.h"
-#include "collections/list.h"
-#include "domain/lodi.h"
+#include "collections/specialized.h"
+#include "repository_shard.h"
 
-IntMap *userMessages;
+typedef struct StoredMessage {
+  char text[LODI_MESSAGE_LENGTH];
+} StoredMessage;
+
+DEFINE_VECTOR(MessageVector, messageVector, StoredMessage)
+
+static RepositoryShard shards[REPOSITORY_SHARDS]; // userId -> MessageVector, messages stored back to back
+static bool isInitialized = false;
+
+/**
+ *  Constructor
+ */
+void initMessageRepository() {
+  if (initShards(shards) == SUCCESS) {
+    isInitialized = true;
+  }
+}
 
 int addMessage(unsigned int userId, char *message) {
-  if (userMessages == NULL) {
-    createMap(&userMessages);
+  if (!isInitialized) {
+    return ERROR;
   }
+  StoredMessage toPersist;
+  memcpy(toPersist.text, message, LODI_MESSAGE_LENGTH);
 
-  List *messages = NULL;
-  const int rv = userMessages->get(userMessages, userId, (void **) &messages);
+  RepositoryShard *shard = getShard(shards, userId);
+  pthread_rwlock_wrlock(&shard->lock);
+  IntMap *userMessages = shard->map;
+  MessageVector *messages = NULL;
+  int rv = userMessages->get(userMessages, userId, (void **) &messages);
   if (rv == ERROR) {
     printf("[MessageRepository] Error while persisting user message for userId=%d; unknown map error.", userId);
-    return ERROR;
-  }
-  if (rv == NOT_FOUND) {
-    if (createList(&messages) == ERROR ||
-        userMessages->add(userMessages, userId, messages) == ERROR) {
+  } else if (rv == NOT_FOUND) {
+    messages = calloc(1, sizeof(MessageVector));
+    if (messages == NULL || userMessages->add(userMessages, userId, messages) == ERROR) {
       printf("[MessageRepository] Error while persisting user message for userId=%d; failure while creating list.",
              userId);
-      return ERROR;
+      free(messages);
+      rv = ERROR;
     }
   }
-
-  char *toPersist = malloc(LODI_MESSAGE_LENGTH* sizeof(char));
-  if (toPersist == NULL) {
-    printf("[MessageRepository] Error while persisting user message for userId=%d; malloc() failure.", userId);
-    return ERROR;
-  }
-  memcpy(toPersist, message, LODI_MESSAGE_LENGTH);
-  if (messages->append(messages, toPersist) == ERROR) {
+  if (rv != ERROR && messageVectorAppend(messages, toPersist) == ERROR) {
     printf("[MessageRepository] Error while persisting user message for userId=%d; failed to append message.", userId);
-    free(toPersist);
-    return ERROR;
+    rv = ERROR;
   }
+  pthread_rwlock_unlock(&shard->lock);
 
-  return SUCCESS;
+  return rv == ERROR ? ERROR : SUCCESS;
 }
 
-int getMessages(const unsigned int userId, List **outMessages) {
-  if (userMessages == NULL) {
-    createMap(&userMessages);
+int getMessages(const unsigned int userId, char (**outMessages)[LODI_MESSAGE_LENGTH], int *count) {
+  if (!isInitialized) {
+    return ERROR;
+  }
+  RepositoryShard *shard = getShard(shards, userId);
+  pthread_rwlock_rdlock(&shard->lock);
+  MessageVector *messages = NULL;
+  int rv = shard->map->get(shard->map, userId, (void **) &messages);
+  if (rv == SUCCESS) {
+    *outMessages = malloc(messages->length * LODI_MESSAGE_LENGTH * sizeof(char));
+    if (*outMessages == NULL && messages->length > 0) {
+      rv = ERROR;
+    } else {
+      if (messages->length > 0) {
+        // stored back to back, the same layout as the output, so one copy covers them all
+        memcpy(*outMessages, messages->items, messages->length * sizeof(StoredMessage));
+      }
+      *count = messages->length;
+    }
   }
-  return userMessages->get(userMessages, userId, (void **) outMessages);
+  pthread_rwlock_unlock(&shard->lock);
+  return rv;
 }
@@ -4,10 +4,17 @@
 
 #ifndef COSC522_LODI_KEY_REPOSITORY_H
 #define COSC522_LODI_KEY_REPOSITORY_H
-#include "collections/list.h"
+#include "domain/lodi.h"
+
+void initMessageRepository();
 
 int addMessage(unsigned int userId, char *message);
 
-int getMessages(unsigned int userId, List **outMessages);
+/**
+ * Snapshots a user's messages, oldest first. The caller frees the array.
+ *
+ * @return SUCCESS, NOT_FOUND or ERROR
+ */
+int getMessages(unsigned int userId, char (**outMessages)[LODI_MESSAGE_LENGTH], int *count);
 
 #endif
@@ -0,0 +1,152 @@
+/*
+ * See pending_calls.h
+ */
+
+#include "pending_calls.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "shared.h"
+
+#define CALL_OF_TIMER(timerRef) ((PendingCall *) ((char *) (timerRef) - offsetof(PendingCall, timeout)))
+
+static void unlinkCall(PendingCalls *table, PendingCall *call);
+
+static void unlinkFromConnection(PendingCalls *table, PendingRequest *pending);
+
+static void onCallTimeout(TimerWheel *timers, Timer *timer, void *context);
+
+int initPendingCalls(PendingCalls *table, TimerWheel *timers, const int timeoutMs, const PendingCallExpiry onExpired) {
+  table->timers = timers;
+  table->timeoutMs = timeoutMs;
+  table->onExpired = onExpired;
+  if (createMap(&table->calls) == ERROR) {
+    return ERROR;
+  }
+  return createMap(&table->connections);
+}
+
+PendingCall *findPendingCall(PendingCalls *table, const unsigned int userID) {
+  PendingCall *call;
+  if (table->calls->get(table->calls, userID, (void **) &call) != SUCCESS) {
+    return NULL;
+  }
+  return call;
+}
+
+PendingCall *addPendingCall(PendingCalls *table, const unsigned int userID) {
+  PendingCall *call = calloc(1, sizeof(PendingCall));
+  if (call == NULL) {
+    return NULL;
+  }
+  if (table->calls->add(table->calls, userID, call) == ERROR) {
+    free(call);
+    return NULL;
+  }
+  call->userID = userID;
+  table->timers->schedule(table->timers, &call->timeout, monotonicMs() + table->timeoutMs, onCallTimeout, table);
+  return call;
+}
+
+int appendPendingRequest(PendingCalls *table, PendingCall *call, const PClientToLodiServer *request,
+                         const ClientHandle *handle) {
+  PendingRequest *pending = malloc(sizeof(PendingRequest));
+  if (pending == NULL) {
+    return ERROR;
+  }
+  PendingRequest *connectionHead = NULL;
+  if (table->connections->get(table->connections, handle->clientSock, (void **) &connectionHead) == ERROR
+      || table->connections->add(table->connections, handle->clientSock, pending) == ERROR) {
+    free(pending);
+    return ERROR;
+  }
+  pending->request = *request;
+  pending->handle = *handle;
+  pending->isCancelled = false;
+  pending->next = NULL;
+  pending->previousOnConnection = NULL;
+  pending->nextOnConnection = connectionHead;
+  if (connectionHead != NULL) {
+    connectionHead->previousOnConnection = pending;
+  }
+  if (call->waitingTail != NULL) {
+    call->waitingTail->next = pending;
+  } else {
+    call->waitingHead = pending;
+  }
+  call->waitingTail = pending;
+  return SUCCESS;
+}
+
+PendingCall *takePendingCall(PendingCalls *table, const unsigned int userID) {
+  PendingCall *call;
+  if (table->calls->remove(table->calls, userID, (void **) &call) != SUCCESS) {
+    return NULL;
+  }
+  table->timers->cancel(table->timers, &call->timeout);
+  unlinkCall(table, call);
+  return call;
+}
+
+void cancelPendingRequests(PendingCalls *table, const ClientHandle *handle) {
+  PendingRequest *pending = NULL;
+  if (table->connections->get(table->connections, handle->clientSock, (void **) &pending) != SUCCESS) {
+    return;
+  }
+  for (; pending != NULL; pending = pending->nextOnConnection) {
+    if (pending->handle.connectionID == handle->connectionID) {
+      pending->isCancelled = true;
+    }
+  }
+}
+
+void releasePendingCall(PendingCall *call) {
+  PendingRequest *pending = call->waitingHead;
+  while (pending != NULL) {
+    PendingRequest *next = pending->next;
+    free(pending);
+    pending = next;
+  }
+  free(call);
+}
+
+/**
+ * Removes a call whose timeout has run out and hands it to the table's expiry handler.
+ *
+ * @param timers the worker's timers
+ * @param timer the call's timeout
+ * @param context table holding the call
+ */
+static void onCallTimeout(TimerWheel *timers, Timer *timer, void *context) {
+  PendingCalls *table = context;
+  PendingCall *call = CALL_OF_TIMER(timer);
+  table->calls->remove(table->calls, call->userID, (void **) &call);
+  unlinkCall(table, call);
+  table->onExpired(table, call);
+}
+
+/**
+ * Removes a call's requests from their connections' lists as the call leaves the table.
+ */
+static void unlinkCall(PendingCalls *table, PendingCall *call) {
+  for (PendingRequest *pending = call->waitingHead; pending != NULL; pending = pending->next) {
+    unlinkFromConnection(table, pending);
+  }
+}
+
+static void unlinkFromConnection(PendingCalls *table, PendingRequest *pending) {
+  if (pending->previousOnConnection != NULL) {
+    pending->previousOnConnection->nextOnConnection = pending->nextOnConnection;
+  } else if (pending->nextOnConnection != NULL) {
+    table->connections->add(table->connections, pending->handle.clientSock, pending->nextOnConnection);
+  } else {
+    PendingRequest *connectionHead;
+    table->connections->remove(table->connections, pending->handle.clientSock, (void **) &connectionHead);
+  }
+  if (pending->nextOnConnection != NULL) {
+    pending->nextOnConnection->previousOnConnection = pending->previousOnConnection;
+  }
+  pending->previousOnConnection = NULL;
+  pending->nextOnConnection = NULL;
+}
@@ -0,0 +1,116 @@
+/**
+ * Calls a Lodi worker has made to another server, such as a PKE key lookup or a TFA push, and the client requests
+ * waiting on their replies. The replies carry the userID they concern, so calls are keyed by userID: a request for a
+ * user whose call is already outstanding joins that call instead of making another one.
+ *
+ * Each call's timeout is a timer on the worker's TimerWheel, so a call that's answered or expires costs the same no
+ * matter how many others are outstanding. Likewise, the requests waiting in a table are also linked by the connection
+ * they arrived on, so a disconnect only touches that connection's requests.
+ */
+
+#ifndef COSC522_LODI_PENDING_CALLS_H
+#define COSC522_LODI_PENDING_CALLS_H
+#include <stdbool.h>
+
+#include "collections/int_map.h"
+#include "domain/lodi.h"
+#include "domain/timer_wheel.h"
+
+typedef struct PendingRequest {
+  PClientToLodiServer request;
+  ClientHandle handle;
+  bool isCancelled; // the client disconnected while the request was waiting
+  struct PendingRequest *next; // next request waiting on the same call
+  struct PendingRequest *previousOnConnection; // links the requests from the same connection waiting in the table
+  struct PendingRequest *nextOnConnection;
+} PendingRequest;
+
+typedef struct PendingCall {
+  unsigned int userID;
+  Timer timeout;
+  PendingRequest *waitingHead; // oldest request waiting on the reply
+  PendingRequest *waitingTail;
+  struct PendingCall *next; // free for the owner's use once the call is taken from its table
+} PendingCall;
+
+struct PendingCalls;
+
+/**
+ * Called once a call has timed out, after it has been removed from its table. The handler owns the call afterwards.
+ *
+ * @param table table the call was removed from
+ * @param call the expired call
+ */
+typedef void (*PendingCallExpiry)(struct PendingCalls *table, PendingCall *call);
+
+typedef struct PendingCalls {
+  IntMap *calls; // userID -> PendingCall
+  IntMap *connections; // clientSock -> newest PendingRequest waiting on a call in the table
+  TimerWheel *timers;
+  int timeoutMs;
+  PendingCallExpiry onExpired;
+} PendingCalls;
+
+/**
+ * Initializes an empty table.
+ *
+ * @param table table to initialize
+ * @param timers wheel the calls' timeouts are scheduled on
+ * @param timeoutMs how long each call waits for its reply
+ * @param onExpired handler for calls that time out
+ * @return SUCCESS or ERROR
+ */
+int initPendingCalls(PendingCalls *table, TimerWheel *timers, int timeoutMs, PendingCallExpiry onExpired);
+
+/**
+ * @param table table to search
+ * @param userID user the call concerns
+ * @return the outstanding call, or NULL if there isn't one
+ */
+PendingCall *findPendingCall(PendingCalls *table, unsigned int userID);
+
+/**
+ * Records a call that has just been made, starting its timeout.
+ *
+ * @param table table to add to
+ * @param userID user the call concerns, must not have an outstanding call
+ * @return the new call, or NULL on allocation failure
+ */
+PendingCall *addPendingCall(PendingCalls *table, unsigned int userID);
+
+/**
+ * Adds a client request to the requests waiting on a call.
+ *
+ * @param table table holding the call
+ * @param call call to wait on
+ * @param request request to resume once the reply arrives
+ * @param handle client that sent the request
+ * @return SUCCESS or ERROR
+ */
+int appendPendingRequest(PendingCalls *table, PendingCall *call, const PClientToLodiServer *request, const ClientHandle *handle);
+
+/**
+ * Removes the outstanding call for a user, e.g. when its reply arrives. The caller owns the call afterwards.
+ *
+ * @param table table to remove from
+ * @param userID user the call concerns
+ * @return the call, or NULL if there isn't one, e.g. because it already expired
+ */
+PendingCall *takePendingCall(PendingCalls *table, unsigned int userID);
+
+/**
+ * Marks every request from a client connection as cancelled, so it's dropped rather than resumed.
+ *
+ * @param table table holding the requests
+ * @param handle the disconnected client
+ */
+void cancelPendingRequests(PendingCalls *table, const ClientHandle *handle);
+
+/**
+ * Frees a call taken from a table, along with its waiting requests.
+ *
+ * @param call call to free
+ */
+void releasePendingCall(PendingCall *call);
+
+#endif
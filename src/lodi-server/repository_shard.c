@@ -0,0 +1,20 @@
+/**
+ * See repository_shard.h
+ */
+
+#include "repository_shard.h"
+
+#include "shared.h"
+
+int initShards(RepositoryShard *shards) {
+  for (int i = 0; i < REPOSITORY_SHARDS; i++) {
+    if (pthread_rwlock_init(&shards[i].lock, NULL) != 0 || createMap(&shards[i].map) != SUCCESS) {
+      return ERROR;
+    }
+  }
+  return SUCCESS;
+}
+
+RepositoryShard *getShard(RepositoryShard *shards, const unsigned int key) {
+  return &shards[key % REPOSITORY_SHARDS];
+}
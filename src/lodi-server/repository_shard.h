@@ -0,0 +1,35 @@
+/**
+ * Lock striping shared by the Lodi repositories. Every worker thread reads and writes the same repositories, so each
+ * one spreads its users across a fixed set of shards, each an IntMap guarded by its own reader-writer lock. Operations
+ * only ever hold a single shard's lock at a time.
+ */
+
+#ifndef COSC522_LODI_REPOSITORY_SHARD_H
+#define COSC522_LODI_REPOSITORY_SHARD_H
+#include <pthread.h>
+
+#include "collections/int_map.h"
+
+#define REPOSITORY_SHARDS 64
+
+typedef struct {
+  pthread_rwlock_t lock;
+  IntMap *map;
+} RepositoryShard;
+
+/**
+ * Initializes a repository's shards.
+ *
+ * @param shards REPOSITORY_SHARDS shards to initialize
+ * @return SUCCESS or ERROR
+ */
+int initShards(RepositoryShard *shards);
+
+/**
+ * @param shards a repository's shards
+ * @param key user the caller is about to read or write
+ * @return the shard owning the key
+ */
+RepositoryShard *getShard(RepositoryShard *shards, unsigned int key);
+
+#endif
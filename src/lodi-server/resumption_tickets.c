@@ -0,0 +1,141 @@
+/*
+ * See resumption_tickets.h
+ */
+
+#include "resumption_tickets.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/random.h>
+
+#include "shared.h"
+#include "util/buffers.h"
+
+#define TICKET_KEY_LENGTH 16
+#define TICKET_PAYLOAD_LENGTH (3 * sizeof(uint32_t) + sizeof(uint64_t))
+
+#define ROTATE_LEFT(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+static uint64_t keyWords[2]; // written once before the workers start, read-only afterward
+static long ticketTtlS = DEFAULT_TICKET_TTL_S;
+
+static int loadKey(const char *hex, unsigned char *key);
+
+static unsigned long computeMac(unsigned int userID, unsigned int generation, const ClientHandle *handle,
+                                unsigned long expiry);
+
+static uint64_t sipHash(const unsigned char *in, size_t length);
+
+int initResumptionTickets() {
+  unsigned char key[TICKET_KEY_LENGTH];
+  const char *configured = getenv("LODI_TICKET_KEY");
+  if (configured != NULL) {
+    if (loadKey(configured, key) == ERROR) {
+      printf("[ERROR] LODI_TICKET_KEY must be %d hex digits\n", 2 * TICKET_KEY_LENGTH);
+      return ERROR;
+    }
+  } else if (getrandom(key, sizeof(key), 0) != sizeof(key)) {
+    printf("[ERROR] Failed to generate a resumption ticket key\n");
+    return ERROR;
+  }
+  memcpy(keyWords, key, sizeof(keyWords));
+
+  const char *ttl = getenv("LODI_TICKET_TTL_S");
+  if (ttl != NULL && strtol(ttl, NULL, 10) > 0) {
+    ticketTtlS = strtol(ttl, NULL, 10);
+  }
+  return SUCCESS;
+}
+
+void issueTicket(const unsigned int userID, const unsigned int generation, const ClientHandle *handle,
+                 unsigned long *expiryOut, unsigned long *macOut) {
+  *expiryOut = (unsigned long) time(NULL) + ticketTtlS;
+  *macOut = computeMac(userID, generation, handle, *expiryOut);
+}
+
+bool isTicketValid(const unsigned int userID, const unsigned int generation, const ClientHandle *handle,
+                   const unsigned long expiry, const unsigned long mac) {
+  if (expiry < (unsigned long) time(NULL)) {
+    return false;
+  }
+  return computeMac(userID, generation, handle, expiry) == mac;
+}
+
+/**
+ * @param hex key as hex digits
+ * @param key where to write the decoded key
+ * @return SUCCESS, or ERROR if hex isn't exactly TICKET_KEY_LENGTH bytes of hex digits
+ */
+static int loadKey(const char *hex, unsigned char *key) {
+  if (strlen(hex) != 2 * TICKET_KEY_LENGTH) {
+    return ERROR;
+  }
+  for (int i = 0; i < TICKET_KEY_LENGTH; i++) {
+    unsigned int byte;
+    if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+      return ERROR;
+    }
+    key[i] = byte;
+  }
+  return SUCCESS;
+}
+
+static unsigned long computeMac(const unsigned int userID, const unsigned int generation, const ClientHandle *handle,
+                                const unsigned long expiry) {
+  char payload[TICKET_PAYLOAD_LENGTH];
+  size_t offset = 0;
+  appendUint32(payload, &offset, userID);
+  appendUint32(payload, &offset, generation);
+  appendUint64(payload, &offset, expiry);
+  memcpy(payload + offset, &handle->clientAddr.sin_addr.s_addr, sizeof(uint32_t)); // already network order
+  return sipHash((unsigned char *) payload, sizeof(payload));
+}
+
+#define SIP_ROUND(v0, v1, v2, v3) \
+  do { \
+    v0 += v1; v1 = ROTATE_LEFT(v1, 13); v1 ^= v0; v0 = ROTATE_LEFT(v0, 32); \
+    v2 += v3; v3 = ROTATE_LEFT(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTATE_LEFT(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTATE_LEFT(v1, 17); v1 ^= v2; v2 = ROTATE_LEFT(v2, 32); \
+  } while (0)
+
+/**
+ * SipHash-2-4 - a keyed hash that's short enough to fit a ticket, yet can't be forged without the key.
+ *
+ * @param in bytes to hash
+ * @param length number of bytes
+ * @return the 64-bit MAC
+ */
+static uint64_t sipHash(const unsigned char *in, const size_t length) {
+  uint64_t v0 = 0x736f6d6570736575ULL ^ keyWords[0];
+  uint64_t v1 = 0x646f72616e646f6dULL ^ keyWords[1];
+  uint64_t v2 = 0x6c7967656e657261ULL ^ keyWords[0];
+  uint64_t v3 = 0x7465646279746573ULL ^ keyWords[1];
+
+  const size_t tail = length & 7;
+  for (size_t i = 0; i < length - tail; i += 8) {
+    uint64_t word;
+    memcpy(&word, in + i, sizeof(word));
+    v3 ^= word;
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    v0 ^= word;
+  }
+  uint64_t last = (uint64_t) length << 56;
+  for (size_t i = 0; i < tail; i++) {
+    last |= (uint64_t) in[length - tail + i] << (8 * i);
+  }
+  v3 ^= last;
+  SIP_ROUND(v0, v1, v2, v3);
+  SIP_ROUND(v0, v1, v2, v3);
+  v0 ^= last;
+
+  v2 ^= 0xff;
+  for (int i = 0; i < 4; i++) {
+    SIP_ROUND(v0, v1, v2, v3);
+  }
+  return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,53 @@
+/**
+ * Resumption tickets let a user who has logged in re-establish their session without another signature check and TFA
+ * push, e.g. after their connection was closed by a Lodi Server restart. A ticket is issued with every ackLogin, and
+ * is presented in a resume request over the new connection.
+ *
+ * A ticket is the wall-clock time it expires at plus a MAC over (userID, generation, expiry, client IP), keyed by a
+ * secret shared by every worker, so tickets don't need to be stored and are honored by whichever worker accepts the
+ * connection. The generation is the user's, from the login repository - a logout bumps it, so tickets issued before
+ * the logout no longer verify. Generations live in memory, so a restart forgets logouts made before it. The
+ * key is read from LODI_TICKET_KEY (32 hex digits) if set, so tickets outlive a restart; otherwise it's random, and a
+ * restart invalidates every ticket issued before it.
+ */
+
+#ifndef COSC522_LODI_RESUMPTION_TICKETS_H
+#define COSC522_LODI_RESUMPTION_TICKETS_H
+#include <stdbool.h>
+
+#include "domain/domain.h"
+
+#define DEFAULT_TICKET_TTL_S 300
+
+/**
+ * Loads or generates the ticket key. Called once, before any worker starts.
+ *
+ * @return SUCCESS or ERROR
+ */
+int initResumptionTickets();
+
+/**
+ * Issues a ticket for a user that has just logged in or resumed.
+ *
+ * @param userID user to issue the ticket to
+ * @param generation the user's current ticket generation
+ * @param handle connection the user is logged in over
+ * @param expiryOut wall-clock second the ticket expires at
+ * @param macOut the ticket's MAC
+ */
+void issueTicket(unsigned int userID, unsigned int generation, const ClientHandle *handle, unsigned long *expiryOut,
+                 unsigned long *macOut);
+
+/**
+ * @param userID user presenting the ticket
+ * @param generation the user's current ticket generation
+ * @param handle connection the ticket is presented over
+ * @param expiry the ticket's expiry, as issued
+ * @param mac the ticket's MAC, as issued
+ * @return true if the ticket was issued to the user at the same IP address since they last logged out, and hasn't
+ * expired
+ */
+bool isTicketValid(unsigned int userID, unsigned int generation, const ClientHandle *handle, unsigned long expiry,
+                   unsigned long mac);
+
+#endif
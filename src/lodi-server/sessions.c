@@ -0,0 +1,39 @@
+/*
+ * See sessions.h
+ */
+
+#include "sessions.h"
+
+#include <stdlib.h>
+
+#include "shared.h"
+
+int initSessions(Sessions *table) {
+  return createMap(&table->sessions);
+}
+
+int bindSession(Sessions *table, const unsigned int userID, const ClientHandle *handle) {
+  Session *session;
+  if (table->sessions->get(table->sessions, userID, (void **) &session) != SUCCESS) {
+    session = malloc(sizeof(Session));
+    if (session == NULL || table->sessions->add(table->sessions, userID, session) == ERROR) {
+      free(session);
+      return ERROR;
+    }
+  }
+  session->clientSock = handle->clientSock;
+  session->connectionID = handle->connectionID;
+  return SUCCESS;
+}
+
+bool hasSession(Sessions *table, const unsigned int userID, const ClientHandle *handle) {
+  const Session *session;
+  return table->sessions->get(table->sessions, userID, (void **) &session) == SUCCESS
+         && session->clientSock == handle->clientSock
+         && session->connectionID == handle->connectionID;
+}
+
+void unbindSession(Sessions *table, const unsigned int userID) {
+  // the map frees the session
+  table->sessions->remove(table->sessions, userID, NULL);
+}
@@ -0,0 +1,60 @@
+/**
+ * Sessions a Lodi worker has established for users logged in over its connections. A login's signature and TFA push
+ * authenticate the connection it arrived on, so later requests from the same user over the same connection are
+ * authorized by looking the session up, without checking their signature again.
+ *
+ * A session is keyed by userID and bound to the connection's socket and connectionID, so a socket that's reused by a
+ * new connection never inherits the session of the old one.
+ */
+
+#ifndef COSC522_LODI_SESSIONS_H
+#define COSC522_LODI_SESSIONS_H
+#include <stdbool.h>
+
+#include "collections/int_map.h"
+#include "domain/domain.h"
+
+typedef struct Session {
+  int clientSock;
+  unsigned int connectionID;
+} Session;
+
+typedef struct Sessions {
+  IntMap *sessions; // userID -> Session
+} Sessions;
+
+/**
+ * Initializes an empty table.
+ *
+ * @param table table to initialize
+ * @return SUCCESS or ERROR
+ */
+int initSessions(Sessions *table);
+
+/**
+ * Establishes a session for a user over a connection, replacing any session the user already has.
+ *
+ * @param table table to add to
+ * @param userID user that has logged in
+ * @param handle connection the user logged in over
+ * @return SUCCESS or ERROR
+ */
+int bindSession(Sessions *table, unsigned int userID, const ClientHandle *handle);
+
+/**
+ * @param table table to search
+ * @param userID user a request claims to be from
+ * @param handle connection the request arrived on
+ * @return true if the user has a session bound to the connection
+ */
+bool hasSession(Sessions *table, unsigned int userID, const ClientHandle *handle);
+
+/**
+ * Ends a user's session, if they have one.
+ *
+ * @param table table to remove from
+ * @param userID user that has logged out, or whose connection has closed
+ */
+void unbindSession(Sessions *table, unsigned int userID);
+
+#endif
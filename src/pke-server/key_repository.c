@@ -1,39 +1,33 @@
 /**
  * Provides persistence for registered User public keys
  **/
-#include <stdlib.h>
-
-#include "collections/int_map.h"
+#include "collections/specialized.h"
 #include "key_repository.h"
 #include "shared.h"
 
-IntMap *keyStore = NULL;
+static U32Map keyStore; // userId -> publicKey, stored inline
 
 /**
- * Persists a public key
+ * Persists a public key, replacing any key already registered for the user
  * @param userId
  * @param publicKey
  * @return ERROR, SUCCESS
  */
 int addKey(unsigned int userId, unsigned int publicKey) {
-  if (!keyStore) {
-    createMap(&keyStore);
-  }
-  unsigned *toPersist = malloc(sizeof(unsigned int));
-  *toPersist = publicKey;
-  keyStore->add(keyStore, userId, toPersist);
-  return SUCCESS;
+  return u32MapPut(&keyStore, userId, publicKey);
 }
 
 /**
  * Retrieves publicKey
  * @param userId user to retrieve for
  * @param publicKey  output, the public key
- * @return ERROR, SUCCESS
+ * @return NOT_FOUND, SUCCESS
  */
-int getKey(unsigned int userId, unsigned int **publicKey) {
-  if (!keyStore) {
-    createMap(&keyStore);
+int getKey(unsigned int userId, unsigned int *publicKey) {
+  const unsigned int *stored = u32MapGet(&keyStore, userId);
+  if (stored == NULL) {
+    return NOT_FOUND;
   }
-  return keyStore->get(keyStore, userId, (void **) publicKey);
+  *publicKey = *stored;
+  return SUCCESS;
 }
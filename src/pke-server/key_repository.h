@@ -6,7 +6,7 @@
 #define COSC522_LODI_KEY_REPOSITORY_H
 
 /**
- * Persists a public key
+ * Persists a public key, replacing any key already registered for the user
  * @param userId
  * @param publicKey
  * @return ERROR, SUCCESS
@@ -17,8 +17,8 @@ int addKey(unsigned int userId, unsigned int publicKey);
  * Retrieves publicKey
  * @param userId user to retrieve for
  * @param publicKey  output, the public key
- * @return ERROR, SUCCESS
+ * @return NOT_FOUND, SUCCESS
  */
-int getKey(unsigned int userId, unsigned int **publicKey);
+int getKey(unsigned int userId, unsigned int *publicKey);
 
 #endif
@@ -5,6 +5,7 @@
  *     i) Persists public key in key repository
  *   2)  Retrieves public keys
  *     i) Key is fetched from key repository
+ *   3)  Tells subscribed servers, such as Lodi workers caching keys, whenever a user's key changes
  **/
 
 #include <stdio.h>
@@ -12,9 +13,19 @@
 #include "domain/pke.h"
 #include "key_repository.h"
 #include "shared.h"
+#include "subscriber_repository.h"
+
+#define PKE_BATCH 64
 
 static DomainServer *pkeServer = NULL;
 
+static int handleRequest(PClientToPKServer *receivedMessage, PKServerToPClientOrLodiServer *responseMessage,
+                         bool *isKeyChangedOut);
+
+static void handleSubscribe(const ClientHandle *subscriber);
+
+static void broadcastInvalidation(unsigned int userID);
+
 int main() {
   if (initPKEServer(&pkeServer) == ERROR) {
     printf("init failed");
@@ -27,44 +38,125 @@ int main() {
 
   printf("Started PKE server!\n");
 
-  while (true) {
-    ClientHandle receiveHandle;
-    PKServerToLodiClient receivedMessage;
+  // requests are drained and answered in batches, a system call each way per batch
+  PClientToPKServer requests[PKE_BATCH];
+  ClientHandle requestHandles[PKE_BATCH];
+  PKServerToPClientOrLodiServer responses[PKE_BATCH];
+  ClientHandle responseHandles[PKE_BATCH];
+  unsigned int changedUserIDs[PKE_BATCH];
 
-    if (pkeServer->receive(pkeServer, (UserMessage *) &receivedMessage, &receiveHandle) == ERROR) {
+  while (true) {
+    int requestCount;
+    if (pkeServer->receiveBatch(pkeServer, requests, sizeof(PClientToPKServer), requestHandles, PKE_BATCH,
+                                &requestCount) == ERROR) {
       printf("Failed to handle incoming PClientToPKServer message.\n");
       continue;
     }
-    PKServerToPClientOrLodiServer responseMessage = {
-      .userID = receivedMessage.userID,
-    };
-
-    if (receivedMessage.messageType == registerKey) {
-      printf("Received registerKey message \n");
-      addKey(receivedMessage.userID, receivedMessage.publicKey);
-      responseMessage.messageType = ackRegisterKey;
-      responseMessage.publicKey = receivedMessage.publicKey;
-      printf("Added publicKey=%u for userId=%u\n", responseMessage.publicKey, responseMessage.userID);
-    } else if (receivedMessage.messageType == requestKey) {
-      printf("Received requestKey message \n");
-      unsigned int *publicKey;
-      if (getKey(receivedMessage.userID, &publicKey) != SUCCESS) {
-        printf("publicKey=%u not found.\n", receivedMessage.publicKey);
-        responseMessage.messageType = ackPKFail;
-      } else {
-        responseMessage.messageType = responsePublicKey;
-        responseMessage.publicKey = *publicKey;
+
+    int responseCount = 0;
+    int changedCount = 0;
+    for (int i = 0; i < requestCount; i++) {
+      if (requests[i].messageType == subscribeKeys) {
+        handleSubscribe(&requestHandles[i]);
+        continue;
+      }
+      bool isKeyChanged = false;
+      if (handleRequest(&requests[i], &responses[responseCount], &isKeyChanged) == SUCCESS) {
+        responseHandles[responseCount++] = requestHandles[i];
       }
-      printf("Responding to requestKey message with responsePublicKey\n");
+      if (isKeyChanged) {
+        changedUserIDs[changedCount++] = requests[i].userID;
+      }
+    }
+
+    int sentCount;
+    if (pkeServer->sendBatch(pkeServer, responses, sizeof(PKServerToPClientOrLodiServer), responseHandles,
+                             responseCount, &sentCount) == ERROR) {
+      printf("Error while sending messages, sent %d of %d.\n", sentCount, responseCount);
     } else {
-      printf("Warning: Received message with unknown message type. Skipping...\n");
-      continue;
+      printf("Responded to %d clients successfully.\n", sentCount);
     }
+    // sent after the responses, so a subscriber doesn't hold up the client that registered the key
+    for (int i = 0; i < changedCount; i++) {
+      broadcastInvalidation(changedUserIDs[i]);
+    }
+  }
+}
 
-    if (pkeServer->send(pkeServer, (UserMessage *) &responseMessage, &receiveHandle) == ERROR) {
-      printf("Error while sending message.\n");
+/**
+ * Builds the response to a single request.
+ *
+ * @param receivedMessage request
+ * @param responseMessage output - response to send back
+ * @param isKeyChangedOut output - whether the request registered a key different from the user's previous one
+ * @return SUCCESS, or ERROR if the request should go unanswered
+ */
+static int handleRequest(PClientToPKServer *receivedMessage, PKServerToPClientOrLodiServer *responseMessage,
+                         bool *isKeyChangedOut) {
+  responseMessage->userID = receivedMessage->userID;
+  responseMessage->requestID = receivedMessage->requestID;
+
+  if (receivedMessage->messageType == registerKey) {
+    printf("Received registerKey message \n");
+    unsigned int previousKey;
+    *isKeyChangedOut = getKey(receivedMessage->userID, &previousKey) != SUCCESS
+                       || previousKey != receivedMessage->publicKey;
+    addKey(receivedMessage->userID, receivedMessage->publicKey);
+    responseMessage->messageType = ackRegisterKey;
+    responseMessage->publicKey = receivedMessage->publicKey;
+    printf("Added publicKey=%u for userId=%u\n", responseMessage->publicKey, responseMessage->userID);
+  } else if (receivedMessage->messageType == requestKey) {
+    printf("Received requestKey message \n");
+    unsigned int publicKey;
+    if (getKey(receivedMessage->userID, &publicKey) != SUCCESS) {
+      printf("publicKey=%u not found.\n", receivedMessage->publicKey);
+      responseMessage->messageType = ackPKFail;
     } else {
-      printf("Responded to client successfully.\n");
+      responseMessage->messageType = responsePublicKey;
+      responseMessage->publicKey = publicKey;
     }
+    printf("Responding to requestKey message with responsePublicKey\n");
+  } else {
+    printf("Warning: Received message with unknown message type. Skipping...\n");
+    return ERROR;
+  }
+  return SUCCESS;
+}
+
+/**
+ * Subscribes a server to key invalidations, or renews its subscription. Subscriptions aren't acknowledged - a
+ * subscriber renews well within PK_SUBSCRIPTION_TTL_MS, so a lost one is made up for by the next.
+ *
+ * @param subscriber server subscribing
+ */
+static void handleSubscribe(const ClientHandle *subscriber) {
+  if (addSubscriber(subscriber) == ERROR) {
+    printf("Warning: Too many key subscribers, ignoring subscribeKeys message...\n");
+  }
+}
+
+/**
+ * Tells every subscriber that a user's key has changed, so any copy they've cached is stale.
+ *
+ * @param userID user whose key changed
+ */
+static void broadcastInvalidation(const unsigned int userID) {
+  ClientHandle subscribers[MAX_SUBSCRIBERS];
+  const int subscriberCount = getSubscribers(subscribers);
+  if (subscriberCount == 0) {
+    return;
+  }
+  PKServerToPClientOrLodiServer invalidation = {
+    .messageType = invalidateKey,
+    .userID = userID,
+    .requestID = 0,
+    .publicKey = 0
+  };
+  int sentCount;
+  if (pkeServer->broadcast(pkeServer, (UserMessage *) &invalidation, subscribers, subscriberCount, &sentCount)
+      == ERROR) {
+    printf("Error while sending key invalidations, sent %d of %d.\n", sentCount, subscriberCount);
+  } else {
+    printf("Invalidated publicKey for userId=%u at %d subscribers.\n", userID, sentCount);
   }
 }
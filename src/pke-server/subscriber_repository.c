@@ -0,0 +1,53 @@
+/**
+ * Provides persistence for servers subscribed to key invalidations
+ **/
+
+#include "subscriber_repository.h"
+
+#include "domain/pke.h"
+#include "domain/timer_wheel.h"
+#include "shared.h"
+
+typedef struct Subscriber {
+  ClientHandle handle;
+  uint64_t expiresAtMs; // 0 if the slot is free
+} Subscriber;
+
+// there are only ever a handful of subscribers, one per Lodi worker, so they're scanned rather than hashed
+static Subscriber subscribers[MAX_SUBSCRIBERS];
+
+static bool isSameSubscriber(const ClientHandle *a, const ClientHandle *b) {
+  return a->clientAddr.sin_addr.s_addr == b->clientAddr.sin_addr.s_addr
+         && a->clientAddr.sin_port == b->clientAddr.sin_port;
+}
+
+int addSubscriber(const ClientHandle *subscriberIn) {
+  const uint64_t nowMs = monotonicMs();
+  Subscriber *slot = NULL;
+  for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if (subscribers[i].expiresAtMs > nowMs && isSameSubscriber(&subscribers[i].handle, subscriberIn)) {
+      slot = &subscribers[i];
+      break;
+    }
+    if (slot == NULL && subscribers[i].expiresAtMs <= nowMs) {
+      slot = &subscribers[i];
+    }
+  }
+  if (slot == NULL) {
+    return ERROR;
+  }
+  slot->handle = *subscriberIn;
+  slot->expiresAtMs = nowMs + PK_SUBSCRIPTION_TTL_MS;
+  return SUCCESS;
+}
+
+int getSubscribers(ClientHandle *subscribersOut) {
+  const uint64_t nowMs = monotonicMs();
+  int count = 0;
+  for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if (subscribers[i].expiresAtMs > nowMs) {
+      subscribersOut[count++] = subscribers[i].handle;
+    }
+  }
+  return count;
+}
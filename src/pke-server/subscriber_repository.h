@@ -0,0 +1,30 @@
+/**
+ * Provides persistence for the servers subscribed to key invalidations, such as Lodi workers caching public keys.
+ * A subscription lapses PK_SUBSCRIPTION_TTL_MS after it was last renewed, so a subscriber that goes away is forgotten
+ * without having to say so.
+ */
+
+#ifndef COSC522_LODI_SUBSCRIBER_REPOSITORY_H
+#define COSC522_LODI_SUBSCRIBER_REPOSITORY_H
+
+#include "domain/domain.h"
+
+#define MAX_SUBSCRIBERS 64
+
+/**
+ * Subscribes a server, or renews its subscription.
+ *
+ * @param subscriberIn server to send invalidations to
+ * @return SUCCESS, or ERROR if MAX_SUBSCRIBERS are already subscribed
+ */
+int addSubscriber(const ClientHandle *subscriberIn);
+
+/**
+ * Lists the servers currently subscribed.
+ *
+ * @param subscribersOut caller-allocated array of MAX_SUBSCRIBERS handles
+ * @return number of subscribers written to subscribersOut
+ */
+int getSubscribers(ClientHandle *subscribersOut);
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * Measures decryptTimestamp, encryptTimestamp and encryptTimestampCrt against the division-based modPow they used to be
+ * built on, checking all agree on every input, then the throughput of verifySignatures against verifying one signature at a time.
+ */
+
+#include "util/rsa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_COUNT 1024
+#define DEFAULT_ITERATIONS 2000000
+#define VERIFY_BATCH_SIZE 64
+
+static double elapsedNs(const struct timespec *start, const struct timespec *end);
+
+static double measure(unsigned long (*function)(unsigned long, unsigned long, unsigned long),
+                      const unsigned long *samples, unsigned long exponent, long iterations, unsigned long *checksum);
+
+static double measureBatches(const SignatureCheck *checks, long iterations, unsigned long *checksum);
+
+static double measureCrt(const unsigned long *samples, const CrtPrivateKey *key, long iterations,
+                         unsigned long *checksum);
+
+/**
+ * Usage: rsa_benchmark [iterations]
+ * @return 0, or 1 if the implementations disagree
+ */
+int main(const int argc, char **argv) {
+    const long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    const KeyGenResult keys = generateKeys(P, Q);
+
+    unsigned long timestamps[SAMPLE_COUNT];
+    unsigned long signatures[SAMPLE_COUNT];
+    const unsigned long now = time(NULL);
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        timestamps[i] = now + i;
+        signatures[i] = modPowByDivision(timestamps[i], keys.private, keys.modulus);
+        if (encryptTimestamp(timestamps[i], keys.private, keys.modulus) != signatures[i]
+            || encryptTimestampCrt(timestamps[i], &keys.crt) != signatures[i]
+            || decryptTimestamp(signatures[i], keys.public, keys.modulus) != timestamps[i]) {
+            printf("Mismatch for timestamp=%lu\n", timestamps[i]);
+            return 1;
+        }
+    }
+    printf("publicKey=%lu, privateKey=%lu, modulus=%lu, iterations=%ld\n", keys.public, keys.private, keys.modulus,
+           iterations);
+
+    unsigned long checksum = 0;
+    const double decryptBaseline = measure(modPowByDivision, signatures, keys.public, iterations, &checksum);
+    const double decrypt = measure(modPow, signatures, keys.public, iterations, &checksum);
+    printf("decrypt: division %.1f ns, montgomery %.1f ns, speedup %.2fx\n", decryptBaseline, decrypt,
+           decryptBaseline / decrypt);
+
+    const long encryptIterations = iterations / 8;
+    const double encryptBaseline = measure(modPowByDivision, timestamps, keys.private, encryptIterations, &checksum);
+    const double encrypt = measure(modPow, timestamps, keys.private, encryptIterations, &checksum);
+    const double encryptCrt = measureCrt(timestamps, &keys.crt, encryptIterations, &checksum);
+    printf("encrypt: division %.1f ns, montgomery %.1f ns, speedup %.2fx, crt %.1f ns, speedup %.2fx\n",
+           encryptBaseline, encrypt, encryptBaseline / encrypt, encryptCrt, encryptBaseline / encryptCrt);
+
+    SignatureCheck checks[SAMPLE_COUNT];
+    bool valid[SAMPLE_COUNT];
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        checks[i] = (SignatureCheck){signatures[i], keys.public, timestamps[i] + i % 2}; // every other one is forged
+    }
+    if (verifySignatures(checks, SAMPLE_COUNT, keys.modulus, valid) != SAMPLE_COUNT / 2) {
+        printf("Batch verification mismatch\n");
+        return 1;
+    }
+    const double batch = measureBatches(checks, iterations, &checksum);
+    printf("verify: one at a time %.1f ns, batches of %d %.1f ns, speedup %.2fx\n", decrypt, VERIFY_BATCH_SIZE, batch,
+           decrypt / batch);
+
+    printf("checksum=%lu\n", checksum); // keeps the measured calls from being optimized away
+    return 0;
+}
+
+/**
+ * @param checks SAMPLE_COUNT signatures, verified VERIFY_BATCH_SIZE at a time
+ * @param iterations number of signatures to verify
+ * @param checksum accumulates the number found valid
+ * @return mean ns per signature
+ */
+static double measureBatches(const SignatureCheck *checks, const long iterations, unsigned long *checksum) {
+    bool valid[VERIFY_BATCH_SIZE];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i += VERIFY_BATCH_SIZE) {
+        *checksum += verifySignatures(&checks[i % SAMPLE_COUNT], VERIFY_BATCH_SIZE, MODULUS, valid);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsedNs(&start, &end) / (double) iterations;
+}
+
+/**
+ * @param samples SAMPLE_COUNT timestamps, cycled through
+ * @param key key to sign with
+ * @param iterations number of timestamps to sign
+ * @param checksum accumulates the signatures
+ * @return mean ns per signature
+ */
+static double measureCrt(const unsigned long *samples, const CrtPrivateKey *key, const long iterations,
+                         unsigned long *checksum) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i++) {
+        *checksum += encryptTimestampCrt(samples[i % SAMPLE_COUNT], key);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsedNs(&start, &end) / (double) iterations;
+}
+
+static double elapsedNs(const struct timespec *start, const struct timespec *end) {
+    return (double) (end->tv_sec - start->tv_sec) * 1e9 + (double) (end->tv_nsec - start->tv_nsec);
+}
+
+/**
+ * @param function modPow implementation to measure
+ * @param samples SAMPLE_COUNT bases, cycled through
+ * @param exponent exponent to raise each base to
+ * @param iterations number of calls to time
+ * @param checksum accumulates the results
+ * @return mean ns per call
+ */
+static double measure(unsigned long (*function)(unsigned long, unsigned long, unsigned long),
+                      const unsigned long *samples, const unsigned long exponent, const long iterations,
+                      unsigned long *checksum) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i++) {
+        *checksum += function(samples[i % SAMPLE_COUNT], exponent, MODULUS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsedNs(&start, &end) / (double) iterations;
+}
@@ -20,12 +20,16 @@ int main() {
     const unsigned int q = 1000151;
     const KeyGenResult keys = generateKeys(p, q);
     printf("publicKey=%ld, privateKey=%ld, modulus=%ld\n", keys.public, keys.private, keys.modulus);
+    printf("CRT privateKey: p=%lu, q=%lu, dP=%lu, dQ=%lu, qInv=%lu\n", keys.crt.p, keys.crt.q, keys.crt.dP,
+           keys.crt.dQ, keys.crt.qInv);
     unsigned long timestamp;
     time(&timestamp);
     const unsigned long encrypted = encryptTimestamp(timestamp, keys.private, keys.modulus);
     const unsigned long decrypted = decryptTimestamp(encrypted, keys.public, keys.modulus);
-    printf("timestamp=%ld, encrypted=%ld, decrypted=%ld\n", timestamp, encrypted, decrypted);
-    if (timestamp == decrypted) {
+    const unsigned long encryptedCrt = encryptTimestampCrt(timestamp, &keys.crt);
+    printf("timestamp=%ld, encrypted=%ld, decrypted=%ld, encryptedCrt=%ld\n", timestamp, encrypted, decrypted,
+           encryptedCrt);
+    if (timestamp == decrypted && encryptedCrt == encrypted) {
         printf("Encryption/decryption success!\n");
     } else {
         printf("Encryption/decryption failure...\n");
@@ -0,0 +1,330 @@
+/**
+ * See id_set.h
+ *
+ * A roaring bitmap: ids are split by their high 16 bits into chunks, kept in an array sorted by those bits, and each
+ * chunk stores the low 16 bits of its ids in whichever of two containers is smaller:
+ *   - a sorted array of 16-bit values, 2 bytes per id, while the chunk holds at most ARRAY_MAX ids
+ *   - a 65536-bit bitmap, a fixed 8KB, once it holds more - under 2 bytes per id from there on
+ * Membership is a binary search over the chunks, then a binary search or a bit test within one, so it's O(log n).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "collections/id_set.h"
+#include "shared.h"
+
+#define ARRAY_MAX 4096 // ids per array container, past which a bitmap is smaller
+#define BITMAP_WORDS (65536 / 64)
+#define INITIAL_ARRAY_CAPACITY 4
+
+typedef struct Container {
+    uint16_t high; // high 16 bits shared by every id in the container
+    int cardinality;
+    int capacity; // of values, for an array container, 0 for a bitmap
+    union {
+        uint16_t *values; // sorted low 16 bits
+        uint64_t *bitmap; // BITMAP_WORDS words, bit n set if low bits n are in the set
+    };
+} Container;
+
+typedef struct RoaringSet {
+    IdSet base;
+    Container *containers; // sorted by high
+    int containerCount;
+    int containerCapacity;
+} RoaringSet;
+
+static int findContainer(const RoaringSet *impl, uint16_t high);
+
+static int findValue(const Container *container, uint16_t low);
+
+static Container *insertContainer(RoaringSet *impl, int index, uint16_t high);
+
+static void removeContainer(RoaringSet *impl, int index);
+
+static int toBitmapContainer(Container *container);
+
+static void toArrayContainer(Container *container);
+
+static int add(IdSet *set, const unsigned int id) {
+    RoaringSet *impl = (RoaringSet *) set;
+    const uint16_t high = id >> 16;
+    const uint16_t low = id & 0xffff;
+
+    int index = findContainer(impl, high);
+    Container *container;
+    if (index >= 0) {
+        container = &impl->containers[index];
+    } else {
+        container = insertContainer(impl, -index - 1, high);
+        if (container == NULL) {
+            return ERROR;
+        }
+    }
+
+    if (container->capacity == 0) {
+        uint64_t *word = &container->bitmap[low / 64];
+        const uint64_t bit = (uint64_t) 1 << (low % 64);
+        if ((*word & bit) == 0) {
+            *word |= bit;
+            container->cardinality++;
+            set->count++;
+        }
+        return SUCCESS;
+    }
+
+    index = findValue(container, low);
+    if (index >= 0) {
+        return SUCCESS;
+    }
+    index = -index - 1;
+    if (container->cardinality == ARRAY_MAX) {
+        if (toBitmapContainer(container) == ERROR) {
+            return ERROR;
+        }
+        return add(set, id);
+    }
+    if (container->cardinality == container->capacity) {
+        int capacity = container->capacity + container->capacity / 2; // grow by half, keeping the slack under 1 byte per id
+        if (capacity > ARRAY_MAX) {
+            capacity = ARRAY_MAX;
+        }
+        uint16_t *values = realloc(container->values, capacity * sizeof(uint16_t));
+        if (values == NULL) {
+            return ERROR;
+        }
+        container->values = values;
+        container->capacity = capacity;
+    }
+    memmove(&container->values[index + 1], &container->values[index],
+            (container->cardinality - index) * sizeof(uint16_t));
+    container->values[index] = low;
+    container->cardinality++;
+    set->count++;
+    return SUCCESS;
+}
+
+static int remove(IdSet *set, const unsigned int id) {
+    RoaringSet *impl = (RoaringSet *) set;
+    const uint16_t low = id & 0xffff;
+
+    const int containerIndex = findContainer(impl, id >> 16);
+    if (containerIndex < 0) {
+        return NOT_FOUND;
+    }
+    Container *container = &impl->containers[containerIndex];
+
+    if (container->capacity == 0) {
+        uint64_t *word = &container->bitmap[low / 64];
+        const uint64_t bit = (uint64_t) 1 << (low % 64);
+        if ((*word & bit) == 0) {
+            return NOT_FOUND;
+        }
+        *word &= ~bit;
+        container->cardinality--;
+        // converting back only well below ARRAY_MAX keeps a chunk hovering around it from flipping on every change
+        if (container->cardinality <= ARRAY_MAX / 2) {
+            toArrayContainer(container);
+        }
+    } else {
+        const int index = findValue(container, low);
+        if (index < 0) {
+            return NOT_FOUND;
+        }
+        container->cardinality--;
+        memmove(&container->values[index], &container->values[index + 1],
+                (container->cardinality - index) * sizeof(uint16_t));
+    }
+
+    set->count--;
+    if (container->cardinality == 0) {
+        removeContainer(impl, containerIndex);
+    }
+    return SUCCESS;
+}
+
+static bool contains(IdSet *set, const unsigned int id) {
+    const RoaringSet *impl = (RoaringSet *) set;
+    const uint16_t low = id & 0xffff;
+
+    const int index = findContainer(impl, id >> 16);
+    if (index < 0) {
+        return false;
+    }
+    const Container *container = &impl->containers[index];
+    if (container->capacity == 0) {
+        return container->bitmap[low / 64] >> (low % 64) & 1;
+    }
+    return findValue(container, low) >= 0;
+}
+
+static void copyIds(IdSet *set, unsigned int *ids) {
+    const RoaringSet *impl = (RoaringSet *) set;
+    for (int i = 0; i < impl->containerCount; i++) {
+        const Container *container = &impl->containers[i];
+        const unsigned int high = (unsigned int) container->high << 16;
+        if (container->capacity != 0) {
+            for (int j = 0; j < container->cardinality; j++) {
+                *ids++ = high | container->values[j];
+            }
+            continue;
+        }
+        for (int word = 0; word < BITMAP_WORDS; word++) {
+            for (uint64_t bits = container->bitmap[word]; bits != 0; bits &= bits - 1) {
+                *ids++ = high | (word * 64 + __builtin_ctzll(bits));
+            }
+        }
+    }
+}
+
+static void destroy(IdSet **set) {
+    if (!set || !*set) {
+        return;
+    }
+
+    RoaringSet *impl = (RoaringSet *) *set;
+    for (int i = 0; i < impl->containerCount; i++) {
+        free(impl->containers[i].values); // same pointer as bitmap
+    }
+    free(impl->containers);
+    free(impl);
+    *set = NULL;
+}
+
+int createIdSet(IdSet **set) {
+    if (!set) {
+        return ERROR;
+    }
+
+    RoaringSet *impl = calloc(1, sizeof(RoaringSet));
+    if (!impl) {
+        return ERROR;
+    }
+
+    impl->base.add = add;
+    impl->base.remove = remove;
+    impl->base.contains = contains;
+    impl->base.toArray = copyIds;
+    impl->base.destroy = destroy;
+
+    *set = (IdSet *) impl;
+    return SUCCESS;
+}
+
+/**
+ * @return the index of the container for the high bits, or -(index it would be inserted at) - 1
+ */
+static int findContainer(const RoaringSet *impl, const uint16_t high) {
+    int lowIndex = 0;
+    int highIndex = impl->containerCount - 1;
+    while (lowIndex <= highIndex) {
+        const int middle = (lowIndex + highIndex) / 2;
+        if (impl->containers[middle].high < high) {
+            lowIndex = middle + 1;
+        } else if (impl->containers[middle].high > high) {
+            highIndex = middle - 1;
+        } else {
+            return middle;
+        }
+    }
+    return -lowIndex - 1;
+}
+
+/**
+ * @param container an array container
+ * @return the index of the low bits, or -(index they would be inserted at) - 1
+ */
+static int findValue(const Container *container, const uint16_t low) {
+    int lowIndex = 0;
+    int highIndex = container->cardinality - 1;
+    while (lowIndex <= highIndex) {
+        const int middle = (lowIndex + highIndex) / 2;
+        if (container->values[middle] < low) {
+            lowIndex = middle + 1;
+        } else if (container->values[middle] > low) {
+            highIndex = middle - 1;
+        } else {
+            return middle;
+        }
+    }
+    return -lowIndex - 1;
+}
+
+/**
+ * Inserts an empty array container.
+ *
+ * @return the new container, or NULL if allocation failed
+ */
+static Container *insertContainer(RoaringSet *impl, const int index, const uint16_t high) {
+    uint16_t *values = malloc(INITIAL_ARRAY_CAPACITY * sizeof(uint16_t));
+    if (values == NULL) {
+        return NULL;
+    }
+    if (impl->containerCount == impl->containerCapacity) {
+        const int capacity = impl->containerCapacity == 0 ? 1 : impl->containerCapacity * 2;
+        Container *containers = realloc(impl->containers, capacity * sizeof(Container));
+        if (containers == NULL) {
+            free(values);
+            return NULL;
+        }
+        impl->containers = containers;
+        impl->containerCapacity = capacity;
+    }
+    memmove(&impl->containers[index + 1], &impl->containers[index],
+            (impl->containerCount - index) * sizeof(Container));
+    impl->containerCount++;
+    impl->containers[index] = (Container) {
+        .high = high, .cardinality = 0, .capacity = INITIAL_ARRAY_CAPACITY, .values = values
+    };
+    return &impl->containers[index];
+}
+
+static void removeContainer(RoaringSet *impl, const int index) {
+    free(impl->containers[index].values);
+    impl->containerCount--;
+    memmove(&impl->containers[index], &impl->containers[index + 1],
+            (impl->containerCount - index) * sizeof(Container));
+}
+
+/**
+ * Converts an array container to a bitmap.
+ *
+ * @return SUCCESS, or ERROR if allocation failed, leaving the container as it was
+ */
+static int toBitmapContainer(Container *container) {
+    uint64_t *bitmap = calloc(BITMAP_WORDS, sizeof(uint64_t));
+    if (bitmap == NULL) {
+        return ERROR;
+    }
+    for (int i = 0; i < container->cardinality; i++) {
+        bitmap[container->values[i] / 64] |= (uint64_t) 1 << (container->values[i] % 64);
+    }
+    free(container->values);
+    container->bitmap = bitmap;
+    container->capacity = 0;
+    return SUCCESS;
+}
+
+/**
+ * Converts a bitmap container to an array, leaving it as a bitmap if allocation fails.
+ */
+static void toArrayContainer(Container *container) {
+    const int capacity = container->cardinality > INITIAL_ARRAY_CAPACITY
+                             ? container->cardinality
+                             : INITIAL_ARRAY_CAPACITY;
+    uint16_t *values = malloc(capacity * sizeof(uint16_t));
+    if (values == NULL) {
+        return;
+    }
+    int count = 0;
+    for (int word = 0; word < BITMAP_WORDS; word++) {
+        for (uint64_t bits = container->bitmap[word]; bits != 0; bits &= bits - 1) {
+            values[count++] = word * 64 + __builtin_ctzll(bits);
+        }
+    }
+    free(container->bitmap);
+    container->values = values;
+    container->capacity = capacity;
+}
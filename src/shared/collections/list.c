@@ -1,85 +1,106 @@
 /**
  * See list.h
+ *
+ * Elements are kept in one contiguous array that doubles when it fills, so indexed access is constant time and a scan
+ * walks sequential memory rather than chasing a pointer per element.
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "collections/list.h"
 #include "shared.h"
 
-/**
- * Encapsulates a single element
- */
-typedef struct Node {
-    struct Node *prev;
-    struct Node *next;
-    void *element; // Caller-owned pointer
-} Node;
+#define INITIAL_CAPACITY 8
 
 /**
- * Encapsulates the state of a LinkedList
+ * Encapsulates the state of an ArrayList
  */
-typedef struct LinkedList {
+typedef struct ArrayList {
     List base;
-    Node sentinel;
-} LinkedList;
+    void **elements; // Caller-owned pointers, allocated on the first append
+    int capacity;
+} ArrayList;
 
 static int append(List *list, void *element) {
     if (!element) return ERROR;
 
-    LinkedList *impl = (LinkedList *) list;
-
-    Node *node = malloc(sizeof(Node));
-    if (!node) return ERROR;
-
-    node->element = element;
-
-    Node *tail = impl->sentinel.prev;
-    node->next = &impl->sentinel;
-    node->prev = tail;
-    tail->next = node;
-    impl->sentinel.prev = node;
+    ArrayList *impl = (ArrayList *) list;
+    if (list->length == impl->capacity) {
+        const int capacity = impl->capacity == 0 ? INITIAL_CAPACITY : impl->capacity * 2;
+        void **elements = realloc(impl->elements, capacity * sizeof(void *));
+        if (!elements) return ERROR;
+        impl->elements = elements;
+        impl->capacity = capacity;
+    }
 
-    list->length++;
+    impl->elements[list->length++] = element;
     return SUCCESS;
 }
 
 static int get(List *list, int idx, void **element) {
-    LinkedList *impl = (LinkedList *) list;
+    const ArrayList *impl = (ArrayList *) list;
     if (idx < 0 || idx >= list->length || !element) {
         return ERROR;
     }
 
-    Node *n = impl->sentinel.next;
-    for (int i = 0; i < idx; i++) {
-        n = n->next;
-    }
-
-    *element = n->element;
+    *element = impl->elements[idx];
     return SUCCESS;
 }
 
 static int remove(List *list, int idx, void **element) {
-    LinkedList *impl = (LinkedList *) list;
+    ArrayList *impl = (ArrayList *) list;
     if (idx < 0 || idx >= list->length) {
         return ERROR;
     }
 
-    Node *n = impl->sentinel.next;
-    for (int i = 0; i < idx; i++) {
-        n = n->next;
+    if (element) {
+        *element = impl->elements[idx]; // Caller reclaims ownership
+    }
+    // else: caller doesn't want it; we do NOT free it
+
+    list->length--;
+    memmove(&impl->elements[idx], &impl->elements[idx + 1], (list->length - idx) * sizeof(void *));
+    return SUCCESS;
+}
+
+static int swapRemove(List *list, int idx, void **element) {
+    ArrayList *impl = (ArrayList *) list;
+    if (idx < 0 || idx >= list->length) {
+        return ERROR;
     }
 
     if (element) {
-        *element = n->element; // Caller reclaims ownership
+        *element = impl->elements[idx]; // Caller reclaims ownership
     }
-    // else: caller doesn't want it; we do NOT free it
 
-    n->prev->next = n->next;
-    n->next->prev = n->prev;
+    impl->elements[idx] = impl->elements[--list->length];
+    return SUCCESS;
+}
 
-    free(n);
-    list->length--;
+static bool next(List *list, ListCursor *cursor, void **element) {
+    const ArrayList *impl = (ArrayList *) list;
+    if (cursor->index < 0 || cursor->index >= list->length || !element) {
+        return false;
+    }
+
+    *element = impl->elements[cursor->index++];
+    return true;
+}
+
+static int removeCurrent(List *list, ListCursor *cursor, void **element) {
+    if (remove(list, cursor->index - 1, element) == ERROR) {
+        return ERROR;
+    }
+    cursor->index--; // the element that followed has shifted into the removed one's place
+    return SUCCESS;
+}
+
+static int swapRemoveCurrent(List *list, ListCursor *cursor, void **element) {
+    if (swapRemove(list, cursor->index - 1, element) == ERROR) {
+        return ERROR;
+    }
+    cursor->index--; // the last element has moved into the removed one's place and hasn't been visited yet
     return SUCCESS;
 }
 
@@ -88,16 +109,9 @@ static void destroy(List **list) {
         return;
     }
 
-    LinkedList *impl = (LinkedList *) *list;
-    Node *n = impl->sentinel.next;
-
-    while (n != &impl->sentinel) {
-        Node *next = n->next;
-        // We do NOT free n->element
-        free(n);
-        n = next;
-    }
-
+    ArrayList *impl = (ArrayList *) *list;
+    // We do NOT free the elements
+    free(impl->elements);
     free(impl);
     *list = NULL;
 }
@@ -107,7 +121,7 @@ int createList(List **list) {
         return ERROR;
     }
 
-    LinkedList *impl = malloc(sizeof(LinkedList));
+    ArrayList *impl = malloc(sizeof(ArrayList));
     if (!impl) {
         return ERROR;
     }
@@ -116,11 +130,14 @@ int createList(List **list) {
     impl->base.append = append;
     impl->base.get = get;
     impl->base.remove = remove;
+    impl->base.swapRemove = swapRemove;
+    impl->base.next = next;
+    impl->base.removeCurrent = removeCurrent;
+    impl->base.swapRemoveCurrent = swapRemoveCurrent;
     impl->base.destroy = destroy;
 
-    impl->sentinel.next = &impl->sentinel;
-    impl->sentinel.prev = &impl->sentinel;
-    impl->sentinel.element = NULL;
+    impl->elements = NULL;
+    impl->capacity = 0;
 
     *list = (List *) impl;
     return SUCCESS;
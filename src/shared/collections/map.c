@@ -1,46 +1,78 @@
 /**
 * See map.h
+ *
+ * An open-addressing hash table using Robin Hood hashing: every entry sits in one flat array of slots, and an insert
+ * that probes past an entry closer to its home slot than the one being inserted takes that slot over, carrying the
+ * displaced entry on. Probe sequences stay short and even at high load, so a lookup touches one or two cache lines
+ * instead of walking a bucket's linked list.
+ *
+ * The table doubles once it's 7/8 full. Rather than moving every entry at once, the old table is kept alongside the
+ * new one and drained REHASH_STEP slots at a time by each add and remove, so no single insert pays for the whole
+ * rehash. Until it's drained, lookups check both tables.
  */
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "collections/int_map.h"
-#include "collections/list.h"
 #include "shared.h"
 
-#define BUCKETS 100
+#define INITIAL_CAPACITY 16
+#define REHASH_STEP 8 // old slots migrated per add or remove, enough to drain the old table long before the new one fills
 
-typedef struct KeyValue {
+typedef struct Slot {
     unsigned int key;
-    void *value; // pointer to caller-owned data
-} KeyValue;
+    unsigned int distance; // 1 + how far the slot is from the key's home slot, 0 if the slot is empty
+    void *value; // pointer to caller-owned data, NULL for an entry removed from a table being drained
+} Slot;
+
+typedef struct Table {
+    Slot *slots;
+    unsigned int capacity; // a power of 2
+    unsigned int shift; // 32 - log2(capacity), turns a hash into a slot index
+    unsigned int count;
+} Table;
 
 typedef struct IntMapImpl {
     IntMap base;
-    List *buckets[BUCKETS];
+    Table current;
+    Table draining; // the table being rehashed into current, if slots isn't NULL
+    unsigned int drainIndex; // next slot of draining to migrate
 } IntMapImpl;
 
-static unsigned int hash(const unsigned int key) {
-    return key % BUCKETS;
+static int initTable(Table *table, unsigned int capacity);
+
+static Slot *findSlot(const Table *table, unsigned int key);
+
+static void insertSlot(Table *table, unsigned int key, void *value);
+
+static void removeSlot(Table *table, Slot *slot, bool isDraining);
+
+static int grow(IntMapImpl *impl);
+
+static void drain(IntMapImpl *impl, unsigned int slotCount);
+
+/**
+ * Fibonacci hashing - the high bits of the product depend on every bit of the key, so sequential userIDs spread out.
+ */
+static unsigned int homeSlot(const Table *table, const unsigned int key) {
+    return (unsigned int) (key * 2654435769u) >> table->shift;
 }
 
 static int map_get(IntMap *map, const unsigned int key, void **element) {
     if (!element) return ERROR;
 
     const IntMapImpl *impl = (IntMapImpl *) map;
-    List *list = impl->buckets[hash(key)];
-    if (!list) {
-        return NOT_FOUND;
+    const Slot *slot = findSlot(&impl->current, key);
+    if (slot == NULL && impl->draining.slots != NULL) {
+        slot = findSlot(&impl->draining, key);
     }
-
-    KeyValue *kv;
-    for (int i = 0; i < list->length; i++) {
-        if (list->get(list, i, (void **) &kv) == SUCCESS && kv->key == key) {
-            *element = kv->value;
-            return SUCCESS;
-        }
+    if (slot == NULL) {
+        return NOT_FOUND;
     }
-    return NOT_FOUND;
+    *element = slot->value;
+    return SUCCESS;
 }
 
 static int map_add(IntMap *map, const unsigned int key, void *element) {
@@ -49,63 +81,57 @@ static int map_add(IntMap *map, const unsigned int key, void *element) {
     }
 
     IntMapImpl *impl = (IntMapImpl *) map;
-    const unsigned int h = hash(key);
+    if (impl->current.slots == NULL && initTable(&impl->current, INITIAL_CAPACITY) == ERROR) {
+        return ERROR;
+    }
+    drain(impl, REHASH_STEP);
 
-    // Lazy bucket creation
-    if (!impl->buckets[h]) {
-        if (createList(&impl->buckets[h]) != SUCCESS)
-            return ERROR;
+    Slot *slot = findSlot(&impl->current, key);
+    if (slot == NULL && impl->draining.slots != NULL) {
+        slot = findSlot(&impl->draining, key);
+    }
+    if (slot != NULL) {
+        slot->value = element;
+        return SUCCESS;
     }
 
-    KeyValue *kv = malloc(sizeof(KeyValue));
-    if (!kv) {
+    if ((impl->current.count + 1) * 8 > impl->current.capacity * 7 && grow(impl) == ERROR) {
         return ERROR;
     }
-
-    kv->key = key;
-    kv->value = element;
-
-    return impl->buckets[h]->append(impl->buckets[h], kv);
+    insertSlot(&impl->current, key, element);
+    return SUCCESS;
 }
 
 static int map_remove(IntMap *map, const unsigned int key, void **out) {
     IntMapImpl *impl = (IntMapImpl *) map;
-    List *list = impl->buckets[hash(key)];
-    if (!list) return ERROR;
+    drain(impl, REHASH_STEP);
 
-    KeyValue *kv;
-    for (int i = 0; i < list->length; i++) {
-        if (list->get(list, i, (void **) &kv) == SUCCESS && kv->key == key) {
-            if (out)
-                *out = kv->value; // caller owns
-            else
-                free(kv->value); // map owns
+    Table *table = &impl->current;
+    Slot *slot = findSlot(table, key);
+    if (slot == NULL && impl->draining.slots != NULL) {
+        table = &impl->draining;
+        slot = findSlot(table, key);
+    }
+    if (slot == NULL) {
+        return NOT_FOUND;
+    }
 
-            free(kv); // free wrapper
+    if (out)
+        *out = slot->value; // caller owns
+    else
+        free(slot->value); // map owns
 
-            return list->remove(list, i, NULL);
-        }
-    }
-    return NOT_FOUND;
+    removeSlot(table, slot, table == &impl->draining);
+    return SUCCESS;
 }
 
 static void map_destroy(IntMap **map) {
     if (!map || !*map) return;
 
     IntMapImpl *impl = (IntMapImpl *) (*map);
-
-    for (int i = 0; i < BUCKETS; i++) {
-        if (impl->buckets[i]) {
-            // free KeyValue structs (but not values)
-            KeyValue *kv;
-            List *lst = impl->buckets[i];
-            while (lst->remove(lst, 0, (void **) &kv) == SUCCESS) {
-                free(kv); // free wrapper only
-            }
-            lst->destroy(&lst);
-        }
-    }
-
+    // values are owned by the caller
+    free(impl->current.slots);
+    free(impl->draining.slots);
     free(impl);
     *map = NULL;
 }
@@ -113,13 +139,10 @@ static void map_destroy(IntMap **map) {
 int createMap(IntMap **map) {
     if (!map) return ERROR;
 
-    IntMapImpl *impl = malloc(sizeof(IntMapImpl));
+    // slots are allocated on the first add, so an empty map costs a single small allocation
+    IntMapImpl *impl = calloc(1, sizeof(IntMapImpl));
     if (!impl) return ERROR;
 
-    // Initialize buckets
-    for (int i = 0; i < BUCKETS; i++)
-        impl->buckets[i] = NULL;
-
     impl->base.get = map_get;
     impl->base.add = map_add;
     impl->base.remove = map_remove;
@@ -128,3 +151,121 @@ int createMap(IntMap **map) {
     *map = (IntMap *) impl;
     return SUCCESS;
 }
+
+static int initTable(Table *table, const unsigned int capacity) {
+    table->slots = calloc(capacity, sizeof(Slot));
+    if (table->slots == NULL) {
+        return ERROR;
+    }
+    table->capacity = capacity;
+    table->shift = 32 - __builtin_ctz(capacity);
+    table->count = 0;
+    return SUCCESS;
+}
+
+/**
+ * Probes from the key's home slot. Entries along the way are ordered by their distance from home, so the probe stops
+ * as soon as it reaches an entry closer to home than the key would be.
+ *
+ * @return the key's slot, or NULL if it isn't in the table
+ */
+static Slot *findSlot(const Table *table, const unsigned int key) {
+    if (table->slots == NULL) {
+        return NULL;
+    }
+    const unsigned int mask = table->capacity - 1;
+    unsigned int index = homeSlot(table, key);
+    for (unsigned int distance = 1; table->slots[index].distance >= distance; distance++) {
+        Slot *slot = &table->slots[index];
+        if (slot->key == key && slot->value != NULL) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+    return NULL;
+}
+
+/**
+ * Inserts a key that isn't in the table yet, which must have room for it.
+ */
+static void insertSlot(Table *table, const unsigned int key, void *value) {
+    const unsigned int mask = table->capacity - 1;
+    Slot entry = {.key = key, .distance = 1, .value = value};
+    unsigned int index = homeSlot(table, key);
+    while (table->slots[index].distance != 0) {
+        if (table->slots[index].distance < entry.distance) {
+            // the resident is closer to its home than entry is, so entry takes its slot and the resident moves on
+            const Slot displaced = table->slots[index];
+            table->slots[index] = entry;
+            entry = displaced;
+        }
+        index = (index + 1) & mask;
+        entry.distance++;
+    }
+    table->slots[index] = entry;
+    table->count++;
+}
+
+/**
+ * Removes an entry. In the current table the entries after it shift back a slot, keeping every probe as short as if
+ * the entry had never been inserted. In a table being drained the slot is only marked removed, so the entries the
+ * migration hasn't reached yet stay where it expects them.
+ */
+static void removeSlot(Table *table, Slot *slot, const bool isDraining) {
+    table->count--;
+    if (isDraining) {
+        slot->value = NULL;
+        return;
+    }
+    const unsigned int mask = table->capacity - 1;
+    unsigned int index = slot - table->slots;
+    unsigned int next = (index + 1) & mask;
+    while (table->slots[next].distance > 1) {
+        table->slots[index] = table->slots[next];
+        table->slots[index].distance--;
+        index = next;
+        next = (index + 1) & mask;
+    }
+    table->slots[index] = (Slot){0};
+}
+
+/**
+ * Starts rehashing into a table twice the size, finishing the previous rehash first if it's somehow still going.
+ */
+static int grow(IntMapImpl *impl) {
+    if (impl->draining.slots != NULL) {
+        drain(impl, impl->draining.capacity);
+    }
+    Table larger;
+    if (impl->current.capacity > UINT32_MAX / 2 || initTable(&larger, impl->current.capacity * 2) == ERROR) {
+        return ERROR;
+    }
+    impl->draining = impl->current;
+    impl->current = larger;
+    impl->drainIndex = 0;
+    return SUCCESS;
+}
+
+/**
+ * Migrates up to slotCount slots of the table being drained into the current table, freeing it once it's empty.
+ */
+static void drain(IntMapImpl *impl, const unsigned int slotCount) {
+    Table *draining = &impl->draining;
+    if (draining->slots == NULL) {
+        return;
+    }
+    const unsigned int end = draining->capacity - impl->drainIndex < slotCount
+                                 ? draining->capacity
+                                 : impl->drainIndex + slotCount;
+    for (; impl->drainIndex < end; impl->drainIndex++) {
+        Slot *slot = &draining->slots[impl->drainIndex];
+        if (slot->distance != 0 && slot->value != NULL) {
+            insertSlot(&impl->current, slot->key, slot->value);
+            removeSlot(draining, slot, true);
+        }
+    }
+    if (impl->drainIndex == draining->capacity) {
+        free(draining->slots);
+        draining->slots = NULL;
+    }
+}
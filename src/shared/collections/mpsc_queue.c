@@ -0,0 +1,81 @@
+/**
+ * Intrusive MPSC queue after Dmitry Vyukov's design: producers swap themselves in as the new head with a single
+ * atomic exchange, then link the previous head to themselves. The consumer walks from the tail and never contends with
+ * producers except on the final element, which is handled by re-queueing a stub node.
+ */
+
+#include <stdlib.h>
+
+#include "collections/mpsc_queue.h"
+#include "shared.h"
+
+typedef struct {
+  MpscQueue base;
+  MpscNode *head; // most recently pushed, shared by producers
+  MpscNode *tail; // next to pop, consumer only
+  MpscNode stub;
+} MpscQueueImpl;
+
+static void mpsc_push(MpscQueue *queue, MpscNode *node) {
+  MpscQueueImpl *impl = (MpscQueueImpl *) queue;
+  __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+  MpscNode *previous = __atomic_exchange_n(&impl->head, node, __ATOMIC_ACQ_REL);
+  __atomic_store_n(&previous->next, node, __ATOMIC_RELEASE);
+}
+
+static int mpsc_pop(MpscQueue *queue, MpscNode **node) {
+  MpscQueueImpl *impl = (MpscQueueImpl *) queue;
+  MpscNode *tail = impl->tail;
+  MpscNode *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+  if (tail == &impl->stub) {
+    if (next == NULL) {
+      return NOT_FOUND;
+    }
+    impl->tail = next;
+    tail = next;
+    next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+  }
+  if (next != NULL) {
+    impl->tail = next;
+    *node = tail;
+    return SUCCESS;
+  }
+
+  if (tail != __atomic_load_n(&impl->head, __ATOMIC_ACQUIRE)) {
+    // a producer has swapped in a new head but not linked it yet
+    return NOT_FOUND;
+  }
+  // tail is the last element - park the stub behind it so tail can be detached
+  mpsc_push(queue, &impl->stub);
+  next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+  if (next != NULL) {
+    impl->tail = next;
+    *node = tail;
+    return SUCCESS;
+  }
+  return NOT_FOUND;
+}
+
+static void mpsc_destroy(MpscQueue **queue) {
+  if (!queue || !*queue) return;
+  free(*queue);
+  *queue = NULL;
+}
+
+int createMpscQueue(MpscQueue **queue) {
+  if (!queue) return ERROR;
+
+  MpscQueueImpl *impl = malloc(sizeof(MpscQueueImpl));
+  if (!impl) return ERROR;
+
+  impl->stub.next = NULL;
+  impl->head = &impl->stub;
+  impl->tail = &impl->stub;
+  impl->base.push = mpsc_push;
+  impl->base.pop = mpsc_pop;
+  impl->base.destroy = mpsc_destroy;
+
+  *queue = (MpscQueue *) impl;
+  return SUCCESS;
+}
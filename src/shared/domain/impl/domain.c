@@ -36,9 +36,10 @@ static int changeTimeout(DomainService *service, const int timeoutMs) {
  *
  * @param options configuration options
  * @param service to-initialize
+ * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
  */
-static void initializeGenericService(DomainServiceOpts options,
-                                     DomainService *service) {
+static int initializeGenericService(DomainServiceOpts options,
+                                    DomainService *service) {
   service->sock = INACTIVE_SOCK;
   service->connectionType = options.connectionType;
   const int receiveTimeoutMs =
@@ -50,8 +51,18 @@ static void initializeGenericService(DomainServiceOpts options,
   service->localAddr = getNetworkAddress(localAddress, localPort);
   service->incomingDeserializer = options.incomingDeserializer;
   service->outgoingSerializer = options.outgoingSerializer;
+  service->reusePort = options.reusePort;
   service->changeTimeout = changeTimeout;
   service->destroy = destroyDatagramService;
+
+  // every message is serialized into and deserialized from these, so steady-state traffic never allocates
+  service->serializeBuffer = malloc(service->outgoingSerializer.messageSize);
+  service->deserializeBuffer = malloc(service->incomingDeserializer.messageSize);
+  if (!service->serializeBuffer || !service->deserializeBuffer) {
+    releaseServiceBuffers(service);
+    return DOMAIN_FAILURE;
+  }
+  return DOMAIN_SUCCESS;
 }
 
 /**
@@ -62,26 +73,60 @@ static void initializeGenericService(DomainServiceOpts options,
  * @return DOMAIN_SUCCESS, DOMAIN_FAILURE
  */
 int createServer(const DomainServiceOpts options, DomainServer **server) {
-  *server = calloc(1, sizeof(DomainServer));
+  const size_t serverSize = options.connectionType == DATAGRAM ? sizeof(DatagramServer) : sizeof(StreamServer);
+  *server = calloc(1, serverSize);
   if (*server == NULL) {
     return DOMAIN_FAILURE;
   }
+  DomainService *serviceRef = (DomainService *) *server;
+  if (initializeGenericService(options, serviceRef) == DOMAIN_FAILURE) {
+    free(*server);
+    *server = NULL;
+    return DOMAIN_FAILURE;
+  }
+  if (createTimerWheel(monotonicMs(), &(*server)->timers) == ERROR) {
+    releaseServiceBuffers(serviceRef);
+    free(*server);
+    *server = NULL;
+    return DOMAIN_FAILURE;
+  }
+
   if (options.connectionType == DATAGRAM) {
     (*server)->base.start = startDatagramServer;
-    (*server)->base.stop = stopDatagramService;
+    (*server)->base.stop = stopDatagramServer;
+    (*server)->base.destroy = destroyDatagramServer;
     (*server)->receive = datagramServerReceive;
     (*server)->send = datagramServerSend;
+    (*server)->receiveBatch = datagramServerReceiveBatch;
+    (*server)->sendBatch = datagramServerSendBatch;
+    (*server)->broadcast = datagramServerBroadcast;
+    (*server)->watch = datagramServerWatch;
+    (*server)->unwatch = datagramServerUnwatch;
+    ((DatagramServer *) *server)->responseCacheTtlMs = options.responseCacheTtlMs > 0 ? options.responseCacheTtlMs : 0;
   } else {
     (*server)->base.start = startStreamServer;
-    (*server)->base.stop = stopStreamService;
+    (*server)->base.stop = stopStreamServer;
+    (*server)->base.destroy = destroyStreamServer;
     (*server)->receive = streamServerReceive;
     (*server)->send = streamServerSend;
+    (*server)->receiveBatch = streamServerReceiveBatch;
+    (*server)->sendBatch = streamServerSendBatch;
+    (*server)->broadcast = streamServerBroadcast;
+    (*server)->watch = streamServerWatch;
+    (*server)->unwatch = streamServerUnwatch;
+    StreamServer *impl = (StreamServer *) *server;
+    impl->epollFd = INACTIVE_SOCK;
+    impl->outputHighWatermark = options.outputHighWatermark > 1
+                                  ? options.outputHighWatermark
+                                  : DEFAULT_OUTPUT_HIGH_WATERMARK;
+    impl->outputLowWatermark = options.outputLowWatermark > 0 && options.outputLowWatermark < impl->outputHighWatermark
+                                 ? options.outputLowWatermark
+                                 : impl->outputHighWatermark / 4;
+    impl->slowConsumerPolicy = options.slowConsumerPolicy;
+    impl->idleTimeoutMs = options.idleTimeoutMs > 0 ? options.idleTimeoutMs : 0;
   }
   (*server)->clients = NULL;
 
-  DomainService *serviceRef = (DomainService *) *server;
-  initializeGenericService(options, serviceRef);
-
   return DOMAIN_SUCCESS;
 }
 
@@ -93,25 +138,56 @@ int createServer(const DomainServiceOpts options, DomainServer **server) {
  * @return DOMAIN_SUCCESS, DOMAIN_FAILURE
  */
 int createClient(DomainClientOpts options, DomainClient **client) {
-  *client = calloc(1, sizeof(DomainClient));
+  const size_t clientSize = options.baseOpts.connectionType == DATAGRAM ? sizeof(DatagramClient) : sizeof(StreamClient);
+  *client = calloc(1, clientSize);
   if (*client == NULL) {
     return DOMAIN_FAILURE;
   }
 
   DomainService *serviceRef = (DomainService *) *client;
-  initializeGenericService(options.baseOpts, serviceRef);
+  if (initializeGenericService(options.baseOpts, serviceRef) == DOMAIN_FAILURE) {
+    free(*client);
+    *client = NULL;
+    return DOMAIN_FAILURE;
+  }
 
   if (options.baseOpts.connectionType == DATAGRAM) {
     (*client)->receive = datagramClientReceive;
+    (*client)->receiveAvailable = datagramClientReceiveAvailable;
     (*client)->send = datagramClientSend;
+    (*client)->request = datagramClientRequest;
+    (*client)->submit = datagramClientSubmit;
     (*client)->base.start = startDatagramClient;
-    (*client)->base.stop = stopDatagramService;
+    (*client)->base.stop = stopDatagramClient;
+    (*client)->base.destroy = destroyDatagramClient;
+    DatagramClient *impl = (DatagramClient *) *client;
+    // a restarted process reusing the same port shouldn't have its requests mistaken for retransmits
+    impl->nextRequestID = (unsigned int) (monotonicMs() ^ (uint64_t) getpid() << 16);
+    if (createMap(&impl->outstanding) == ERROR) {
+      releaseServiceBuffers(serviceRef);
+      free(*client);
+      *client = NULL;
+      return DOMAIN_FAILURE;
+    }
   } else {
     (*client)->receive = streamClientReceive;
+    (*client)->receiveAvailable = streamClientReceiveAvailable;
     (*client)->send = streamClientSend;
+    (*client)->request = streamClientRequest;
+    (*client)->submit = streamClientSubmit;
     (*client)->isConnected = false;
     (*client)->base.start = startStreamClient;
     (*client)->base.stop = stopStreamClient;
+    (*client)->base.destroy = destroyStreamClient;
+    StreamClient *impl = (StreamClient *) *client;
+    impl->inputCapacity = STREAM_CLIENT_INPUT_FRAMES * serviceRef->incomingDeserializer.messageSize;
+    impl->input = malloc(impl->inputCapacity);
+    if (impl->input == NULL) {
+      releaseServiceBuffers(serviceRef);
+      free(*client);
+      *client = NULL;
+      return DOMAIN_FAILURE;
+    }
   }
   (*client)->remoteAddr = getNetworkAddress(options.remoteHost, options.remotePort);
   return DOMAIN_SUCCESS;
@@ -2,8 +2,91 @@
  * Implementation of UDP Client and Server
  */
 
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+
 #include "domain_shared.h"
 
+#include "collections/int_map.h"
+
+#define DATAGRAM_BATCH 64
+#define DATAGRAM_MAX_WATCHES 8
+#define RESPONSE_CACHE_BUCKETS 1024
+#define RETRANSMIT_INITIAL_MS 50
+#define RETRANSMIT_MAX_MS 1000
+
+/**
+ * A descriptor added to a Datagram server's receive loop with DomainServer#watch.
+ */
+typedef struct {
+  int fd;
+  DomainWatchHandler onReadable;
+  void *context;
+} DatagramWatch;
+
+struct DatagramClient;
+
+/**
+ * A request made with DomainClient#submit that hasn't been answered yet. Retransmitted with exponential backoff until
+ * its response arrives or its deadline passes.
+ */
+typedef struct OutstandingRequest {
+  struct DatagramClient *client;
+  TimerWheel *timers; // wheel the request was submitted with
+  unsigned int requestID;
+  uint64_t deadlineMs;
+  int backoffMs; // interval before the next retransmit
+  Timer retransmit;
+  struct OutstandingRequest *previous; // links through every outstanding request of the client
+  struct OutstandingRequest *next;
+  char frame[]; // serialized request, sent again as is
+} OutstandingRequest;
+
+/**
+ * Datagram client state. The socket is connected to the client's server, and every request is tagged with a requestID
+ * so its response can be told apart from the response to an earlier request, or to a retransmit.
+ */
+typedef struct DatagramClient {
+  DomainClient base; // must be first
+  unsigned int nextRequestID;
+  IntMap *outstanding; // requestID -> OutstandingRequest
+  OutstandingRequest *outstandingHead;
+} DatagramClient;
+
+/**
+ * A response the server has sent, or is yet to send, to a request carrying a requestID. A retransmit of the request
+ * is answered from here instead of being handled again, until the entry expires.
+ */
+typedef struct CachedResponse {
+  struct sockaddr_in clientAddr;
+  unsigned int requestID;
+  bool isAnswered; // false while the request is still being handled
+  Timer expiry;
+  struct CachedResponse *next; // links within the entry's bucket
+  char frame[]; // serialized response, once answered
+} CachedResponse;
+
+/**
+ * Datagram server state, with buffers preallocated for batched receives and sends.
+ */
+typedef struct {
+  DomainServer base; // must be first
+  char *incoming; // DATAGRAM_BATCH incoming frames
+  char *outgoing; // DATAGRAM_BATCH outgoing frames
+  struct mmsghdr headers[DATAGRAM_BATCH];
+  struct iovec segments[DATAGRAM_BATCH];
+  struct sockaddr_in addresses[DATAGRAM_BATCH];
+  DatagramWatch watches[DATAGRAM_MAX_WATCHES];
+  int watchCount;
+  struct pollfd polled[DATAGRAM_MAX_WATCHES + 1]; // the server's socket, then each watch
+  int responseCacheTtlMs; // 0 if the response cache is disabled
+  CachedResponse **responseCache; // RESPONSE_CACHE_BUCKETS buckets
+} DatagramServer;
+
+static void evictCachedResponse(DatagramServer *impl, CachedResponse *cached);
+
 /**
  * @see DomainService#stop
  */
@@ -23,7 +106,46 @@ static int destroyDatagramService(DomainService **service) {
     if (stopDatagramService(*service) == DOMAIN_FAILURE) {
       return DOMAIN_FAILURE;
     }
+    releaseServiceBuffers(*service);
+    free(*service);
+  }
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ * @see DomainService#stop
+ */
+static int stopDatagramServer(DomainService *service) {
+  DatagramServer *impl = (DatagramServer *) service;
+  free(impl->incoming);
+  free(impl->outgoing);
+  impl->incoming = NULL;
+  impl->outgoing = NULL;
+  if (impl->responseCache != NULL) {
+    for (int i = 0; i < RESPONSE_CACHE_BUCKETS; i++) {
+      while (impl->responseCache[i] != NULL) {
+        evictCachedResponse(impl, impl->responseCache[i]);
+      }
+    }
+    free(impl->responseCache);
+    impl->responseCache = NULL;
+  }
+  return stopDatagramService(service);
+}
+
+/**
+ * @see DomainService#destroy
+ */
+static int destroyDatagramServer(DomainService **service) {
+  if (*service != NULL) {
+    if (stopDatagramServer(*service) == DOMAIN_FAILURE) {
+      return DOMAIN_FAILURE;
+    }
+    DomainServer *server = (DomainServer *) *service;
+    server->timers->destroy(&server->timers);
+    releaseServiceBuffers(*service);
     free(*service);
+    *service = NULL;
   }
   return DOMAIN_SUCCESS;
 }
@@ -33,14 +155,13 @@ static int destroyDatagramService(DomainService **service) {
  *
  * @param service self-reference
  * @param message to send
- * @param hostAddr destination host
+ * @param hostAddr destination host, or NULL for the server a client's socket is connected to
  * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
  */
 static int toDatagramDomainHost(DomainService *service,
                                 void *message,
                                 struct sockaddr_in *hostAddr) {
-  char *buf = malloc(service->outgoingSerializer.messageSize);
-
+  char *buf = service->serializeBuffer;
   int status = DOMAIN_SUCCESS;
 
   if (service->outgoingSerializer.serializer(message, buf) ==
@@ -55,7 +176,6 @@ static int toDatagramDomainHost(DomainService *service,
     status = DOMAIN_FAILURE;
   }
 
-  free(buf);
   return status;
 }
 
@@ -70,12 +190,7 @@ static int toDatagramDomainHost(DomainService *service,
 static int fromDatagramDomainHost(DomainService *service,
                            void *message,
                            struct sockaddr_in *hostAddr) {
-  char *buf = malloc(service->incomingDeserializer.messageSize);
-  if (!buf) {
-    printf("Failed to allocate message buffer\n");
-    return DOMAIN_FAILURE;
-  }
-
+  char *buf = service->deserializeBuffer;
   int status = DOMAIN_SUCCESS;
 
   if (receiveUdpMessage(service->sock,
@@ -89,42 +204,475 @@ static int fromDatagramDomainHost(DomainService *service,
     printf("Unable to deserialize domain message\n");
     status = DOMAIN_FAILURE;
   }
-  free(buf);
   return status;
 }
 
+/**
+ * Assigns the next requestID of a client, skipping 0 - the requestID of a message that isn't part of a request.
+ *
+ * @param impl self-reference
+ * @return the requestID
+ */
+static unsigned int takeRequestID(DatagramClient *impl) {
+  if (++impl->nextRequestID == 0) {
+    impl->nextRequestID++;
+  }
+  return impl->nextRequestID;
+}
+
+/**
+ * @param backoffMs current retransmit interval
+ * @return the interval to wait before the next retransmit
+ */
+static int nextBackoffMs(const int backoffMs) {
+  return backoffMs * 2 < RETRANSMIT_MAX_MS ? backoffMs * 2 : RETRANSMIT_MAX_MS;
+}
+
+/**
+ * Stops tracking a request made with DomainClient#submit, cancelling its retransmits, and frees it.
+ *
+ * @param impl self-reference
+ * @param outstanding request to forget
+ */
+static void forgetOutstanding(DatagramClient *impl, OutstandingRequest *outstanding) {
+  outstanding->timers->cancel(outstanding->timers, &outstanding->retransmit);
+  impl->outstanding->remove(impl->outstanding, outstanding->requestID, (void **) &outstanding);
+  if (outstanding->previous != NULL) {
+    outstanding->previous->next = outstanding->next;
+  } else {
+    impl->outstandingHead = outstanding->next;
+  }
+  if (outstanding->next != NULL) {
+    outstanding->next->previous = outstanding->previous;
+  }
+  free(outstanding);
+}
+
+/**
+ * Retransmits a request made with DomainClient#submit that hasn't been answered yet, or gives up on it once its
+ * deadline has passed. Whoever submitted it times the request out on its own.
+ *
+ * @param timers wheel the request was submitted with
+ * @param timer the request's retransmit timer
+ * @param context the OutstandingRequest
+ */
+static void onRetransmit(TimerWheel *timers, Timer *timer, void *context) {
+  OutstandingRequest *outstanding = context;
+  DatagramClient *impl = outstanding->client;
+  const uint64_t nowMs = monotonicMs();
+  if (nowMs >= outstanding->deadlineMs) {
+    forgetOutstanding(impl, outstanding);
+    return;
+  }
+  printf("[DEBUG] Datagram Client: retransmitting requestID=%u\n", outstanding->requestID);
+  if (sendUdpMessage(impl->base.base.sock, outstanding->frame, impl->base.base.outgoingSerializer.messageSize, NULL)
+      == ERROR) {
+    perror("Unable to send message to domain\n");
+  }
+  outstanding->backoffMs = nextBackoffMs(outstanding->backoffMs);
+  const uint64_t retransmitMs = nowMs + outstanding->backoffMs;
+  timers->schedule(timers, timer, retransmitMs < outstanding->deadlineMs ? retransmitMs : outstanding->deadlineMs,
+                   onRetransmit, outstanding);
+}
+
 /**
  *  @see DomainClient#send
  */
 static int datagramClientSend(DomainClient *self, UserMessage *toSend) {
-  return toDatagramDomainHost((DomainService *) self, toSend, &self->remoteAddr);
+  return toDatagramDomainHost((DomainService *) self, toSend, NULL);
 }
 
 /**
  * @see DomainClient#receive
  */
 static int datagramClientReceive(DomainClient *self, UserMessage *toReceive) {
+  // the socket is connected, so the kernel has already discarded datagrams from anyone but the server
   struct sockaddr_in receiveAddr;
-  int resp = fromDatagramDomainHost((DomainService *) self, toReceive, &receiveAddr);
-  if (resp == DOMAIN_SUCCESS) {
-    const int maxAttempts = 10;
-    int attempt = 0;
-
-    while (resp == DOMAIN_SUCCESS
-           && receiveAddr.sin_addr.s_addr != self->remoteAddr.sin_addr.s_addr
-           && receiveAddr.sin_port != self->remoteAddr.sin_port) {
-      if (attempt > maxAttempts) {
-        printf("Received more than %d messages from the wrong sending addr and port. Aborting...\n",
-               maxAttempts);
-        resp = DOMAIN_FAILURE;
-        break;
+  return fromDatagramDomainHost((DomainService *) self, toReceive, &receiveAddr);
+}
+
+/**
+ * @see DomainClient#request
+ */
+static int datagramClientRequest(DomainClient *self, UserMessage *request, UserMessage *responseOut) {
+  DatagramClient *impl = (DatagramClient *) self;
+  DomainService *service = (DomainService *) self;
+  request->requestID = takeRequestID(impl);
+  if (service->outgoingSerializer.serializer(request, service->serializeBuffer) == MESSAGE_SERIALIZER_FAILURE) {
+    printf("Unable to serialize domain message\n");
+    return DOMAIN_FAILURE;
+  }
+
+  const int timeoutMs = toWaitTimeoutMs(&service->receiveTimeout);
+  const uint64_t deadlineMs = monotonicMs() + (timeoutMs < 0 ? DEFAULT_TIMEOUT_MS : timeoutMs);
+  uint64_t retransmitMs = 0;
+  int backoffMs = RETRANSMIT_INITIAL_MS;
+  while (true) {
+    const uint64_t nowMs = monotonicMs();
+    if (nowMs >= deadlineMs) {
+      printf("[ERROR] Datagram Client: timed out waiting for a response to requestID=%u\n", request->requestID);
+      return DOMAIN_FAILURE;
+    }
+    if (nowMs >= retransmitMs) {
+      if (retransmitMs > 0) {
+        printf("[DEBUG] Datagram Client: retransmitting requestID=%u\n", request->requestID);
+      }
+      if (sendUdpMessage(service->sock, service->serializeBuffer, service->outgoingSerializer.messageSize, NULL)
+          == ERROR) {
+        perror("Unable to send message to domain\n");
+        return DOMAIN_FAILURE;
+      }
+      retransmitMs = nowMs + backoffMs;
+      backoffMs = nextBackoffMs(backoffMs);
+    }
+
+    const uint64_t wakeMs = retransmitMs < deadlineMs ? retransmitMs : deadlineMs;
+    struct pollfd polled = {.fd = service->sock, .events = POLLIN};
+    const int rv = poll(&polled, 1, (int) (wakeMs - nowMs));
+    if (rv < 0 && errno != EINTR) {
+      perror("[ERROR] Datagram Client: poll() failed");
+      return DOMAIN_FAILURE;
+    }
+    if (rv <= 0) {
+      continue;
+    }
+
+    struct sockaddr_in receiveAddr;
+    int status;
+    errno = 0;
+    while ((status = receiveUdpAvailable(service->sock, service->deserializeBuffer,
+                                         service->incomingDeserializer.messageSize, &receiveAddr)) != WOULD_BLOCK) {
+      if (status != SUCCESS) {
+        if (errno == ECONNREFUSED) {
+          // nothing is listening on the server's port, so no retransmit will be answered either
+          return DOMAIN_FAILURE;
+        }
+        errno = 0;
+        continue;
+      }
+      if (service->incomingDeserializer.deserializer(service->deserializeBuffer, responseOut)
+          == MESSAGE_DESERIALIZER_FAILURE) {
+        printf("Unable to deserialize domain message\n");
+        continue;
       }
-      printf("Warning... received message from unknown host. Discarding...\n");
-      attempt += 1;
-      resp = fromDatagramDomainHost((DomainService *) self, toReceive, &receiveAddr);
-           }
+      if (responseOut->requestID == request->requestID) {
+        return DOMAIN_SUCCESS;
+      }
+      printf("[WARNING] Datagram Client: discarding response to requestID=%u, waiting on requestID=%u\n",
+             responseOut->requestID, request->requestID);
+    }
+  }
+}
+
+/**
+ * @see DomainClient#submit
+ */
+static int datagramClientSubmit(DomainClient *self, UserMessage *request, TimerWheel *timers, const int timeoutMs) {
+  DatagramClient *impl = (DatagramClient *) self;
+  DomainService *service = (DomainService *) self;
+  const size_t frameSize = service->outgoingSerializer.messageSize;
+  OutstandingRequest *outstanding = calloc(1, sizeof(OutstandingRequest) + frameSize);
+  if (outstanding == NULL) {
+    return DOMAIN_FAILURE;
+  }
+  request->requestID = takeRequestID(impl);
+  if (service->outgoingSerializer.serializer(request, outstanding->frame) == MESSAGE_SERIALIZER_FAILURE) {
+    printf("Unable to serialize domain message\n");
+    free(outstanding);
+    return DOMAIN_FAILURE;
+  }
+  if (sendUdpMessage(service->sock, outstanding->frame, frameSize, NULL) == ERROR) {
+    perror("Unable to send message to domain\n");
+    free(outstanding);
+    return DOMAIN_FAILURE;
+  }
+  if (impl->outstanding->add(impl->outstanding, request->requestID, outstanding) == ERROR) {
+    free(outstanding);
+    return DOMAIN_FAILURE;
+  }
+
+  outstanding->client = impl;
+  outstanding->timers = timers;
+  outstanding->requestID = request->requestID;
+  outstanding->backoffMs = RETRANSMIT_INITIAL_MS;
+  const uint64_t nowMs = monotonicMs();
+  outstanding->deadlineMs = nowMs + timeoutMs;
+  outstanding->next = impl->outstandingHead;
+  if (impl->outstandingHead != NULL) {
+    impl->outstandingHead->previous = outstanding;
+  }
+  impl->outstandingHead = outstanding;
+  const uint64_t retransmitMs = nowMs + RETRANSMIT_INITIAL_MS;
+  timers->schedule(timers, &outstanding->retransmit,
+                   retransmitMs < outstanding->deadlineMs ? retransmitMs : outstanding->deadlineMs,
+                   onRetransmit, outstanding);
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ * @see DomainClient#receiveAvailable
+ */
+static int datagramClientReceiveAvailable(DomainClient *self, UserMessage *toReceive) {
+  DatagramClient *impl = (DatagramClient *) self;
+  DomainService *service = (DomainService *) self;
+  struct sockaddr_in receiveAddr;
+  while (true) {
+    const int status = receiveUdpAvailable(service->sock, service->deserializeBuffer,
+                                           service->incomingDeserializer.messageSize, &receiveAddr);
+    if (status == WOULD_BLOCK) {
+      return WOULD_BLOCK;
+    }
+    if (status != SUCCESS) {
+      return DOMAIN_FAILURE;
+    }
+    if (service->incomingDeserializer.deserializer(service->deserializeBuffer, toReceive) ==
+        MESSAGE_DESERIALIZER_FAILURE) {
+      printf("Unable to deserialize domain message\n");
+      return DOMAIN_FAILURE;
+    }
+    if (toReceive->requestID == 0) {
+      return DOMAIN_SUCCESS;
+    }
+    OutstandingRequest *outstanding;
+    if (impl->outstanding->get(impl->outstanding, toReceive->requestID, (void **) &outstanding) == SUCCESS) {
+      forgetOutstanding(impl, outstanding);
+      return DOMAIN_SUCCESS;
+    }
+    // the response to a retransmit of a request that's already been answered, or one that arrived too late
+    printf("[WARNING] Datagram Client: discarding response to requestID=%u, which isn't outstanding\n",
+           toReceive->requestID);
+  }
+}
+
+/**
+ * @see DomainService#stop
+ */
+static int stopDatagramClient(DomainService *service) {
+  DatagramClient *impl = (DatagramClient *) service;
+  while (impl->outstandingHead != NULL) {
+    forgetOutstanding(impl, impl->outstandingHead);
+  }
+  return stopDatagramService(service);
+}
+
+/**
+ * @see DomainService#destroy
+ */
+static int destroyDatagramClient(DomainService **service) {
+  if (*service != NULL) {
+    if (stopDatagramClient(*service) == DOMAIN_FAILURE) {
+      return DOMAIN_FAILURE;
+    }
+    DatagramClient *impl = (DatagramClient *) *service;
+    impl->outstanding->destroy(&impl->outstanding);
+    releaseServiceBuffers(*service);
+    free(*service);
+    *service = NULL;
+  }
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ * @param clientAddr client that sent a request
+ * @param requestID the request's requestID
+ * @return the response cache bucket the request falls under
+ */
+static size_t toCacheBucket(const struct sockaddr_in *clientAddr, const unsigned int requestID) {
+  const uint32_t hash = (clientAddr->sin_addr.s_addr ^ (uint32_t) clientAddr->sin_port << 16 ^ requestID) * 2654435761u;
+  return hash >> 22; // top 10 bits, one per RESPONSE_CACHE_BUCKETS
+}
+
+/**
+ * @param impl self-reference
+ * @param clientAddr client that sent a request
+ * @param requestID the request's requestID
+ * @return the request's cache entry, or NULL if it has none
+ */
+static CachedResponse *findCachedResponse(const DatagramServer *impl, const struct sockaddr_in *clientAddr,
+                                          const unsigned int requestID) {
+  CachedResponse *cached = impl->responseCache[toCacheBucket(clientAddr, requestID)];
+  while (cached != NULL
+         && (cached->requestID != requestID
+             || cached->clientAddr.sin_addr.s_addr != clientAddr->sin_addr.s_addr
+             || cached->clientAddr.sin_port != clientAddr->sin_port)) {
+    cached = cached->next;
+  }
+  return cached;
+}
+
+/**
+ * Unlinks a cache entry from its bucket and frees it.
+ *
+ * @param impl self-reference
+ * @param cached entry to evict
+ */
+static void evictCachedResponse(DatagramServer *impl, CachedResponse *cached) {
+  CachedResponse **link = &impl->responseCache[toCacheBucket(&cached->clientAddr, cached->requestID)];
+  while (*link != cached) {
+    link = &(*link)->next;
+  }
+  *link = cached->next;
+  impl->base.timers->cancel(impl->base.timers, &cached->expiry);
+  free(cached);
+}
+
+/**
+ * Evicts a cache entry once its time to live has passed.
+ *
+ * @param timers the server's timers
+ * @param timer the entry's expiry
+ * @param context the server
+ */
+static void onCachedResponseExpired(TimerWheel *timers, Timer *timer, void *context) {
+  evictCachedResponse(context, (CachedResponse *) ((char *) timer - offsetof(CachedResponse, expiry)));
+}
+
+/**
+ * Adds an entry to the response cache, expiring after the cache's time to live.
+ *
+ * @param impl self-reference
+ * @param clientAddr client that sent the request
+ * @param requestID the request's requestID
+ * @return the new entry, not yet answered, or NULL on allocation failure
+ */
+static CachedResponse *addCachedResponse(DatagramServer *impl, const struct sockaddr_in *clientAddr,
+                                         const unsigned int requestID) {
+  CachedResponse *cached = calloc(1, sizeof(CachedResponse) + impl->base.base.outgoingSerializer.messageSize);
+  if (cached == NULL) {
+    return NULL;
+  }
+  cached->clientAddr = *clientAddr;
+  cached->requestID = requestID;
+  CachedResponse **bucket = &impl->responseCache[toCacheBucket(clientAddr, requestID)];
+  cached->next = *bucket;
+  *bucket = cached;
+  impl->base.timers->schedule(impl->base.timers, &cached->expiry, monotonicMs() + impl->responseCacheTtlMs,
+                              onCachedResponseExpired, impl);
+  return cached;
+}
+
+/**
+ * Checks a received request against the response cache. A retransmit of a request that's been answered is sent the
+ * cached response, and one of a request that's still being handled is dropped - either way the caller never sees it.
+ * Any other request is recorded, so its retransmits are recognized.
+ *
+ * @param impl self-reference
+ * @param request received request
+ * @param clientAddr client that sent it
+ * @return true if the request is a retransmit, and has been dealt with
+ */
+static bool isRetransmit(DatagramServer *impl, const UserMessage *request, const struct sockaddr_in *clientAddr) {
+  if (impl->responseCache == NULL || request->requestID == 0) {
+    return false;
+  }
+  const CachedResponse *cached = findCachedResponse(impl, clientAddr, request->requestID);
+  if (cached == NULL) {
+    addCachedResponse(impl, clientAddr, request->requestID);
+    return false;
+  }
+  if (cached->isAnswered
+      && sendUdpMessage(impl->base.base.sock, cached->frame, impl->base.base.outgoingSerializer.messageSize,
+                        clientAddr) == ERROR) {
+    perror("Unable to send message to domain\n");
+  }
+  return true;
+}
+
+/**
+ * Caches a response to a request carrying a requestID, restarting the entry's time to live.
+ *
+ * @param impl self-reference
+ * @param response response being sent
+ * @param frame serialized response
+ * @param clientAddr client it's sent to
+ */
+static void cacheResponse(DatagramServer *impl, const UserMessage *response, const char *frame,
+                          const struct sockaddr_in *clientAddr) {
+  if (impl->responseCache == NULL || response->requestID == 0) {
+    return;
+  }
+  CachedResponse *cached = findCachedResponse(impl, clientAddr, response->requestID);
+  if (cached == NULL) {
+    cached = addCachedResponse(impl, clientAddr, response->requestID);
+    if (cached == NULL) {
+      return;
+    }
+  } else {
+    impl->base.timers->schedule(impl->base.timers, &cached->expiry, monotonicMs() + impl->responseCacheTtlMs,
+                                onCachedResponseExpired, impl);
+  }
+  memcpy(cached->frame, frame, impl->base.base.outgoingSerializer.messageSize);
+  cached->isAnswered = true;
+}
+
+/**
+ * @param impl self-reference
+ * @param fd watched descriptor
+ * @return the descriptor's watch, or NULL if it isn't watched
+ */
+static DatagramWatch *findWatch(DatagramServer *impl, const int fd) {
+  for (int i = 0; i < impl->watchCount; i++) {
+    if (impl->watches[i].fd == fd) {
+      return &impl->watches[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Waits for a datagram to arrive on the server's socket, calling the handlers of watched descriptors that become
+ * readable and expiring timers that fall due in the meantime. Without any watches or timers, the socket's own receive
+ * timeout does the waiting.
+ *
+ * @param impl self-reference
+ * @return DOMAIN_SUCCESS once a datagram is waiting, DOMAIN_FAILURE if the receive timeout expires first
+ */
+static int awaitDatagram(DatagramServer *impl) {
+  DomainServer *self = (DomainServer *) impl;
+  DomainService *service = (DomainService *) impl;
+  const uint64_t receiveDeadlineMs = toReceiveDeadlineMs(service, monotonicMs());
+  while (true) {
+    const uint64_t nowMs = monotonicMs();
+    self->timers->advance(self->timers, nowMs);
+    if (impl->watchCount == 0 && self->timers->length == 0) {
+      return DOMAIN_SUCCESS;
+    }
+    if (receiveDeadlineMs > 0 && nowMs >= receiveDeadlineMs) {
+      return DOMAIN_FAILURE;
+    }
+
+    const int polledCount = impl->watchCount + 1;
+    impl->polled[0] = (struct pollfd) {.fd = service->sock, .events = POLLIN};
+    for (int i = 0; i < impl->watchCount; i++) {
+      impl->polled[i + 1] = (struct pollfd) {.fd = impl->watches[i].fd, .events = POLLIN};
+    }
+
+    const int rv = poll(impl->polled, polledCount, toLoopTimeoutMs(self, receiveDeadlineMs, nowMs));
+    if (rv < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("[ERROR] Datagram Server: poll() failed");
+      return DOMAIN_FAILURE;
+    }
+    if (rv == 0) {
+      continue;
+    }
+
+    for (int i = 1; i < polledCount; i++) {
+      if (impl->polled[i].revents == 0) {
+        continue;
+      }
+      // handlers may watch or unwatch descriptors, so the watch is looked up afresh
+      const DatagramWatch *watch = findWatch(impl, impl->polled[i].fd);
+      if (watch != NULL) {
+        watch->onReadable(self, watch->fd, watch->context);
+      }
+    }
+    if (impl->polled[0].revents != 0) {
+      return DOMAIN_SUCCESS;
+    }
   }
-  return resp;
 }
 
 /**
@@ -132,7 +680,11 @@ static int datagramClientReceive(DomainClient *self, UserMessage *toReceive) {
  */
 static int datagramServerSend(DomainServer *self, UserMessage *toSend,
                               ClientHandle *remoteTarget) {
-  return toDatagramDomainHost((DomainService *) self, toSend, &remoteTarget->clientAddr);
+  const int status = toDatagramDomainHost((DomainService *) self, toSend, &remoteTarget->clientAddr);
+  if (status == DOMAIN_SUCCESS) {
+    cacheResponse((DatagramServer *) self, toSend, self->base.serializeBuffer, &remoteTarget->clientAddr);
+  }
+  return status;
 }
 
 /**
@@ -140,8 +692,15 @@ static int datagramServerSend(DomainServer *self, UserMessage *toSend,
  */
 static int datagramServerReceive(DomainServer *self, UserMessage *toReceive,
                                  ClientHandle *remote) {
+  DatagramServer *impl = (DatagramServer *) self;
   struct sockaddr_in receiveAddr;
-  const int resp = fromDatagramDomainHost((DomainService *) self, toReceive, &receiveAddr);
+  int resp;
+  do {
+    if (awaitDatagram(impl) == DOMAIN_FAILURE) {
+      return DOMAIN_FAILURE;
+    }
+    resp = fromDatagramDomainHost((DomainService *) self, toReceive, &receiveAddr);
+  } while (resp == DOMAIN_SUCCESS && isRetransmit(impl, toReceive, &receiveAddr));
   if (resp == DOMAIN_SUCCESS) {
     remote->userID = toReceive->userID;
     remote->clientAddr = receiveAddr;
@@ -149,14 +708,179 @@ static int datagramServerReceive(DomainServer *self, UserMessage *toReceive,
   return resp;
 }
 
+/**
+ * Points the server's i-th header at its frame and address slots.
+ */
+static void prepareHeader(DatagramServer *impl, const int i, char *frame, const size_t frameSize,
+                          struct sockaddr_in *address) {
+  impl->segments[i].iov_base = frame;
+  impl->segments[i].iov_len = frameSize;
+  memset(&impl->headers[i], 0, sizeof(struct mmsghdr));
+  impl->headers[i].msg_hdr.msg_name = address;
+  impl->headers[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+  impl->headers[i].msg_hdr.msg_iov = &impl->segments[i];
+  impl->headers[i].msg_hdr.msg_iovlen = 1;
+}
+
+/**
+ *  @see DomainServer#receiveBatch
+ */
+static int datagramServerReceiveBatch(DomainServer *self, void *receivedOut, const size_t messageStride,
+                                      ClientHandle *clientCallbacksOut, const int maxMessages,
+                                      int *receivedCountOut) {
+  DatagramServer *impl = (DatagramServer *) self;
+  const size_t frameSize = self->base.incomingDeserializer.messageSize;
+  const int batchSize = maxMessages < DATAGRAM_BATCH ? maxMessages : DATAGRAM_BATCH;
+  *receivedCountOut = 0;
+
+  if (awaitDatagram(impl) == DOMAIN_FAILURE) {
+    return DOMAIN_FAILURE;
+  }
+  for (int i = 0; i < batchSize; i++) {
+    prepareHeader(impl, i, impl->incoming + i * frameSize, frameSize, &impl->addresses[i]);
+  }
+  const int received = receiveUdpBatch(self->base.sock, impl->headers, batchSize);
+  if (received == ERROR) {
+    printf("Unable to receive message from domain\n");
+    return DOMAIN_FAILURE;
+  }
+
+  for (int i = 0; i < received; i++) {
+    void *message = (char *) receivedOut + *receivedCountOut * messageStride;
+    if (impl->headers[i].msg_len != frameSize || impl->headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      printf("[WARNING] Datagram Server: discarding datagram of unexpected size, received %u, expected %zu\n",
+             impl->headers[i].msg_len, frameSize);
+      continue;
+    }
+    if (self->base.incomingDeserializer.deserializer(impl->incoming + i * frameSize, message)
+        == MESSAGE_DESERIALIZER_FAILURE) {
+      printf("Unable to deserialize domain message\n");
+      continue;
+    }
+    if (isRetransmit(impl, message, &impl->addresses[i])) {
+      continue;
+    }
+    ClientHandle *remote = &clientCallbacksOut[*receivedCountOut];
+    remote->userID = ((UserMessage *) message)->userID;
+    remote->clientAddr = impl->addresses[i];
+    (*receivedCountOut)++;
+  }
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ *  @see DomainServer#sendBatch
+ */
+static int datagramServerSendBatch(DomainServer *self, void *messages, const size_t messageStride,
+                                   ClientHandle *clientHandles, const int messageCount, int *sentCountOut) {
+  DatagramServer *impl = (DatagramServer *) self;
+  const size_t frameSize = self->base.outgoingSerializer.messageSize;
+  *sentCountOut = 0;
+
+  for (int offset = 0; offset < messageCount; offset += DATAGRAM_BATCH) {
+    const int remaining = messageCount - offset;
+    const int batchSize = remaining < DATAGRAM_BATCH ? remaining : DATAGRAM_BATCH;
+    int prepared = 0;
+    for (int i = 0; i < batchSize; i++) {
+      char *frame = impl->outgoing + prepared * frameSize;
+      if (self->base.outgoingSerializer.serializer((char *) messages + (offset + i) * messageStride, frame)
+          == MESSAGE_SERIALIZER_FAILURE) {
+        printf("Unable to serialize domain message\n");
+        continue;
+      }
+      cacheResponse(impl, (UserMessage *) ((char *) messages + (offset + i) * messageStride), frame,
+                    &clientHandles[offset + i].clientAddr);
+      prepareHeader(impl, prepared, frame, frameSize, &clientHandles[offset + i].clientAddr);
+      prepared++;
+    }
+    *sentCountOut += sendUdpBatch(self->base.sock, impl->headers, prepared);
+  }
+  return *sentCountOut == messageCount ? DOMAIN_SUCCESS : DOMAIN_FAILURE;
+}
+
+/**
+ *  @see DomainServer#broadcast
+ */
+static int datagramServerBroadcast(DomainServer *self, UserMessage *message, ClientHandle *clientHandles,
+                                   const int recipientCount, int *sentCountOut) {
+  DatagramServer *impl = (DatagramServer *) self;
+  const MessageSerializer *serializer = &self->base.outgoingSerializer;
+  *sentCountOut = 0;
+  if (serializer->serializer(message, self->base.serializeBuffer) == MESSAGE_SERIALIZER_FAILURE) {
+    printf("Unable to serialize domain message\n");
+    return DOMAIN_FAILURE;
+  }
+
+  for (int offset = 0; offset < recipientCount; offset += DATAGRAM_BATCH) {
+    const int remaining = recipientCount - offset;
+    const int batchSize = remaining < DATAGRAM_BATCH ? remaining : DATAGRAM_BATCH;
+    for (int i = 0; i < batchSize; i++) {
+      ClientHandle *recipient = &clientHandles[offset + i];
+      char *frame = self->base.serializeBuffer;
+      if (serializer->userIDPatcher != NULL) {
+        frame = impl->outgoing + i * serializer->messageSize;
+        memcpy(frame, self->base.serializeBuffer, serializer->messageSize);
+        serializer->userIDPatcher(frame, recipient->userID);
+      }
+      prepareHeader(impl, i, frame, serializer->messageSize, &recipient->clientAddr);
+    }
+    *sentCountOut += sendUdpBatch(self->base.sock, impl->headers, batchSize);
+  }
+  return *sentCountOut == recipientCount ? DOMAIN_SUCCESS : DOMAIN_FAILURE;
+}
+
+/**
+ *  @see DomainServer#watch
+ */
+static int datagramServerWatch(DomainServer *self, const int fd, const DomainWatchHandler onReadable,
+                               void *context) {
+  DatagramServer *impl = (DatagramServer *) self;
+  if (findWatch(impl, fd) != NULL || impl->watchCount == DATAGRAM_MAX_WATCHES) {
+    printf("[ERROR] Datagram Server: unable to watch fd=%d\n", fd);
+    return DOMAIN_FAILURE;
+  }
+  impl->watches[impl->watchCount++] = (DatagramWatch) {
+    .fd = fd,
+    .onReadable = onReadable,
+    .context = context
+  };
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ *  @see DomainServer#unwatch
+ */
+static int datagramServerUnwatch(DomainServer *self, const int fd) {
+  DatagramServer *impl = (DatagramServer *) self;
+  DatagramWatch *watch = findWatch(impl, fd);
+  if (watch == NULL) {
+    return DOMAIN_FAILURE;
+  }
+  *watch = impl->watches[--impl->watchCount];
+  return DOMAIN_SUCCESS;
+}
+
 /**
  *  @see DomainServer#start
  */
 static int startDatagramServer(DomainService *service) {
+  DatagramServer *impl = (DatagramServer *) service;
+  impl->incoming = malloc(DATAGRAM_BATCH * service->incomingDeserializer.messageSize);
+  impl->outgoing = malloc(DATAGRAM_BATCH * service->outgoingSerializer.messageSize);
+  if (impl->responseCacheTtlMs > 0) {
+    impl->responseCache = calloc(RESPONSE_CACHE_BUCKETS, sizeof(CachedResponse *));
+  }
+  if (!impl->incoming || !impl->outgoing || (impl->responseCacheTtlMs > 0 && !impl->responseCache)) {
+    printf("Failed to allocate message buffers\n");
+    stopDatagramServer(service);
+    return DOMAIN_FAILURE;
+  }
   const int sock = getSocket(&service->localAddr,
                              &service->receiveTimeout,
-                             service->connectionType);
+                             service->connectionType,
+                             service->reusePort);
   if (sock < 0) {
+    stopDatagramServer(service);
     return DOMAIN_FAILURE;
   }
   service->sock = sock;
@@ -169,10 +893,15 @@ static int startDatagramServer(DomainService *service) {
 static int startDatagramClient(DomainService *service) {
   const int sock = getSocket(NULL,
                              &service->receiveTimeout,
-                             service->connectionType);
+                             service->connectionType,
+                             false);
   if (sock < 0) {
     return DOMAIN_FAILURE;
   }
+  if (udpConnect(sock, &((DomainClient *) service)->remoteAddr) == ERROR) {
+    close(sock);
+    return DOMAIN_FAILURE;
+  }
   service->sock = sock;
   return DOMAIN_SUCCESS;
 }
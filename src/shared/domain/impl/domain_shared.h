@@ -8,11 +8,68 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "domain/domain.h"
+#include "domain/timer_wheel.h"
 #include "shared.h"
 
 #define INACTIVE_SOCK (-1)
 #define NO_USER (-1)
 
+/**
+ * Frees the serialize and deserialize buffers owned by a service.
+ *
+ * @param service self-reference
+ */
+static void releaseServiceBuffers(DomainService *service) {
+  free(service->serializeBuffer);
+  free(service->deserializeBuffer);
+  service->serializeBuffer = NULL;
+  service->deserializeBuffer = NULL;
+}
+
+/**
+ * Converts a service's receive timeout into a poll() or epoll_wait() timeout.
+ *
+ * @param timeout to evaluate
+ * @return timeout in ms, or -1 to block indefinitely
+ */
+static int toWaitTimeoutMs(const struct timeval *timeout) {
+  if (timeout == NULL || (timeout->tv_sec <= 0 && timeout->tv_usec <= 0)) {
+    return -1;
+  }
+  return (int) (timeout->tv_sec * 1000 + timeout->tv_usec / 1000);
+}
+
+/**
+ * @param service service starting to receive
+ * @param nowMs current time, from monotonicMs
+ * @return when the receive call times out, or 0 if it blocks indefinitely
+ */
+static uint64_t toReceiveDeadlineMs(const DomainService *service, const uint64_t nowMs) {
+  const int timeoutMs = toWaitTimeoutMs(&service->receiveTimeout);
+  return timeoutMs < 0 ? 0 : nowMs + timeoutMs;
+}
+
+/**
+ * Works out how long a server's event loop may block: until its receive call times out, or until its timers next need
+ * advancing, whichever comes first.
+ *
+ * @param server server whose loop is about to block
+ * @param receiveDeadlineMs when the receive call times out, or 0 if it never does
+ * @param nowMs current time, from monotonicMs
+ * @return timeout in ms, or -1 to block indefinitely
+ */
+static int toLoopTimeoutMs(DomainServer *server, const uint64_t receiveDeadlineMs, const uint64_t nowMs) {
+  int timeoutMs = server->timers->nextTimeoutMs(server->timers, nowMs);
+  if (receiveDeadlineMs > 0) {
+    const int untilDeadlineMs = receiveDeadlineMs > nowMs ? (int) (receiveDeadlineMs - nowMs) : 0;
+    if (timeoutMs < 0 || untilDeadlineMs < timeoutMs) {
+      timeoutMs = untilDeadlineMs;
+    }
+  }
+  return timeoutMs;
+}
+
 #endif
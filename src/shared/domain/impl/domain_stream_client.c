@@ -4,38 +4,67 @@
 
 #include <errno.h>
 
+#include <string.h>
+
 #include "domain_stream_shared.h"
 
+#define STREAM_CLIENT_INPUT_FRAMES 64
+
+/**
+ * Stream client state. Reads pull in as many frames as the socket has ready, so a burst from the server, like a feed
+ * replay, is consumed with a handful of system calls.
+ */
+typedef struct {
+  DomainClient base; // must be first
+  char *input; // frames read but not yet received
+  size_t inputCapacity;
+  size_t inputHead; // offset of the oldest unreceived byte
+  size_t inputLength;
+} StreamClient;
+
 /**
- * Sends message on a client's socket.
+ * Receives a message on a client's socket.
  *
  * @param client self-reference
- * @param message to send
+ * @param message caller-allocated space for the received message
  * @return DOMAIN_SUCCESS, DOMAIN_FAILURE, or TERMINATED
  */
 static int streamClientFromHost(DomainClient *client, void *message) {
-  char *buf = malloc(client->base.incomingDeserializer.messageSize);
-  if (!buf) {
-    printf("Failed to allocate message buffer\n");
-    return DOMAIN_FAILURE;
+  StreamClient *impl = (StreamClient *) client;
+  const size_t frameSize = client->base.incomingDeserializer.messageSize;
+
+  while (impl->inputLength < frameSize) {
+    if (impl->inputHead > 0) {
+      memmove(impl->input, impl->input + impl->inputHead, impl->inputLength);
+      impl->inputHead = 0;
+    }
+    const struct iovec segment = {
+      .iov_base = impl->input + impl->inputLength,
+      .iov_len = impl->inputCapacity - impl->inputLength
+    };
+    size_t received;
+    const int recvStatus = receiveTcpAvailable(client->base.sock, &segment, 1, &received);
+    if (recvStatus == TERMINATED) {
+      client->isConnected = false;
+      impl->inputLength = 0;
+      return TERMINATED;
+    }
+    if (recvStatus != SUCCESS) {
+      // WOULD_BLOCK means the receive timeout expired
+      printf("Unable to receive message from domain\n");
+      return DOMAIN_FAILURE;
+    }
+    impl->inputLength += received;
   }
 
-  int status = DOMAIN_SUCCESS;
-
-  int recvStatus = receiveTcpMessage(client->base.sock, buf, client->base.incomingDeserializer.messageSize);
-  if (recvStatus == ERROR) {
-    printf("Unable to receive message from domain\n");
-    status = DOMAIN_FAILURE;
-  } else if (recvStatus == TERMINATED) {
-    client->isConnected = false;
-    status = TERMINATED;
-  } else if (client->base.incomingDeserializer.deserializer(buf, message) ==
-             MESSAGE_DESERIALIZER_FAILURE) {
+  const char *frame = impl->input + impl->inputHead;
+  impl->inputHead = impl->inputLength == frameSize ? 0 : impl->inputHead + frameSize;
+  impl->inputLength -= frameSize;
+  if (client->base.incomingDeserializer.deserializer((char *) frame, message) == MESSAGE_DESERIALIZER_FAILURE) {
     printf("Unable to deserialize domain message\n");
-    status = DOMAIN_FAILURE;
+    return DOMAIN_FAILURE;
   }
-  free(buf);
-  return status;
+  return DOMAIN_SUCCESS;
 }
 
 /**
@@ -61,13 +90,42 @@ static int streamClientReceive(DomainClient *self, UserMessage *toReceive) {
   return streamClientFromHost(self, toReceive);
 }
 
+/**
+ * @see DomainClient#request
+ */
+static int streamClientRequest(DomainClient *self, UserMessage *request, UserMessage *responseOut) {
+  // the connection is reliable and ordered, so the next message received is the response
+  request->requestID = 0;
+  if (streamClientSend(self, request) == DOMAIN_FAILURE) {
+    return DOMAIN_FAILURE;
+  }
+  return streamClientReceive(self, responseOut);
+}
+
+/**
+ * @see DomainClient#submit
+ */
+static int streamClientSubmit(DomainClient *self, UserMessage *request, TimerWheel *timers, const int timeoutMs) {
+  printf("[ERROR] Stream Client: submit is only supported by Datagram clients\n");
+  return DOMAIN_FAILURE;
+}
+
+/**
+ * @see DomainClient#receiveAvailable
+ */
+static int streamClientReceiveAvailable(DomainClient *self, UserMessage *toReceive) {
+  printf("[ERROR] Stream Client: receiveAvailable is only supported by Datagram clients\n");
+  return DOMAIN_FAILURE;
+}
+
 /**
  * @see DomainClient#start
  */
 static int startStreamClient(DomainService *service) {
   const int sock = getSocket(NULL,
                              &service->receiveTimeout,
-                             service->connectionType);
+                             service->connectionType,
+                             false);
   if (sock < 0) {
     return DOMAIN_FAILURE;
   }
@@ -80,8 +138,22 @@ static int startStreamClient(DomainService *service) {
  */
 static int stopStreamClient(DomainService *service) {
   if (stopStreamService(service) != DOMAIN_FAILURE) {
-    ((DomainClient *) service)->isConnected = false;
+    StreamClient *impl = (StreamClient *) service;
+    impl->base.isConnected = false;
+    impl->inputHead = 0;
+    impl->inputLength = 0;
     return DOMAIN_SUCCESS;
   }
   return DOMAIN_FAILURE;
 }
+
+/**
+ * @see DomainService#destroy
+ */
+static int destroyStreamClient(DomainService **service) {
+  if (*service != NULL) {
+    free(((StreamClient *) *service)->input);
+    ((StreamClient *) *service)->input = NULL;
+  }
+  return destroyStreamService(service);
+}
@@ -2,156 +2,921 @@
 * Implementation of core TCP Server
 */
 
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/epoll.h>
+
+#include "collections/int_map.h"
 #include "domain_stream_shared.h"
 
-static int streamServerSend(DomainServer *self, UserMessage *toSend,
-                            ClientHandle *remoteTarget) {
-  return toStreamDomainHost((DomainService *) self, toSend, remoteTarget->clientSock);
+#define STREAM_EVENT_BATCH 64
+#define STREAM_INPUT_FRAMES 8
+
+/**
+ * Everything registered with the epoll instance starts with one of these, so ready events can be dispatched by type.
+ */
+typedef struct StreamEndpoint {
+  enum { LISTENER_ENDPOINT, CONNECTION_ENDPOINT, WATCH_ENDPOINT } type;
+} StreamEndpoint;
+
+/**
+ * Per-connection state. Client sockets are non-blocking: input is accumulated in a ring buffer and parsed into
+ * fixed-size frames, so a client that sends half a message never holds up anybody else. Output is queued in a second,
+ * bounded ring buffer that's flushed whenever the socket is writable, so a slow reader never holds up the server.
+ */
+typedef struct StreamConnection {
+  ClientHandle handle; // must be first - the list of clients exposes connections as ClientHandles
+  StreamEndpoint endpoint;
+  char *input; // ring buffer of received bytes that haven't been parsed into messages yet
+  size_t inputCapacity;
+  size_t inputHead; // offset of the first unparsed byte
+  size_t inputLength; // number of unparsed bytes
+  bool readable; // the socket may still hold unread input
+  bool closed; // the peer closed its end - deliver the complete messages left in the buffer, then terminate
+  char *output; // ring buffer of serialized frames the socket hasn't accepted yet
+  size_t outputCapacity;
+  size_t outputHead; // offset of the first unsent byte
+  size_t outputLength; // number of unsent bytes - the oldest frame may have been partially sent
+  bool writable; // the socket took everything we last gave it
+  bool congested; // the output queue hit the high watermark and hasn't drained to the low watermark yet
+  bool drained; // the queue has drained since being congested, DomainServer#onDrained hasn't been called yet
+  bool isQueued; // currently linked into the server's ready queue
+  struct StreamConnection *nextReady;
+  uint64_t lastActiveMs; // when a message last went either way, only tracked if the server has an idle timeout
+  Timer idleTimer; // closes the connection once it has been idle for the server's idle timeout
+  int clientIndex; // position in the list of clients, -1 if it couldn't be added
+} StreamConnection;
+
+/**
+ * Connection IDs are unique across every stream server in the process, so a handle can't be mistaken for a later
+ * connection that was handed the same socket by another server.
+ */
+static unsigned int connectionSequence = 0;
+
+static unsigned int nextConnectionID() {
+  unsigned int id;
+  do {
+    id = __atomic_add_fetch(&connectionSequence, 1, __ATOMIC_RELAXED);
+  } while (id == 0);
+  return id;
 }
 
-static int streamServerFromHost(DomainServer *server, void *message, int sock) {
-  char *buf = malloc(server->base.incomingDeserializer.messageSize);
-  if (!buf) {
-    printf("Failed to allocate message buffer\n");
-    return DOMAIN_FAILURE;
+#define CONNECTION_OF(endpointRef) \
+  ((StreamConnection *) ((char *) (endpointRef) - offsetof(StreamConnection, endpoint)))
+
+#define CONNECTION_OF_TIMER(timerRef) \
+  ((StreamConnection *) ((char *) (timerRef) - offsetof(StreamConnection, idleTimer)))
+
+/**
+ * A descriptor added to the event loop by DomainServer#watch.
+ */
+typedef struct StreamWatch {
+  StreamEndpoint endpoint; // must be first
+  int fd;
+  DomainWatchHandler onReadable;
+  void *context;
+  struct StreamWatch *next;
+} StreamWatch;
+
+/**
+ * Encapsulates the state of a Stream DomainServer. The epoll interest set is persistent: sockets are registered once on
+ * accept() and unregistered on close, so servicing an event costs the same regardless of how many clients are connected.
+ */
+typedef struct StreamServer {
+  DomainServer base;
+  int epollFd;
+  StreamEndpoint listener;
+  struct epoll_event events[STREAM_EVENT_BATCH];
+  bool isDispatching; // events is being walked - watches removed meanwhile are retired rather than freed
+  StreamWatch *watches; // only a handful of descriptors are ever watched, so a plain list suffices
+  StreamWatch *retiredWatches;
+  StreamConnection *readyHead; // connections with buffered messages or unread input, serviced round-robin
+  StreamConnection *readyTail;
+  IntMap *connections; // client socket -> StreamConnection
+  int outputHighWatermark; // in messages
+  int outputLowWatermark; // in messages
+  enum SlowConsumerPolicy slowConsumerPolicy;
+  int idleTimeoutMs; // 0 if connections are never closed for being idle
+  uint64_t loopMs; // when the event loop last woke up, close enough to stamp activity with
+} StreamServer;
+
+/**
+ * Appends a connection to the ready queue, unless it's already queued.
+ *
+ * @param impl self-reference
+ * @param connection connection needing service
+ */
+static void queueReady(StreamServer *impl, StreamConnection *connection) {
+  if (connection->isQueued) {
+    return;
+  }
+  connection->isQueued = true;
+  connection->nextReady = NULL;
+  if (impl->readyTail) {
+    impl->readyTail->nextReady = connection;
+  } else {
+    impl->readyHead = connection;
+  }
+  impl->readyTail = connection;
+}
+
+/**
+ * @param impl self-reference
+ * @return the next connection needing service, or NULL if the queue is empty
+ */
+static StreamConnection *dequeueReady(StreamServer *impl) {
+  StreamConnection *connection = impl->readyHead;
+  if (connection) {
+    impl->readyHead = connection->nextReady;
+    if (!impl->readyHead) {
+      impl->readyTail = NULL;
+    }
+    connection->nextReady = NULL;
+    connection->isQueued = false;
+  }
+  return connection;
+}
+
+static void abandonConnection(StreamServer *impl, StreamConnection *connection);
+
+/**
+ * Expires a connection's idle timer. Activity only stamps the connection rather than rescheduling the timer, so the
+ * timer fires once per idle timeout at most, and a connection that turns out to have been active is given the rest of
+ * its time.
+ *
+ * @param timers the server's timers
+ * @param timer the connection's idle timer
+ * @param context self-reference
+ */
+static void onIdleTimeout(TimerWheel *timers, Timer *timer, void *context) {
+  StreamServer *impl = context;
+  StreamConnection *connection = CONNECTION_OF_TIMER(timer);
+  if (connection->closed) {
+    return;
+  }
+  const uint64_t idleDeadlineMs = connection->lastActiveMs + impl->idleTimeoutMs;
+  if (idleDeadlineMs > timer->deadlineMs) {
+    timers->schedule(timers, timer, idleDeadlineMs, onIdleTimeout, impl);
+    return;
+  }
+  printf("[DEBUG] Stream Server: closing socket %d after %d ms idle\n", connection->handle.clientSock,
+         impl->idleTimeoutMs);
+  abandonConnection(impl, connection);
+}
+
+/**
+ * Accepts every pending connection on the listening socket, registering each new client with the interest set.
+ *
+ * @param impl self-reference
+ * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
+ */
+static int acceptClients(StreamServer *impl) {
+  DomainServer *self = (DomainServer *) impl;
+  while (true) {
+    struct sockaddr_in clientAddr;
+    int clientSock;
+    const int acceptStatus = tcpAccept(self->base.sock, &clientAddr, &clientSock);
+    if (acceptStatus == WOULD_BLOCK) {
+      return DOMAIN_SUCCESS;
+    }
+    if (acceptStatus == ERROR) {
+      printf("Stream Server: accept failed\n");
+      return DOMAIN_FAILURE;
+    }
+    if (setNonBlocking(clientSock) == ERROR) {
+      close(clientSock);
+      continue;
+    }
+    StreamConnection *connection = calloc(1, sizeof(StreamConnection));
+    const size_t inputCapacity = STREAM_INPUT_FRAMES * self->base.incomingDeserializer.messageSize;
+    const size_t outputCapacity = impl->outputHighWatermark * self->base.outgoingSerializer.messageSize;
+    char *input = malloc(inputCapacity);
+    char *output = malloc(outputCapacity);
+    if (!connection || !input || !output) {
+      printf("Stream Server: failed to allocate connection\n");
+      free(connection);
+      free(input);
+      free(output);
+      close(clientSock);
+      return DOMAIN_FAILURE;
+    }
+    connection->handle.userID = NO_USER;
+    connection->handle.clientSock = clientSock;
+    connection->handle.clientAddr = clientAddr;
+    connection->handle.connectionID = nextConnectionID();
+    connection->endpoint.type = CONNECTION_ENDPOINT;
+    connection->input = input;
+    connection->inputCapacity = inputCapacity;
+    connection->output = output;
+    connection->outputCapacity = outputCapacity;
+    connection->writable = true;
+
+    // EPOLLOUT is edge-triggered too, so it's only reported when a full socket buffer drains
+    struct epoll_event event = {
+      .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+      .data.ptr = &connection->endpoint
+    };
+    if (epoll_ctl(impl->epollFd, EPOLL_CTL_ADD, clientSock, &event) < 0) {
+      perror("[ERROR] Stream Server: unable to register client socket");
+      close(clientSock);
+      free(input);
+      free(output);
+      free(connection);
+      continue;
+    }
+    impl->connections->add(impl->connections, clientSock, connection);
+    connection->clientIndex = self->clients->length;
+    if (self->clients->append(self->clients, connection) == ERROR) {
+      connection->clientIndex = -1;
+    }
+    if (impl->idleTimeoutMs > 0) {
+      connection->lastActiveMs = impl->loopMs;
+      self->timers->schedule(self->timers, &connection->idleTimer, impl->loopMs + impl->idleTimeoutMs, onIdleTimeout,
+                             impl);
+    }
+  }
+}
+
+/**
+ * Unregisters a connection from the interest set and the list of clients, then closes its socket.
+ *
+ * @param impl self-reference
+ * @param connection connection to release - must not be queued
+ */
+static void closeConnection(StreamServer *impl, StreamConnection *connection) {
+  List *clients = impl->base.clients;
+  StreamConnection *moved;
+  if (connection->clientIndex >= 0 && clients->swapRemove(clients, connection->clientIndex, NULL) == SUCCESS
+      && clients->get(clients, connection->clientIndex, (void **) &moved) == SUCCESS) {
+    moved->clientIndex = connection->clientIndex; // the last client took the closed one's place
   }
+  impl->base.timers->cancel(impl->base.timers, &connection->idleTimer);
+  void *mapped;
+  impl->connections->remove(impl->connections, connection->handle.clientSock, &mapped);
+  epoll_ctl(impl->epollFd, EPOLL_CTL_DEL, connection->handle.clientSock, NULL);
+  close(connection->handle.clientSock);
+  free(connection->input);
+  free(connection->output);
+  free(connection);
+}
+
+/**
+ * Drains the socket into the connection's ring buffer, stopping when the socket has nothing more to give or the buffer
+ * is full. In the latter case the connection stays readable, since edge-triggered epoll won't report it again.
+ *
+ * @param connection connection to read from
+ */
+static void fillInput(StreamConnection *connection) {
+  while (connection->readable && connection->inputLength < connection->inputCapacity) {
+    const size_t tail = (connection->inputHead + connection->inputLength) % connection->inputCapacity;
+    const size_t space = connection->inputCapacity - connection->inputLength;
+    struct iovec segments[2];
+    int segmentCount = 1;
+    segments[0].iov_base = connection->input + tail;
+    if (tail + space <= connection->inputCapacity) {
+      segments[0].iov_len = space;
+    } else {
+      segments[0].iov_len = connection->inputCapacity - tail;
+      segments[1].iov_base = connection->input;
+      segments[1].iov_len = space - segments[0].iov_len;
+      segmentCount = 2;
+    }
+
+    size_t received;
+    const int status = receiveTcpAvailable(connection->handle.clientSock, segments, segmentCount, &received);
+    if (status == SUCCESS) {
+      connection->inputLength += received;
+    } else if (status == WOULD_BLOCK) {
+      connection->readable = false;
+    } else {
+      // TERMINATED or ERROR - either way, nothing more will arrive on this socket
+      connection->readable = false;
+      connection->closed = true;
+    }
+  }
+}
 
-  int status = DOMAIN_SUCCESS;
+/**
+ * Parses the oldest complete frame out of a connection's ring buffer.
+ *
+ * @param impl self-reference
+ * @param connection connection holding at least one complete frame
+ * @param message output, the deserialized message
+ * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
+ */
+static int parseFrame(StreamServer *impl, StreamConnection *connection, void *message) {
+  const size_t frameSize = impl->base.base.incomingDeserializer.messageSize;
+  char *frame = connection->input + connection->inputHead;
+  const size_t contiguous = connection->inputCapacity - connection->inputHead;
+  if (contiguous < frameSize) {
+    // the frame wraps around the end of the ring buffer, so it's reassembled in the service's deserialize buffer
+    char *reassembled = impl->base.base.deserializeBuffer;
+    memcpy(reassembled, frame, contiguous);
+    memcpy(reassembled + contiguous, connection->input, frameSize - contiguous);
+    frame = reassembled;
+  }
+  connection->inputHead = (connection->inputHead + frameSize) % connection->inputCapacity;
+  connection->inputLength -= frameSize;
 
-  int recvStatus = receiveTcpMessage(sock, buf, server->base.incomingDeserializer.messageSize);
-  if (recvStatus == ERROR) {
-    printf("Unable to receive message from domain\n");
-    status = DOMAIN_FAILURE;
-  } else if (recvStatus == TERMINATED) {
-    status = TERMINATED;
-  } else if (server->base.incomingDeserializer.deserializer(buf, message) ==
-             MESSAGE_DESERIALIZER_FAILURE) {
+  if (impl->base.base.incomingDeserializer.deserializer(frame, message) == MESSAGE_DESERIALIZER_FAILURE) {
     printf("Unable to deserialize domain message\n");
-    status = DOMAIN_FAILURE;
+    return DOMAIN_FAILURE;
   }
-  free(buf);
-  return status;
+  return DOMAIN_SUCCESS;
 }
 
 /**
- * Initializes fd_set
+ * Services a single ready connection, delivering at most one message. Connections that still have work left are
+ * re-queued behind the others, so pipelined requests are all handled without starving other clients.
  *
- * @param self
- * @param allSocks set to initialize
- * @return The max file descriptor
+ * @param impl self-reference
+ * @param connection connection to service
+ * @param toReceiveOut inbound message
+ * @param clientCallbackOut client details associated with the message
+ * @return DOMAIN_SUCCESS, DOMAIN_FAILURE, TERMINATED, or WOULD_BLOCK if there was nothing to deliver
  */
-static int initDescriptors(DomainServer *self, fd_set *allSocks) {
-  FD_ZERO(allSocks);
-  FD_SET(self->base.sock, allSocks);
-  int maxFd = self->base.sock;
-  List *clients = self->clients;
-  for (int i = 0; i < clients->length; i++) {
-    ClientHandle *client;
-    clients->get(clients, i, (void **) &client);
-    if (client->clientSock > maxFd) {
-      maxFd = client->clientSock;
+static int serviceConnection(StreamServer *impl, StreamConnection *connection, UserMessage *toReceiveOut,
+                             ClientHandle *clientCallbackOut) {
+  const size_t frameSize = impl->base.base.incomingDeserializer.messageSize;
+  fillInput(connection);
+
+  if (connection->inputLength >= frameSize) {
+    const int resp = parseFrame(impl, connection, toReceiveOut);
+    if (connection->inputLength >= frameSize || connection->readable || connection->closed) {
+      queueReady(impl, connection);
+    }
+    if (resp == DOMAIN_SUCCESS) {
+      connection->handle.userID = toReceiveOut->userID;
+    }
+    connection->lastActiveMs = impl->loopMs;
+    *clientCallbackOut = connection->handle;
+    return resp;
+  }
+
+  if (connection->closed) {
+    // client terminated connection - release it and inform caller in case they're interested
+    if (connection->inputLength > 0) {
+      printf("[WARNING] Stream Server: discarding %zu bytes of a partial message\n", connection->inputLength);
     }
-    FD_SET(client->clientSock, allSocks);
+    *clientCallbackOut = connection->handle;
+    closeConnection(impl, connection);
+    return TERMINATED;
   }
-  return maxFd;
+
+  // a partial frame waits in the buffer until the rest arrives
+  return WOULD_BLOCK;
+}
+
+/**
+ * @param connection connection to inspect
+ * @param frameSize size of a serialized outbound message
+ * @return number of queued frames, counting one that's partially sent
+ */
+static size_t queuedFrames(const StreamConnection *connection, const size_t frameSize) {
+  return (connection->outputLength + frameSize - 1) / frameSize;
 }
 
 /**
- * Tests timeval struct to determine if it's non-zero.
+ * Marks a connection as dead. It's handed back to receive() so the caller learns about it through TERMINATED.
  *
- * @param timeout to evaluate
- * @return true, false
+ * @param impl self-reference
+ * @param connection connection to abandon
  */
-static bool isTimeoutEnabled(struct timeval * timeout) {
-  return timeout != NULL && (timeout->tv_sec > 0 || timeout->tv_usec > 0);
+static void abandonConnection(StreamServer *impl, StreamConnection *connection) {
+  connection->closed = true;
+  connection->readable = false;
+  connection->writable = false;
+  connection->outputLength = 0;
+  queueReady(impl, connection);
+}
+
+/**
+ * Writes queued output until the queue is empty or the socket would block. Edge-triggered epoll reports EPOLLOUT
+ * again once the socket drains, at which point this is called again.
+ *
+ * @param impl self-reference
+ * @param connection connection to flush
+ */
+static void flushOutput(StreamServer *impl, StreamConnection *connection) {
+  while (connection->writable && connection->outputLength > 0) {
+    struct iovec segments[2];
+    int segmentCount = 1;
+    segments[0].iov_base = connection->output + connection->outputHead;
+    if (connection->outputHead + connection->outputLength <= connection->outputCapacity) {
+      segments[0].iov_len = connection->outputLength;
+    } else {
+      segments[0].iov_len = connection->outputCapacity - connection->outputHead;
+      segments[1].iov_base = connection->output;
+      segments[1].iov_len = connection->outputLength - segments[0].iov_len;
+      segmentCount = 2;
+    }
+
+    size_t sent;
+    const int status = sendTcpAvailable(connection->handle.clientSock, segments, segmentCount, &sent);
+    if (status == SUCCESS) {
+      connection->outputHead = (connection->outputHead + sent) % connection->outputCapacity;
+      connection->outputLength -= sent;
+      connection->lastActiveMs = impl->loopMs;
+    } else if (status == WOULD_BLOCK) {
+      connection->writable = false;
+    } else {
+      abandonConnection(impl, connection);
+      return;
+    }
+  }
+
+  const size_t frameSize = impl->base.base.outgoingSerializer.messageSize;
+  if (connection->congested && queuedFrames(connection, frameSize) <= (size_t) impl->outputLowWatermark) {
+    printf("[DEBUG] Stream Server: output for socket %d has drained\n", connection->handle.clientSock);
+    connection->congested = false;
+    connection->drained = true;
+  }
+}
+
+/**
+ * Makes room in a full output queue according to the server's SlowConsumerPolicy.
+ *
+ * @param impl self-reference
+ * @param connection connection whose queue is full
+ * @param frame serialized message that didn't fit
+ * @return DOMAIN_SUCCESS if the frame was dealt with, DOMAIN_FAILURE if the connection was dropped, or WOULD_BLOCK if
+ *         room was made and the frame still needs appending
+ */
+static int applySlowConsumerPolicy(StreamServer *impl, StreamConnection *connection, const char *frame) {
+  const size_t frameSize = impl->base.base.outgoingSerializer.messageSize;
+  const size_t capacity = connection->outputCapacity;
+  const size_t partial = connection->outputLength % frameSize; // unsent bytes of a partially sent frame, if any
+
+  if (impl->slowConsumerPolicy == DISCONNECT) {
+    printf("[WARNING] Stream Server: disconnecting slow consumer on socket %d\n", connection->handle.clientSock);
+    abandonConnection(impl, connection);
+    return DOMAIN_FAILURE;
+  }
+
+  if (impl->slowConsumerPolicy == COALESCE) {
+    const size_t newest = (connection->outputHead + connection->outputLength - frameSize) % capacity;
+    for (size_t i = 0; i < frameSize; i++) {
+      connection->output[(newest + i) % capacity] = frame[i];
+    }
+    return DOMAIN_SUCCESS;
+  }
+
+  // DROP_OLDEST - a partially sent frame has to go out intact, so it's shifted over the frame being dropped
+  for (size_t i = partial; i > 0; i--) {
+    connection->output[(connection->outputHead + frameSize + i - 1) % capacity] =
+        connection->output[(connection->outputHead + i - 1) % capacity];
+  }
+  connection->outputHead = (connection->outputHead + frameSize) % capacity;
+  connection->outputLength -= frameSize;
+  return WOULD_BLOCK;
+}
+
+/**
+ * Copies a serialized frame to the tail of a connection's output queue, which must have room for it.
+ *
+ * @param connection destination
+ * @param frame serialized message
+ * @param frameSize size of the frame
+ */
+static void appendFrame(StreamConnection *connection, const char *frame, const size_t frameSize) {
+  const size_t capacity = connection->outputCapacity;
+  const size_t tail = (connection->outputHead + connection->outputLength) % capacity;
+  const size_t contiguous = capacity - tail;
+  if (frameSize <= contiguous) {
+    memcpy(connection->output + tail, frame, frameSize);
+  } else {
+    memcpy(connection->output + tail, frame, contiguous);
+    memcpy(connection->output, frame + contiguous, frameSize - contiguous);
+  }
+  connection->outputLength += frameSize;
+}
+
+/**
+ * Marks a connection's output queue as full if the socket has left it at the high watermark.
+ *
+ * @param impl self-reference
+ * @param connection connection to inspect
+ * @return true if the queue is full
+ */
+static bool checkCongestion(StreamServer *impl, StreamConnection *connection) {
+  const size_t frameSize = impl->base.base.outgoingSerializer.messageSize;
+  if (queuedFrames(connection, frameSize) < (size_t) impl->outputHighWatermark) {
+    return false;
+  }
+  if (!connection->congested) {
+    printf("[WARNING] Stream Server: output queue for socket %d is full\n", connection->handle.clientSock);
+    connection->congested = true;
+  }
+  return true;
+}
+
+/**
+ * Appends a serialized frame to a connection's output queue and flushes what the socket will take.
+ *
+ * @param impl self-reference
+ * @param connection destination
+ * @param frame serialized message
+ * @return DOMAIN_SUCCESS or DOMAIN_FAILURE
+ */
+static int enqueueFrame(StreamServer *impl, StreamConnection *connection, const char *frame) {
+  const size_t frameSize = impl->base.base.outgoingSerializer.messageSize;
+  if (queuedFrames(connection, frameSize) >= (size_t) impl->outputHighWatermark) {
+    const int policyStatus = applySlowConsumerPolicy(impl, connection, frame);
+    if (policyStatus != WOULD_BLOCK) {
+      return policyStatus;
+    }
+  }
+  appendFrame(connection, frame, frameSize);
+  flushOutput(impl, connection);
+  if (!connection->closed) {
+    checkCongestion(impl, connection);
+  }
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ * Looks up the open connection a ClientHandle refers to.
+ *
+ * @param impl self-reference
+ * @param remoteTarget client details
+ * @return the connection, or NULL if it has since been closed or replaced
+ */
+static StreamConnection *findConnection(StreamServer *impl, const ClientHandle *remoteTarget) {
+  StreamConnection *connection = NULL;
+  if (impl->connections == NULL
+      || impl->connections->get(impl->connections, remoteTarget->clientSock, (void **) &connection) != SUCCESS
+      || connection->closed) {
+    printf("[WARNING] Stream Server: no open connection for socket %d\n", remoteTarget->clientSock);
+    return NULL;
+  }
+  if (remoteTarget->connectionID != 0 && remoteTarget->connectionID != connection->handle.connectionID) {
+    printf("[WARNING] Stream Server: connection on socket %d has since been replaced\n", remoteTarget->clientSock);
+    return NULL;
+  }
+  return connection;
+}
+
+/**
+ * @see DomainServer#send
+ */
+static int streamServerSend(DomainServer *self, UserMessage *toSend,
+                            ClientHandle *remoteTarget) {
+  StreamServer *impl = (StreamServer *) self;
+  StreamConnection *connection = findConnection(impl, remoteTarget);
+  if (connection == NULL) {
+    return DOMAIN_FAILURE;
+  }
+  if (self->base.outgoingSerializer.serializer(toSend, self->base.serializeBuffer) == MESSAGE_SERIALIZER_FAILURE) {
+    printf("Unable to serialize domain message\n");
+    return DOMAIN_FAILURE;
+  }
+  return enqueueFrame(impl, connection, self->base.serializeBuffer);
+}
+
+/**
+ * Stream/TCP implementation of DomainServer#broadcast - the message is serialized once, then patched for and copied
+ * straight into each recipient's output queue.
+ */
+static int streamServerBroadcast(DomainServer *self, UserMessage *message, ClientHandle *clientHandles,
+                                 const int recipientCount, int *sentCountOut) {
+  StreamServer *impl = (StreamServer *) self;
+  const MessageSerializer *serializer = &self->base.outgoingSerializer;
+  char *frame = self->base.serializeBuffer;
+  *sentCountOut = 0;
+  if (serializer->serializer(message, frame) == MESSAGE_SERIALIZER_FAILURE) {
+    printf("Unable to serialize domain message\n");
+    return DOMAIN_FAILURE;
+  }
+  for (int i = 0; i < recipientCount; i++) {
+    StreamConnection *connection = findConnection(impl, &clientHandles[i]);
+    if (connection == NULL) {
+      continue;
+    }
+    if (serializer->userIDPatcher != NULL) {
+      serializer->userIDPatcher(frame, clientHandles[i].userID);
+    }
+    if (enqueueFrame(impl, connection, frame) == DOMAIN_SUCCESS) {
+      (*sentCountOut)++;
+    }
+  }
+  return *sentCountOut == recipientCount ? DOMAIN_SUCCESS : DOMAIN_FAILURE;
 }
 
 /**
  * Stream/TCP implementation of DomainServer#receive
  *
- * Utilizes select() to multiplex between accepting new connections (via the server's socket) and multiple concurrently
- * active client sockets.
+ * Utilizes an edge-triggered epoll instance to multiplex between accepting new connections (via the server's socket)
+ * and multiple concurrently active, non-blocking client sockets. Ready connections are serviced one message at a time
+ * across successive calls.
  *
  * @param self self-reference
  * @param toReceiveOut inbound message
  * @param clientCallbackOut client details associated with the message
- * @return
+ * @return DOMAIN_SUCCESS, DOMAIN_FAILURE, or TERMINATED
  */
 static int streamServerReceive(DomainServer *self, UserMessage *toReceiveOut,
                                ClientHandle *clientCallbackOut) {
+  StreamServer *impl = (StreamServer *) self;
+  const uint64_t receiveDeadlineMs = toReceiveDeadlineMs(&self->base, monotonicMs());
   while (true) {
-    fd_set allSocks;
-    const int maxFd = initDescriptors(self, &allSocks);
-    struct timeval *timeout = isTimeoutEnabled(&self->base.receiveTimeout) ? &self->base.receiveTimeout : NULL;
-    const int rv = select(maxFd + 1, &allSocks, NULL, NULL, timeout);
+    const uint64_t nowMs = monotonicMs();
+    impl->loopMs = nowMs;
+    self->timers->advance(self->timers, nowMs);
+
+    StreamConnection *connection = dequeueReady(impl);
+    if (connection) {
+      const int resp = serviceConnection(impl, connection, toReceiveOut, clientCallbackOut);
+      if (resp != WOULD_BLOCK) {
+        return resp;
+      }
+      continue;
+    }
+
+    if (receiveDeadlineMs > 0 && nowMs >= receiveDeadlineMs) {
+      printf("Stream Server: epoll timeout\n");
+      return DOMAIN_FAILURE;
+    }
+    const int rv = epoll_wait(impl->epollFd, impl->events, STREAM_EVENT_BATCH,
+                              toLoopTimeoutMs(self, receiveDeadlineMs, nowMs));
     if (rv == -1) {
-      printf("Stream Server: select() failed\n");
+      if (errno == EINTR) {
+        continue;
+      }
+      printf("Stream Server: epoll_wait() failed\n");
       return DOMAIN_FAILURE;
     }
     if (rv == 0) {
-      printf("Stream Server: select timeout\n");
-      return DOMAIN_FAILURE;
+      // a timer is due, or the receive timeout has run out
+      continue;
     }
-    // do we have a new connection we need to accept()?
-    if (FD_ISSET(self->base.sock, &allSocks)) {
-      struct sockaddr_in clientAddr;
-      int clientSock;
-      if (tcpAccept(self->base.sock, &clientAddr, &clientSock) == ERROR) {
-        printf("Stream Server: accept failed\n");
-        return DOMAIN_FAILURE;
-      }
-      ClientHandle *client = malloc(sizeof(ClientHandle));
-      client->userID = NO_USER;
-      client->clientSock = clientSock;
-      client->clientAddr = clientAddr;
-      self->clients->append(self->clients, client);
-    } else {
-      // if there's no pending connections, at least one of the persistent clients sockets must have data available
-      for (int i = 0; i < self->clients->length; i++) {
-        ClientHandle *clientHandle;
-        self->clients->get(self->clients, i, (void **) &clientHandle);
-        if (FD_ISSET(clientHandle->clientSock, &allSocks)) {
-          // we found a socket needing servicing!
-          const int resp = streamServerFromHost(self, toReceiveOut, clientHandle->clientSock);
-          if (resp == DOMAIN_SUCCESS) {
-            // received client message
-            clientHandle->userID = toReceiveOut->userID;
-            clientCallbackOut->userID = clientHandle->userID;
-            clientCallbackOut->clientSock = clientHandle->clientSock;
-            clientCallbackOut->clientAddr = clientHandle->clientAddr;
-          } else if (resp == TERMINATED) {
-            // client terminated connection - remove from list of clients and inform caller in case they're interested
-            if (self->clients->remove(self->clients, i, (void **) &clientCallbackOut) == ERROR) {
-              printf("[ERROR] Stream Server: remove failed\n");
+    impl->loopMs = monotonicMs();
+
+    impl->isDispatching = true;
+    for (int i = 0; i < rv; i++) {
+      StreamEndpoint *endpoint = impl->events[i].data.ptr;
+      const uint32_t events = impl->events[i].events;
+      if (endpoint->type == LISTENER_ENDPOINT) {
+        if (acceptClients(impl) == DOMAIN_FAILURE) {
+          printf("Stream Server: failed to accept pending connections\n");
+        }
+      } else if (endpoint->type == WATCH_ENDPOINT) {
+        StreamWatch *watch = (StreamWatch *) endpoint;
+        if (watch->fd >= 0) {
+          watch->onReadable(self, watch->fd, watch->context);
+        }
+      } else {
+        StreamConnection *readyConnection = CONNECTION_OF(endpoint);
+        if (events & EPOLLOUT && !readyConnection->closed) {
+          readyConnection->writable = true;
+          flushOutput(impl, readyConnection);
+          if (readyConnection->drained && !readyConnection->closed) {
+            readyConnection->drained = false;
+            if (self->onDrained != NULL) {
+              self->onDrained(self, &readyConnection->handle);
             }
-            close(clientCallbackOut->clientSock);
-            free(clientCallbackOut);
           }
-          return resp;
+        }
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+          readyConnection->readable = true;
+          queueReady(impl, readyConnection);
         }
       }
     }
+    impl->isDispatching = false;
+    while (impl->retiredWatches) {
+      StreamWatch *retired = impl->retiredWatches;
+      impl->retiredWatches = retired->next;
+      free(retired);
+    }
   }
 }
 
+/**
+ * Stream/TCP implementation of DomainServer#receiveBatch - connections are already multiplexed by the event loop, so
+ * this hands out a single message per call.
+ */
+static int streamServerReceiveBatch(DomainServer *self, void *receivedOut, const size_t messageStride,
+                                    ClientHandle *clientCallbacksOut, const int maxMessages,
+                                    int *receivedCountOut) {
+  *receivedCountOut = 0;
+  if (maxMessages < 1) {
+    return DOMAIN_FAILURE;
+  }
+  const int resp = streamServerReceive(self, receivedOut, clientCallbacksOut);
+  if (resp == DOMAIN_SUCCESS) {
+    *receivedCountOut = 1;
+  }
+  return resp;
+}
+
+/**
+ * Stream/TCP implementation of DomainServer#sendBatch
+ *
+ * Consecutive messages for the same connection are appended to its output queue and go out together in one gathered
+ * write. Rather than invoking the SlowConsumerPolicy, the batch stops at the first message that finds its connection's
+ * queue full; the connection is then reported to DomainServer#onDrained once the client has caught up.
+ */
+static int streamServerSendBatch(DomainServer *self, void *messages, const size_t messageStride,
+                                 ClientHandle *clientHandles, const int messageCount, int *sentCountOut) {
+  StreamServer *impl = (StreamServer *) self;
+  const size_t frameSize = self->base.outgoingSerializer.messageSize;
+  StreamConnection *unflushed = NULL;
+  *sentCountOut = 0;
+
+  for (int i = 0; i < messageCount; i++) {
+    StreamConnection *connection = findConnection(impl, &clientHandles[i]);
+    if (unflushed != NULL && connection != unflushed) {
+      flushOutput(impl, unflushed);
+      unflushed = NULL;
+    }
+    if (connection == NULL) {
+      break;
+    }
+    if (queuedFrames(connection, frameSize) >= (size_t) impl->outputHighWatermark) {
+      flushOutput(impl, connection);
+      unflushed = NULL;
+      if (connection->closed || checkCongestion(impl, connection)) {
+        break;
+      }
+    }
+    UserMessage *message = (UserMessage *) ((char *) messages + i * messageStride);
+    if (self->base.outgoingSerializer.serializer(message, self->base.serializeBuffer)
+        == MESSAGE_SERIALIZER_FAILURE) {
+      printf("Unable to serialize domain message\n");
+      break;
+    }
+    appendFrame(connection, self->base.serializeBuffer, frameSize);
+    unflushed = connection;
+    (*sentCountOut)++;
+  }
+  if (unflushed != NULL) {
+    flushOutput(impl, unflushed);
+    if (!unflushed->closed) {
+      checkCongestion(impl, unflushed);
+    }
+  }
+  return *sentCountOut == messageCount ? DOMAIN_SUCCESS : DOMAIN_FAILURE;
+}
+
+/**
+ * @see DomainServer#watch
+ */
+static int streamServerWatch(DomainServer *self, const int fd, const DomainWatchHandler onReadable, void *context) {
+  StreamServer *impl = (StreamServer *) self;
+  if (impl->epollFd < 0 || onReadable == NULL) {
+    return DOMAIN_FAILURE;
+  }
+  StreamWatch *watch = calloc(1, sizeof(StreamWatch));
+  if (!watch) {
+    return DOMAIN_FAILURE;
+  }
+  watch->endpoint.type = WATCH_ENDPOINT;
+  watch->fd = fd;
+  watch->onReadable = onReadable;
+  watch->context = context;
+
+  struct epoll_event event = {
+    .events = EPOLLIN | EPOLLET,
+    .data.ptr = watch
+  };
+  if (epoll_ctl(impl->epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    perror("[ERROR] Stream Server: unable to watch descriptor");
+    free(watch);
+    return DOMAIN_FAILURE;
+  }
+  watch->next = impl->watches;
+  impl->watches = watch;
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ * @see DomainServer#unwatch
+ */
+static int streamServerUnwatch(DomainServer *self, const int fd) {
+  StreamServer *impl = (StreamServer *) self;
+  StreamWatch **link = &impl->watches;
+  while (*link != NULL && (*link)->fd != fd) {
+    link = &(*link)->next;
+  }
+  StreamWatch *watch = *link;
+  if (watch == NULL) {
+    return DOMAIN_FAILURE;
+  }
+  *link = watch->next;
+  epoll_ctl(impl->epollFd, EPOLL_CTL_DEL, fd, NULL);
+  if (impl->isDispatching) {
+    // a ready event for this watch may still be pending in the current batch
+    watch->fd = -1;
+    watch->next = impl->retiredWatches;
+    impl->retiredWatches = watch;
+  } else {
+    free(watch);
+  }
+  return DOMAIN_SUCCESS;
+}
+
 /**
  * @see DomainService#start
  */
 static int startStreamServer(DomainService *service) {
+  StreamServer *impl = (StreamServer *) service;
   const int sock = getSocket(&service->localAddr,
                              &service->receiveTimeout,
-                             service->connectionType);
+                             service->connectionType,
+                             service->reusePort);
   if (sock < 0) {
     return DOMAIN_FAILURE;
   }
   service->sock = sock;
-  if (tcpListen(sock) == ERROR) {
+  if (tcpListen(sock) == ERROR || setNonBlocking(sock) == ERROR) {
     printf("Stream Serve: Unable to listen for incoming messages\n");
     close(sock);
     service->sock = INACTIVE_SOCK;
     return DOMAIN_FAILURE;
   }
-  DomainServer *impl = (DomainServer *) service;
-  createList(&impl->clients);
+
+  impl->epollFd = epoll_create1(EPOLL_CLOEXEC);
+  impl->listener.type = LISTENER_ENDPOINT;
+  struct epoll_event listenEvent = {
+    .events = EPOLLIN | EPOLLET,
+    .data.ptr = &impl->listener
+  };
+  if (createMap(&impl->connections) != SUCCESS
+      || impl->epollFd < 0 || epoll_ctl(impl->epollFd, EPOLL_CTL_ADD, sock, &listenEvent) < 0) {
+    perror("[ERROR] Stream Server: unable to initialize epoll");
+    if (impl->epollFd >= 0) {
+      close(impl->epollFd);
+      impl->epollFd = INACTIVE_SOCK;
+    }
+    if (impl->connections) {
+      impl->connections->destroy(&impl->connections);
+    }
+    close(sock);
+    service->sock = INACTIVE_SOCK;
+    return DOMAIN_FAILURE;
+  }
+  impl->readyHead = NULL;
+  impl->readyTail = NULL;
+
+  createList(&impl->base.clients);
+  return DOMAIN_SUCCESS;
+}
+
+/**
+ * @see DomainService#stop
+ */
+static int stopStreamServer(DomainService *service) {
+  StreamServer *impl = (StreamServer *) service;
+  List *clients = impl->base.clients;
+  if (clients != NULL) {
+    ListCursor cursor = LIST_CURSOR_START;
+    StreamConnection *connection;
+    while (clients->next(clients, &cursor, (void **) &connection)) {
+      impl->base.timers->cancel(impl->base.timers, &connection->idleTimer);
+      close(connection->handle.clientSock);
+      free(connection->input);
+      free(connection->output);
+      free(connection);
+    }
+    clients->destroy(&impl->base.clients);
+  }
+  if (impl->connections != NULL) {
+    impl->connections->destroy(&impl->connections);
+  }
+  // watched descriptors belong to the caller, only our bookkeeping is released
+  StreamWatch *lists[] = {impl->watches, impl->retiredWatches};
+  for (int i = 0; i < 2; i++) {
+    while (lists[i] != NULL) {
+      StreamWatch *watch = lists[i];
+      lists[i] = watch->next;
+      free(watch);
+    }
+  }
+  impl->watches = NULL;
+  impl->retiredWatches = NULL;
+  if (impl->epollFd >= 0) {
+    close(impl->epollFd);
+    impl->epollFd = INACTIVE_SOCK;
+  }
+  impl->readyHead = NULL;
+  impl->readyTail = NULL;
+  return stopStreamService(service);
+}
+
+/**
+ * @see DomainService#destroy
+ */
+static int destroyStreamServer(DomainService **service) {
+  if (*service != NULL) {
+    if (stopStreamServer(*service) == DOMAIN_FAILURE) {
+      return DOMAIN_FAILURE;
+    }
+    DomainServer *server = (DomainServer *) *service;
+    server->timers->destroy(&server->timers);
+    releaseServiceBuffers(*service);
+    free(*service);
+    *service = NULL;
+  }
   return DOMAIN_SUCCESS;
 }
@@ -15,7 +15,7 @@
  * @return DOMAIN_SUCCESS, DOMAIN_FAILURE
  */
 static int toStreamDomainHost(DomainService *service, void *message, const int sock) {
-  char *buf = malloc(service->outgoingSerializer.messageSize);
+  char *buf = service->serializeBuffer;
 
   int status = DOMAIN_SUCCESS;
 
@@ -28,7 +28,6 @@ static int toStreamDomainHost(DomainService *service, void *message, const int s
     status = DOMAIN_FAILURE;
   }
 
-  free(buf);
   return status;
 }
 
@@ -51,6 +50,7 @@ static int destroyStreamService(DomainService **service) {
     if (stopStreamService(*service) == DOMAIN_FAILURE) {
       return DOMAIN_FAILURE;
     }
+    releaseServiceBuffers(*service);
     free(*service);
   }
   return DOMAIN_SUCCESS;
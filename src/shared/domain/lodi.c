@@ -19,6 +19,7 @@ int serializeClientLodi(PClientToLodiServer *toSerialize, char *serialized) {
   size_t offset = 0;
   appendUint32(serialized, &offset, toSerialize->messageType);
   appendUint32(serialized, &offset, toSerialize->userID);
+  appendUint32(serialized, &offset, toSerialize->requestID);
   appendUint32(serialized, &offset, toSerialize->recipientID);
   appendUint64(serialized, &offset, toSerialize->timestamp);
   appendUint64(serialized, &offset, toSerialize->digitalSig);
@@ -30,16 +31,23 @@ int serializeServerLoginLodi(LodiServerMessage *toSerialize, char *serialized) {
   size_t offset = 0;
   appendUint32(serialized, &offset, toSerialize->messageType);
   appendUint32(serialized, &offset, toSerialize->userID);
+  appendUint32(serialized, &offset, toSerialize->requestID);
   appendUint32(serialized, &offset, toSerialize->recipientID);
   memcpy(serialized + offset, toSerialize->message, LODI_MESSAGE_LENGTH * sizeof(char));
 
   return MESSAGE_SERIALIZER_SUCCESS;
 }
 
+void patchServerLodiUserID(char *serialized, const unsigned int userID) {
+  size_t offset = sizeof(uint32_t); // userID follows messageType
+  appendUint32(serialized, &offset, userID);
+}
+
 int deserializeClientLodi(char *serialized, PClientToLodiServer *deserialized) {
   size_t offset = 0;
   deserialized->messageType = getUint32(serialized, &offset);
   deserialized->userID = getUint32(serialized, &offset);
+  deserialized->requestID = getUint32(serialized, &offset);
   deserialized->recipientID = getUint32(serialized, &offset);
   deserialized->timestamp = getUint64(serialized, &offset);
   deserialized->digitalSig = getUint64(serialized, &offset);
@@ -52,12 +60,25 @@ int deserializeServerLoginLodi(char *serialized, LodiServerMessage *deserialized
   size_t offset = 0;
   deserialized->messageType = getUint32(serialized, &offset);
   deserialized->userID = getUint32(serialized, &offset);
+  deserialized->requestID = getUint32(serialized, &offset);
   deserialized->recipientID= getUint32(serialized, &offset);
   memcpy(deserialized->message, serialized + offset, LODI_MESSAGE_LENGTH * sizeof(char));
 
   return MESSAGE_DESERIALIZER_SUCCESS;
 }
 
+void setLoginTicket(LodiServerMessage *response, const unsigned long expiry, const unsigned long mac) {
+  size_t offset = 0;
+  appendUint64(response->message, &offset, expiry);
+  appendUint64(response->message, &offset, mac);
+}
+
+void getLoginTicket(const LodiServerMessage *response, unsigned long *expiryOut, unsigned long *macOut) {
+  size_t offset = 0;
+  *expiryOut = getUint64(response->message, &offset);
+  *macOut = getUint64(response->message, &offset);
+}
+
 /*
  * Boilerplate DomainService constructor functions
  */
@@ -98,7 +119,8 @@ int initLodiServer(DomainServer **server) {
   const ServerConfig serverConfig = getServerConfig(LODI);
   const MessageSerializer outgoing = {
     LODI_SERVER_RESPONSE_SIZE,
-    .serializer = (int (*)(void *, char *)) serializeServerLoginLodi
+    .serializer = (int (*)(void *, char *)) serializeServerLoginLodi,
+    .userIDPatcher = patchServerLodiUserID
   };
   const MessageDeserializer incoming = {
     LODI_CLIENT_REQUEST_SIZE,
@@ -111,7 +133,10 @@ int initLodiServer(DomainServer **server) {
     .receiveTimeoutMs = 0,
     .outgoingSerializer = outgoing,
     .incomingDeserializer = incoming,
-    .connectionType = STREAM
+    .connectionType = STREAM,
+    .outputHighWatermark = DEFAULT_OUTPUT_HIGH_WATERMARK,
+    .slowConsumerPolicy = DROP_OLDEST,
+    .reusePort = true // every lodi_server worker listens on the same port
   };
 
   if (createServer(options, server) != DOMAIN_SUCCESS) {
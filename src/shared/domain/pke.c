@@ -20,18 +20,13 @@
  * @return ERROR, SUCCESS
  */
 int getPublicKey(DomainClient *client, const unsigned int userID, unsigned int *publicKey) {
-  const PClientToPKServer requestMessage = {
+  PClientToPKServer requestMessage = {
     .messageType = requestKey,
-    userID
+    .userID = userID
   };
 
-  if (client->send(client, (UserMessage *) &requestMessage) == DOMAIN_FAILURE) {
-    printf("Unable to get public key, aborting ...\n");
-    return ERROR;
-  }
-
   PKServerToLodiClient responseMessage;
-  if (client->receive(client, (UserMessage *) &responseMessage) == DOMAIN_FAILURE) {
+  if (client->request(client, (UserMessage *) &requestMessage, (UserMessage *) &responseMessage) == DOMAIN_FAILURE) {
     printf("[ERROR] Failed to receive public key, aborting ...\n");
     return ERROR;
   }
@@ -55,6 +50,7 @@ static int serializeClientPK(PClientToPKServer *toSerialize, char *serialized) {
   size_t offset = 0;
   appendUint32(serialized, &offset, toSerialize->messageType);
   appendUint32(serialized, &offset, toSerialize->userID);
+  appendUint32(serialized, &offset, toSerialize->requestID);
   appendUint32(serialized, &offset, toSerialize->publicKey);
 
   return MESSAGE_SERIALIZER_SUCCESS;
@@ -64,6 +60,7 @@ static int serializeServerPK(PKServerToLodiClient *toSerialize, char *serialized
   size_t offset = 0;
   appendUint32(serialized, &offset, toSerialize->messageType);
   appendUint32(serialized, &offset, toSerialize->userID);
+  appendUint32(serialized, &offset, toSerialize->requestID);
   appendUint32(serialized, &offset, toSerialize->publicKey);
 
   return MESSAGE_SERIALIZER_SUCCESS;
@@ -73,6 +70,7 @@ static int deserializeClientPK(char *serialized, PKServerToLodiClient *deseriali
   size_t offset = 0;
   deserialized->messageType = getUint32(serialized, &offset);
   deserialized->userID = getUint32(serialized, &offset);
+  deserialized->requestID = getUint32(serialized, &offset);
   deserialized->publicKey = getUint32(serialized, &offset);
 
   return MESSAGE_DESERIALIZER_SUCCESS;
@@ -82,6 +80,7 @@ static int deserializeServerPK(char *serialized, PKServerToLodiClient *deseriali
   size_t offset = 0;
   deserialized->messageType = getUint32(serialized, &offset);
   deserialized->userID = getUint32(serialized, &offset);
+  deserialized->requestID = getUint32(serialized, &offset);
   deserialized->publicKey = getUint32(serialized, &offset);
 
   return MESSAGE_DESERIALIZER_SUCCESS;
@@ -137,7 +136,9 @@ int initPKEServer(DomainServer **server) {
     .receiveTimeoutMs = 0,
     .outgoingSerializer = outgoing,
     .incomingDeserializer = incoming,
-    .connectionType = DATAGRAM
+    .connectionType = DATAGRAM,
+    // outlives the retransmits of a request made with the default timeout
+    .responseCacheTtlMs = 2 * DEFAULT_TIMEOUT_MS
   };
 
   if (createServer(options, server) != DOMAIN_SUCCESS) {
@@ -18,6 +18,7 @@ int serializeClientTFA(TFAClientOrLodiServerToTFAServer *toSerialize, char *seri
   size_t offset = 0;
   appendUint32(serialized, &offset, toSerialize->messageType);
   appendUint32(serialized, &offset, toSerialize->userID);
+  appendUint32(serialized, &offset, toSerialize->requestID);
   appendUint64(serialized, &offset, toSerialize->timestamp);
   appendUint64(serialized, &offset, toSerialize->digitalSig);
 
@@ -28,6 +29,7 @@ int serializeServerTFA(TFAServerToTFAClient *toSerialize, char *serialized) {
   size_t offset = 0;
   appendUint32(serialized, &offset, toSerialize->messageType);
   appendUint32(serialized, &offset, toSerialize->userID);
+  appendUint32(serialized, &offset, toSerialize->requestID);
 
   return MESSAGE_SERIALIZER_SUCCESS;
 }
@@ -36,6 +38,7 @@ int deserializeClientTFA(char *serialized, TFAClientOrLodiServerToTFAServer *des
   size_t offset = 0;
   deserialized->messageType = getUint32(serialized, &offset);
   deserialized->userID = getUint32(serialized, &offset);
+  deserialized->requestID = getUint32(serialized, &offset);
   deserialized->timestamp = getUint64(serialized, &offset);
   deserialized->digitalSig = getUint64(serialized, &offset);
 
@@ -46,6 +49,7 @@ int deserializeServerTFA(char *serialized, TFAServerToLodiServer *deserialized)
   size_t offset = 0;
   deserialized->messageType = getUint32(serialized, &offset);
   deserialized->userID = getUint32(serialized, &offset);
+  deserialized->requestID = getUint32(serialized, &offset);
 
   return MESSAGE_DESERIALIZER_SUCCESS;
 }
@@ -99,7 +103,9 @@ int initTFAServerDomain(DomainServer **server) {
     .receiveTimeoutMs = 0,
     .outgoingSerializer = outgoing,
     .incomingDeserializer = incoming,
-    .connectionType = DATAGRAM
+    .connectionType = DATAGRAM,
+    // a requestAuth is retransmitted for as long as its push could be waiting on approval
+    .responseCacheTtlMs = TFA_PUSH_TIMEOUT_MS
   };
 
   if (createServer(options, server) != DOMAIN_SUCCESS) {
@@ -0,0 +1,235 @@
+/**
+ * See timer_wheel.h
+ *
+ * Level 0 has one slot per millisecond, and each slot of level n spans a full rotation of level n - 1. A timer is filed
+ * on the finest level whose rotation reaches its deadline, and is moved down ("cascaded") when the wheel reaches the
+ * start of its slot, so it's touched at most once per level. Each level keeps a bitmap of its occupied slots, letting
+ * the wheel skip straight to the next slot that needs attention instead of stepping through empty milliseconds.
+ */
+
+#include "domain/timer_wheel.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "shared.h"
+
+#define LEVEL_BITS 6 // log2(TIMER_WHEEL_SLOTS)
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define HORIZON_MS (1ULL << (LEVEL_BITS * TIMER_WHEEL_LEVELS)) // how far ahead the top level reaches, about 4.6h
+
+typedef struct TimerWheelImpl {
+  TimerWheel base;
+  uint64_t currentMs; // every timer due at or before this has expired
+  uint64_t occupied[TIMER_WHEEL_LEVELS]; // bit i is set while slot i of the level holds timers
+  Timer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} TimerWheelImpl;
+
+/**
+ * Links a timer into the slot its deadline falls under.
+ *
+ * @param impl self-reference
+ * @param timer unscheduled timer with its deadline set
+ * @param earliestMs the timer expires no earlier than this, even if its deadline has passed
+ */
+static void fileTimer(TimerWheelImpl *impl, Timer *timer, const uint64_t earliestMs) {
+  uint64_t dueMs = timer->deadlineMs > earliestMs ? timer->deadlineMs : earliestMs;
+  if (dueMs - impl->currentMs >= HORIZON_MS) {
+    // parked in the furthest slot the wheel reaches, and filed again from there once it's cascaded
+    dueMs = impl->currentMs + HORIZON_MS - 1;
+  }
+  const uint64_t delta = dueMs - impl->currentMs;
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= 1ULL << (LEVEL_BITS * (level + 1))) {
+    level++;
+  }
+  const int index = (int) ((dueMs >> (LEVEL_BITS * level)) & SLOT_MASK);
+
+  Timer **slot = &impl->slots[level][index];
+  timer->slot = slot;
+  timer->previous = NULL;
+  timer->next = *slot;
+  if (*slot != NULL) {
+    (*slot)->previous = timer;
+  }
+  *slot = timer;
+  impl->occupied[level] |= 1ULL << index;
+  impl->base.length++;
+}
+
+/**
+ * Unlinks a timer from its slot.
+ *
+ * @param impl self-reference
+ * @param timer scheduled timer
+ */
+static void unfileTimer(TimerWheelImpl *impl, Timer *timer) {
+  if (timer->previous != NULL) {
+    timer->previous->next = timer->next;
+  } else {
+    *timer->slot = timer->next;
+  }
+  if (timer->next != NULL) {
+    timer->next->previous = timer->previous;
+  }
+  if (*timer->slot == NULL) {
+    const long position = timer->slot - &impl->slots[0][0];
+    impl->occupied[position / TIMER_WHEEL_SLOTS] &= ~(1ULL << (position % TIMER_WHEEL_SLOTS));
+  }
+  timer->slot = NULL;
+  timer->previous = NULL;
+  timer->next = NULL;
+  impl->base.length--;
+}
+
+/**
+ * Finds the next millisecond at which the wheel has work to do: either a level 0 slot expires, or a slot on a higher
+ * level is cascaded.
+ *
+ * @param impl self-reference
+ * @return the millisecond, or UINT64_MAX if no timers are scheduled
+ */
+static uint64_t nextEventMs(const TimerWheelImpl *impl) {
+  uint64_t nextMs = UINT64_MAX;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    const uint64_t occupied = impl->occupied[level];
+    if (occupied == 0) {
+      continue;
+    }
+    const int shift = LEVEL_BITS * level;
+    const uint64_t span = impl->currentMs >> shift;
+    // rotate so the slot after the current one is bit 0 - slots up to the current one are a rotation ahead
+    const int start = (int) ((span + 1) & SLOT_MASK);
+    const uint64_t rotated = start == 0 ? occupied : occupied >> start | occupied << (TIMER_WHEEL_SLOTS - start);
+    const uint64_t slotMs = (span + 1 + __builtin_ctzll(rotated)) << shift;
+    if (slotMs < nextMs) {
+      nextMs = slotMs;
+    }
+  }
+  return nextMs;
+}
+
+/**
+ * Moves the timers filed under the slots starting at the current millisecond down a level. A level's slots only start
+ * when the level below wraps around, so higher levels are only checked while the level below is at slot 0.
+ *
+ * @param impl self-reference, at the start of a level 1 slot
+ */
+static void cascade(TimerWheelImpl *impl) {
+  for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+    const int index = (int) ((impl->currentMs >> (LEVEL_BITS * level)) & SLOT_MASK);
+    Timer *timer = impl->slots[level][index];
+    impl->slots[level][index] = NULL;
+    impl->occupied[level] &= ~(1ULL << index);
+    while (timer != NULL) {
+      Timer *next = timer->next;
+      impl->base.length--;
+      fileTimer(impl, timer, impl->currentMs);
+      timer = next;
+    }
+    if (index != 0) {
+      return;
+    }
+  }
+}
+
+/**
+ * @see TimerWheel#schedule
+ */
+static void scheduleTimer(TimerWheel *self, Timer *timer, const uint64_t deadlineMs, const TimerHandler onExpired,
+                          void *context) {
+  TimerWheelImpl *impl = (TimerWheelImpl *) self;
+  if (timer->slot != NULL) {
+    unfileTimer(impl, timer);
+  }
+  timer->deadlineMs = deadlineMs;
+  timer->onExpired = onExpired;
+  timer->context = context;
+  // the current millisecond's slot has already expired
+  fileTimer(impl, timer, impl->currentMs + 1);
+}
+
+/**
+ * @see TimerWheel#cancel
+ */
+static void cancelTimer(TimerWheel *self, Timer *timer) {
+  if (timer->slot != NULL) {
+    unfileTimer((TimerWheelImpl *) self, timer);
+  }
+}
+
+/**
+ * @see TimerWheel#advance
+ */
+static int advanceWheel(TimerWheel *self, const uint64_t nowMs) {
+  TimerWheelImpl *impl = (TimerWheelImpl *) self;
+  int expiredCount = 0;
+  uint64_t eventMs;
+  while ((eventMs = nextEventMs(impl)) <= nowMs) {
+    impl->currentMs = eventMs;
+    if ((eventMs & SLOT_MASK) == 0) {
+      cascade(impl);
+    }
+    // handlers can't file anything under the current slot, so it's emptied for good
+    Timer **slot = &impl->slots[0][eventMs & SLOT_MASK];
+    while (*slot != NULL) {
+      Timer *timer = *slot;
+      unfileTimer(impl, timer);
+      timer->onExpired(self, timer, timer->context);
+      expiredCount++;
+    }
+  }
+  if (nowMs > impl->currentMs) {
+    impl->currentMs = nowMs;
+  }
+  return expiredCount;
+}
+
+/**
+ * @see TimerWheel#nextTimeoutMs
+ */
+static int nextTimeoutMs(TimerWheel *self, const uint64_t nowMs) {
+  const uint64_t eventMs = nextEventMs((TimerWheelImpl *) self);
+  if (eventMs == UINT64_MAX) {
+    return -1;
+  }
+  if (eventMs <= nowMs) {
+    return 0;
+  }
+  return eventMs - nowMs < INT_MAX ? (int) (eventMs - nowMs) : INT_MAX;
+}
+
+/**
+ * @see TimerWheel#destroy
+ */
+static void destroyWheel(TimerWheel **self) {
+  if (*self != NULL) {
+    free(*self);
+    *self = NULL;
+  }
+}
+
+int createTimerWheel(const uint64_t nowMs, TimerWheel **wheel) {
+  if (!wheel) return ERROR;
+
+  TimerWheelImpl *impl = calloc(1, sizeof(TimerWheelImpl));
+  if (!impl) return ERROR;
+
+  impl->currentMs = nowMs;
+  impl->base.length = 0;
+  impl->base.schedule = scheduleTimer;
+  impl->base.cancel = cancelTimer;
+  impl->base.advance = advanceWheel;
+  impl->base.nextTimeoutMs = nextTimeoutMs;
+  impl->base.destroy = destroyWheel;
+
+  *wheel = (TimerWheel *) impl;
+  return SUCCESS;
+}
+
+uint64_t monotonicMs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "shared.h"
 #include "util/network.h"
@@ -16,11 +17,14 @@
 /**
  * Gets a socket
  *
- * @param address
- * @param timeout
- * @return
+ * @param address optional local address to bind to
+ * @param timeout optional receive timeout
+ * @param connectionType STREAM or DATAGRAM
+ * @param reusePort allow several sockets to bind the same address and port, with the kernel balancing between them
+ * @return the socket, or ERROR
  */
-int getSocket(const struct sockaddr_in *address, const struct timeval *timeout, enum ConnectionType connectionType) {
+int getSocket(const struct sockaddr_in *address, const struct timeval *timeout, enum ConnectionType connectionType,
+              const bool reusePort) {
   const enum __socket_type sockType = connectionType == DATAGRAM ? SOCK_DGRAM : SOCK_STREAM;
   const int protocol = connectionType == DATAGRAM ? IPPROTO_UDP : IPPROTO_TCP;
 
@@ -35,6 +39,15 @@ int getSocket(const struct sockaddr_in *address, const struct timeval *timeout,
     setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
   }
 
+  if (reusePort) {
+    const int opt = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+      perror("[ERROR] Unable to set SO_REUSEPORT");
+      close(sock);
+      return ERROR;
+    }
+  }
+
   if (timeout) {
     const int optResult = setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, timeout, sizeof(*timeout));
     if (optResult < 0) {
@@ -103,19 +116,52 @@ int receiveUdpMessage(const int socket, char *message, const size_t messageSize,
   return SUCCESS;
 }
 
+/**
+ * Receives a single datagram only if one is already waiting, without blocking.
+ *
+ * @param socket datagram socket
+ * @param message caller-allocated destination, messageSize bytes
+ * @param messageSize expected size of the datagram
+ * @param clientAddress output, sender of the datagram
+ * @return SUCCESS, WOULD_BLOCK if no datagram is waiting, or ERROR if one was consumed but couldn't be received whole
+ */
+int receiveUdpAvailable(const int socket, char *message, const size_t messageSize,
+                        struct sockaddr_in *clientAddress) {
+  socklen_t clientAddrLen = sizeof(*clientAddress);
+  ssize_t numBytes;
+  do {
+    numBytes = recvfrom(socket, message, messageSize, MSG_DONTWAIT, (struct sockaddr *) clientAddress,
+                        &clientAddrLen);
+  } while (numBytes < 0 && errno == EINTR);
+
+  if (numBytes < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return WOULD_BLOCK;
+    }
+    perror("[ERROR] recvfrom() failed");
+    return ERROR;
+  }
+  if (numBytes != (ssize_t) messageSize) {
+    printf("[ERROR] Received unexpected number of bytes: received %zd, expected %zd. Discarding.\n", numBytes,
+           messageSize);
+    return ERROR;
+  }
+  return SUCCESS;
+}
+
 /**
  * Sends a message on a given socket
  *
  * @param socket
  * @param messageBuffer
  * @param messageSize
- * @param destinationAddress
+ * @param destinationAddress NULL to send to the peer a connected socket is connected to
  * @return
  */
 int sendUdpMessage(const int socket, const char *messageBuffer, const size_t messageSize,
                    const struct sockaddr_in *destinationAddress) {
   const ssize_t numBytes = sendto(socket, messageBuffer, messageSize, 0, (struct sockaddr *) destinationAddress,
-                                  sizeof(*destinationAddress));
+                                  destinationAddress != NULL ? sizeof(*destinationAddress) : 0);
 
   if (numBytes < 0) {
     printf("[ERROR] sendTo() failed, %d\n", errno);
@@ -131,6 +177,67 @@ int sendUdpMessage(const int socket, const char *messageBuffer, const size_t mes
   return SUCCESS;
 }
 
+/**
+ * Receives up to messageCount datagrams with a single recvmmsg() call, blocking only until the first one arrives.
+ *
+ * @param socket
+ * @param messages caller-prepared headers, msg_len is set to each datagram's length
+ * @param messageCount
+ * @return number of datagrams received, or ERROR
+ */
+int receiveUdpBatch(const int socket, struct mmsghdr *messages, const unsigned int messageCount) {
+  const int received = recvmmsg(socket, messages, messageCount, MSG_WAITFORONE, NULL);
+  if (received < 0) {
+    perror("[ERROR] recvmmsg() failed");
+    return ERROR;
+  }
+  return received;
+}
+
+/**
+ * Sends datagrams with as few sendmmsg() calls as possible. A datagram the kernel rejects is skipped rather than
+ * holding back the ones after it.
+ *
+ * @param socket
+ * @param messages prepared headers, each with its destination in msg_name
+ * @param messageCount
+ * @return number of datagrams sent
+ */
+int sendUdpBatch(const int socket, struct mmsghdr *messages, const unsigned int messageCount) {
+  unsigned int offset = 0;
+  int sent = 0;
+  while (offset < messageCount) {
+    const int rv = sendmmsg(socket, messages + offset, messageCount - offset, 0);
+    if (rv < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("[ERROR] sendmmsg() failed");
+      offset++;
+      continue;
+    }
+    offset += rv;
+    sent += rv;
+  }
+  return sent;
+}
+
+/**
+ * Connects a datagram socket to a single peer. The kernel then discards datagrams from anyone else, and the socket
+ * learns of an unreachable peer through ECONNREFUSED.
+ *
+ * @param sock datagram socket
+ * @param serverAddress peer to connect to
+ * @return SUCCESS or ERROR
+ */
+int udpConnect(const int sock, const struct sockaddr_in *serverAddress) {
+  if (connect(sock, (struct sockaddr *) serverAddress, sizeof(struct sockaddr_in)) < 0) {
+    perror("[ERROR] Unable to connect datagram socket");
+    return ERROR;
+  }
+  return SUCCESS;
+}
+
 int tcpConnect(const int sock, const struct sockaddr_in *serverAddress) {
   if (connect(sock, (struct sockaddr *) serverAddress, sizeof(struct sockaddr_in)) < 0) {
     printf("[ERROR] Unable to connect to host\n");
@@ -149,10 +256,20 @@ int tcpListen(const int sock) {
   return SUCCESS;
 }
 
+/**
+ * Accepts a pending connection.
+ *
+ * @param sock listening socket
+ * @param clientAddress output, address of the accepted client
+ * @param clientSock output, socket of the accepted client
+ * @return SUCCESS, ERROR, or WOULD_BLOCK if the listening socket is non-blocking and no connection is pending
+ */
 int tcpAccept(const int sock, struct sockaddr_in *clientAddress, int *clientSock) {
   socklen_t clientLength = sizeof(struct sockaddr_in);
-  printf("[DEBUG] Attempting to accept...\n");
   if ((*clientSock = accept(sock, (struct sockaddr *) clientAddress, &clientLength)) < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return WOULD_BLOCK;
+    }
     perror("[ERROR] Failed to accept");
     return ERROR;
   }
@@ -160,34 +277,85 @@ int tcpAccept(const int sock, struct sockaddr_in *clientAddress, int *clientSock
   return SUCCESS;
 }
 
-int sendTcpMessage(const int socket, const char *messageBuffer, const size_t messageSize) {
-  const ssize_t numBytes = send(socket, messageBuffer, messageSize, 0);
-
-  if (numBytes < 0) {
-    perror("[ERROR] Stream send() failed");
+/**
+ * Switches a socket to non-blocking mode.
+ *
+ * @param sock socket to modify
+ * @return SUCCESS or ERROR
+ */
+int setNonBlocking(const int sock) {
+  const int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+    perror("[ERROR] Unable to make socket non-blocking");
     return ERROR;
   }
+  return SUCCESS;
+}
 
-  if (numBytes != (ssize_t) messageSize) {
-    perror("[ERROR] Stream send() sent a different number of bytes than expected");
-    return ERROR;
+int sendTcpMessage(const int socket, const char *messageBuffer, const size_t messageSize) {
+  size_t offset = 0;
+  while (offset < messageSize) {
+    const ssize_t numBytes = send(socket, messageBuffer + offset, messageSize - offset, MSG_NOSIGNAL);
+    if (numBytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("[ERROR] Stream send() failed");
+      return ERROR;
+    }
+    offset += numBytes;
   }
 
   return SUCCESS;
 }
 
+/**
+ * Writes as much of the supplied segments as a non-blocking socket will take in a single gathered write.
+ *
+ * @param socket non-blocking stream socket
+ * @param segments caller-owned source segments
+ * @param segmentCount number of segments
+ * @param sent output, number of bytes written - may be less than the total on a short write
+ * @return SUCCESS if bytes were written, WOULD_BLOCK if the socket buffer is full, TERMINATED if the peer has gone
+ *         away, or ERROR
+ */
+int sendTcpAvailable(const int socket, const struct iovec *segments, const int segmentCount, size_t *sent) {
+  *sent = 0;
+  struct msghdr header = {
+    .msg_iov = (struct iovec *) segments,
+    .msg_iovlen = segmentCount
+  };
+  ssize_t numBytes;
+  do {
+    // sendmsg() rather than writev() so a vanished peer doesn't raise SIGPIPE
+    numBytes = sendmsg(socket, &header, MSG_NOSIGNAL);
+  } while (numBytes < 0 && errno == EINTR);
+
+  if (numBytes < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return WOULD_BLOCK;
+    }
+    if (errno == EPIPE || errno == ECONNRESET) {
+      return TERMINATED;
+    }
+    perror("[ERROR] Stream sendmsg() failed");
+    return ERROR;
+  }
+  *sent = (size_t) numBytes;
+  return SUCCESS;
+}
+
 int receiveTcpMessage(const int socket, char *message, const size_t messageSize) {
-  char *tempBuffer = malloc(messageSize);
   size_t offset = 0;
-  ssize_t numBytes = recv(socket, tempBuffer, messageSize, 0);
+  ssize_t numBytes = recv(socket, message, messageSize, 0);
 
   while (numBytes > 0) {
-    memcpy(message + offset, tempBuffer, numBytes);
     offset += numBytes;
     if (offset == messageSize) {
       break;
     }
-    numBytes = recv(socket, tempBuffer, messageSize, 0);
+    // only ask for the remainder, so a following message is never pulled in
+    numBytes = recv(socket, message + offset, messageSize - offset, 0);
   }
 
   int ret = SUCCESS;
@@ -201,6 +369,55 @@ int receiveTcpMessage(const int socket, char *message, const size_t messageSize)
   } else if (numBytes == 0) {
     ret = TERMINATED;
   }
-  free(tempBuffer);
   return ret;
 }
+
+/**
+ * Reads whatever is immediately available on a non-blocking socket, scattering it across the supplied segments.
+ *
+ * @param socket non-blocking stream socket
+ * @param segments caller-owned destination segments
+ * @param segmentCount number of segments
+ * @param received output, number of bytes read
+ * @return SUCCESS if bytes were read, WOULD_BLOCK if none are available, TERMINATED if the peer closed the connection,
+ *         or ERROR
+ */
+int receiveTcpAvailable(const int socket, const struct iovec *segments, const int segmentCount, size_t *received) {
+  *received = 0;
+  ssize_t numBytes;
+  do {
+    numBytes = readv(socket, segments, segmentCount);
+  } while (numBytes < 0 && errno == EINTR);
+
+  if (numBytes < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return WOULD_BLOCK;
+    }
+    if (errno == ECONNRESET) {
+      return TERMINATED;
+    }
+    perror("[ERROR] Stream readv() failed");
+    return ERROR;
+  }
+  if (numBytes == 0) {
+    return TERMINATED;
+  }
+  *received = (size_t) numBytes;
+  return SUCCESS;
+}
+
+/**
+ * Checks whether the peer of a connected stream socket has closed the connection, without blocking and without
+ * consuming any data.
+ *
+ * @param socket connected stream socket
+ * @return true if the peer has closed or reset the connection
+ */
+bool isTcpPeerClosed(const int socket) {
+  char byte;
+  ssize_t numBytes;
+  do {
+    numBytes = recv(socket, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+  } while (numBytes < 0 && errno == EINTR);
+  return numBytes == 0 || (numBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
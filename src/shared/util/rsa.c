@@ -4,6 +4,10 @@
 
 #include "util/rsa.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 /**
  * Adapted from https://en.wikipedia.org/wiki/Euclidean_algorithm
  * Calculates the GCD between two longs
@@ -73,15 +77,83 @@ KeyGenResult generateKeys(const unsigned int p, const unsigned int q) {
     KeyGenResult result = {
         .private = d,
         .public = e,
-        .modulus = n
+        .modulus = n,
+        .crt = toCrtPrivateKey(d, p, q)
     };
     return result;
 }
 
+CrtPrivateKey toCrtPrivateKey(const unsigned long privateKey, const unsigned int p, const unsigned int q) {
+    const CrtPrivateKey key = {
+        .p = p,
+        .q = q,
+        .dP = privateKey % (p - 1),
+        .dQ = privateKey % (q - 1),
+        .qInv = modInverse(q, p)
+    };
+    return key;
+}
+
+#define INTERLEAVED_LANES 4
+#define CRT_MODULUS_BITS 30 // leaves room for the lazy reduction in montgomeryMultiply32
+#define IFMA_LANES 8
+#define IFMA_VECTORS 4
+#define IFMA_MIN_BATCH 4 // smaller batches are quicker to interleave than to load into vectors
+#define IFMA_MODULUS_BITS 51 // the reduced product, below 2 * modulus, must fit IFMA's 52 bits
+
+/**
+ * Precomputed constants for Montgomery multiplication modulo an odd modulus, with R = 2^64. In Montgomery form a
+ * product is reduced with two multiplications and a shift, instead of a 128-bit division.
+ */
+typedef struct {
+    unsigned long modulus;
+    unsigned long negatedInverse; // -modulus^-1 mod R
+    unsigned long rSquared; // R^2 mod modulus, used to convert into Montgomery form
+    unsigned long chainExponent; // last exponent of the form 2^k + 1 raised to
+    unsigned long chainCorrection; // R^chainExponent mod modulus
+    unsigned long negatedInverse52; // the same constants for R = 2^52, used by verifyIfma
+    unsigned long rSquared52;
+    unsigned long one52;
+} MontgomeryContext;
+
+/**
+ * Precomputed constants for Montgomery multiplication modulo each of a CRT key's primes, with R = 2^32.
+ */
+typedef struct {
+    unsigned long moduli[2]; // p, q
+    unsigned int negatedInverse[2]; // -prime^-1 mod R
+    unsigned long one[2]; // R mod prime
+    unsigned long rSquared[2]; // R^2 mod prime
+    unsigned long rCubed[2]; // R^3 mod prime, converts a value already multiplied by R^-1 into Montgomery form
+} CrtContext;
+
+// every caller uses MODULUS, so each thread computes its contexts once
+static __thread MontgomeryContext montgomery;
+static __thread CrtContext crt;
+
+static MontgomeryContext *getMontgomeryContext(unsigned long modulus);
+
+static unsigned long modPowChain(unsigned long base, unsigned long exponent, MontgomeryContext *context);
+
+static unsigned long montgomeryMultiply(unsigned long a, unsigned long b, const MontgomeryContext *context);
+
+static void verifyInterleaved(const SignatureCheck *checks, int count, unsigned long modulus, bool *validOut);
+
+static const CrtContext *getCrtContext(const CrtPrivateKey *key);
+
+static inline unsigned long montgomeryMultiply32(unsigned long a, unsigned long b, const CrtContext *context, int i);
+
+#if defined(__x86_64__)
+static void verifyIfma(const SignatureCheck *checks, int count, unsigned long modulus, bool *validOut);
+#endif
+
 /**
  * Based on https://en.wikipedia.org/wiki/Modular_exponentiation
  * Takes the modules of the base exponentiation by the exponent.
  *
+ * Works in Montgomery form for any odd modulus below 2^63, which covers every modulus generateKeys produces.
+ * Exponents of the form 2^k + 1, like the small public exponents generateKeys picks, take the shortcut in modPowChain.
+ *
  * @param base
  * @param exponent
  * @param modulus
@@ -91,6 +163,37 @@ unsigned long modPow(unsigned long base, unsigned long exponent, unsigned long m
     if (modulus == 1) {
         return 0;
     }
+    if (modulus % 2 == 0 || modulus >> 63 != 0) {
+        return modPowByDivision(base, exponent, modulus);
+    }
+    if (exponent == 0) {
+        return 1;
+    }
+
+    MontgomeryContext *context = getMontgomeryContext(modulus);
+    if (base >= modulus) {
+        base %= modulus; // signatures and timestamps are already reduced, so this division is usually skipped
+    }
+    if (exponent > 1 && ((exponent - 1) & (exponent - 2)) == 0) {
+        return modPowChain(base, exponent, context);
+    }
+
+    const unsigned long x = montgomeryMultiply(base, context->rSquared, context);
+    unsigned long result = x;
+    // left-to-right, starting below the most significant bit
+    for (int bit = 62 - __builtin_clzl(exponent); bit >= 0; bit--) {
+        result = montgomeryMultiply(result, result, context);
+        if ((exponent >> bit) & 1) {
+            result = montgomeryMultiply(result, x, context);
+        }
+    }
+    return montgomeryMultiply(result, 1, context);
+}
+
+unsigned long modPowByDivision(unsigned long base, unsigned long exponent, unsigned long modulus) {
+    if (modulus == 1) {
+        return 0;
+    }
 
     unsigned long result = 1;
     base = base % modulus;
@@ -104,6 +207,70 @@ unsigned long modPow(unsigned long base, unsigned long exponent, unsigned long m
     return result;
 }
 
+/**
+ * @param modulus odd modulus below 2^63
+ * @return the calling thread's context for the modulus, computed if it was last used with a different one
+ */
+static MontgomeryContext *getMontgomeryContext(const unsigned long modulus) {
+    if (montgomery.modulus != modulus) {
+        // Newton's iteration, each step doubles the number of correct low bits of the inverse: 3, 6, 12, 24, 48, 96
+        unsigned long inverse = modulus;
+        for (int i = 0; i < 5; i++) {
+            inverse *= 2 - modulus * inverse;
+        }
+        const unsigned long r = -modulus % modulus; // 2^64 mod modulus
+        montgomery.negatedInverse = -inverse;
+        montgomery.rSquared = (__uint128_t) r * r % modulus;
+        const unsigned long r52 = (1UL << 52) % modulus;
+        montgomery.negatedInverse52 = -inverse & ((1UL << 52) - 1);
+        montgomery.rSquared52 = (__uint128_t) r52 * r52 % modulus;
+        montgomery.one52 = r52;
+        montgomery.chainExponent = 0;
+        montgomery.modulus = modulus;
+    }
+    return &montgomery;
+}
+
+/**
+ * Raises to an exponent of the form 2^k + 1 without converting in and out of Montgomery form: k squarings and a
+ * multiplication of the plain base leave base^exponent * R^-(exponent - 1), which a single multiplication by the
+ * precomputed R^exponent corrects. For the public exponent 17 that's 6 reductions, where the generic path takes 7.
+ *
+ * @param base base, reduced modulo the context's modulus
+ * @param exponent 2^k + 1, for k >= 0
+ * @param context context of the modulus
+ * @return base^exponent mod modulus
+ */
+static unsigned long modPowChain(const unsigned long base, const unsigned long exponent, MontgomeryContext *context) {
+    if (context->chainExponent != exponent) {
+        context->chainCorrection = modPowByDivision(-context->modulus % context->modulus, exponent, context->modulus);
+        context->chainExponent = exponent;
+    }
+    unsigned long result = base;
+    for (int squarings = __builtin_ctzl(exponent - 1); squarings > 0; squarings--) {
+        result = montgomeryMultiply(result, result, context);
+    }
+    result = montgomeryMultiply(result, base, context);
+    return montgomeryMultiply(result, context->chainCorrection, context);
+}
+
+/**
+ * Montgomery reduction (REDC) of a * b.
+ *
+ * @param a multiplicand in Montgomery form
+ * @param b multiplier in Montgomery form
+ * @param context context of the modulus
+ * @return a * b * R^-1 mod modulus
+ */
+static unsigned long montgomeryMultiply(const unsigned long a, const unsigned long b,
+                                        const MontgomeryContext *context) {
+    const __uint128_t product = (__uint128_t) a * b;
+    const unsigned long m = (unsigned long) product * context->negatedInverse;
+    // can't overflow, as product < modulus^2 < 2^126 and m * modulus < 2^127
+    const unsigned long reduced = (product + (__uint128_t) m * context->modulus) >> 64;
+    return reduced >= context->modulus ? reduced - context->modulus : reduced;
+}
+
 /**
  * Encrypts a timestamp with a private key and modulus
  * @param timestamp
@@ -115,6 +282,91 @@ unsigned long encryptTimestamp(unsigned long timestamp, unsigned long privateKey
     return modPow(timestamp, privateKey, modulus);
 }
 
+/**
+ * Signs modulo p and q, then recombines the halves with Garner's formula: m = mQ + q * (qInv * (mP - mQ) mod p).
+ */
+unsigned long encryptTimestampCrt(const unsigned long timestamp, const CrtPrivateKey *key) {
+    if (key->p >> CRT_MODULUS_BITS != 0 || key->q >> CRT_MODULUS_BITS != 0 || key->p % 2 == 0 || key->q % 2 == 0) {
+        const unsigned long mP = modPow(timestamp, key->dP, key->p);
+        const unsigned long mQ = modPow(timestamp, key->dQ, key->q);
+        const unsigned long h = (__uint128_t) key->qInv * ((mP + key->p - mQ % key->p) % key->p) % key->p;
+        return mQ + h * key->q;
+    }
+
+    const CrtContext *context = getCrtContext(key);
+    const unsigned long exponents[2] = {key->dP, key->dQ};
+    const int topBit = 63 - __builtin_clzl(exponents[0] | exponents[1] | 1);
+    unsigned long x[2];
+    unsigned long result[2];
+    for (int i = 0; i < 2; i++) {
+        // timestamp < p * q < 2^32 * modulus, so it's reduced into Montgomery form without a division
+        x[i] = montgomeryMultiply32(montgomeryMultiply32(timestamp, 1, context, i), context->rCubed[i], context, i);
+        // an exponent shorter than the other squares 1 until its own bits start
+        result[i] = (exponents[i] >> topBit) & 1 ? x[i] : context->one[i];
+    }
+    for (int bit = topBit - 1; bit >= 0; bit--) {
+        // the two halves run in lockstep, so each hides the other's latency
+        for (int i = 0; i < 2; i++) {
+            result[i] = montgomeryMultiply32(result[i], result[i], context, i);
+            if ((exponents[i] >> bit) & 1) {
+                result[i] = montgomeryMultiply32(result[i], x[i], context, i);
+            }
+        }
+    }
+
+    // mP * R - mQ * R, then the multiplication by qInv takes it back out of Montgomery form
+    const unsigned long p = key->p;
+    unsigned long mQ = montgomeryMultiply32(result[1], 1, context, 1);
+    mQ = mQ >= key->q ? mQ - key->q : mQ;
+    const unsigned long mPR = result[0] >= p ? result[0] - p : result[0];
+    unsigned long mQR = montgomeryMultiply32(mQ, context->rSquared[0], context, 0);
+    mQR = mQR >= p ? mQR - p : mQR;
+    unsigned long h = montgomeryMultiply32(mPR >= mQR ? mPR - mQR : mPR + p - mQR, key->qInv, context, 0);
+    h = h >= p ? h - p : h;
+    return mQ + h * key->q;
+}
+
+/**
+ * @param key CRT key whose primes are odd and below 2^CRT_MODULUS_BITS
+ * @return the calling thread's context for the key's primes, computed if it was last used with different ones
+ */
+static const CrtContext *getCrtContext(const CrtPrivateKey *key) {
+    if (crt.moduli[0] != key->p || crt.moduli[1] != key->q) {
+        const unsigned long moduli[2] = {key->p, key->q};
+        for (int i = 0; i < 2; i++) {
+            // Newton's iteration as in getMontgomeryContext: 3, 6, 12, 24, 48 correct bits
+            unsigned int inverse = moduli[i];
+            for (int step = 0; step < 4; step++) {
+                inverse *= 2 - moduli[i] * inverse;
+            }
+            crt.negatedInverse[i] = -inverse;
+            crt.one[i] = (1UL << 32) % moduli[i];
+            crt.rSquared[i] = -moduli[i] % moduli[i]; // 2^64 mod modulus
+            crt.rCubed[i] = crt.rSquared[i] * crt.one[i] % moduli[i];
+            crt.moduli[i] = moduli[i];
+        }
+    }
+    return &crt;
+}
+
+/**
+ * Montgomery multiplication with R = 2^32, modulo one of a CrtContext's primes. Both primes are below 2^30, so
+ * operands below twice the prime give a result below twice the prime, and the final subtraction is left to the caller.
+ *
+ * @param a multiplicand in Montgomery form, below twice the prime
+ * @param b multiplier in Montgomery form, below twice the prime
+ * @param context context of the primes
+ * @param i 0 for p, 1 for q
+ * @return a * b * R^-1 mod the prime, plus the prime at most once
+ */
+static inline unsigned long montgomeryMultiply32(const unsigned long a, const unsigned long b,
+                                                 const CrtContext *context, const int i) {
+    const unsigned long product = a * b;
+    const unsigned int m = (unsigned int) product * context->negatedInverse[i];
+    // can't overflow, as product < 4 * prime^2 < 2^62 and m * prime < 2^62
+    return (product + (unsigned long) m * context->moduli[i]) >> 32;
+}
+
 /**
  * Decrypts a timestamp with a public key and moduls
  * @param encrypted
@@ -125,3 +377,152 @@ unsigned long encryptTimestamp(unsigned long timestamp, unsigned long privateKey
 unsigned long decryptTimestamp(unsigned long encrypted, unsigned long publicKey, unsigned long modulus) {
     return modPow(encrypted, publicKey, modulus);
 }
+
+int verifySignatures(const SignatureCheck *checks, const int count, const unsigned long modulus, bool *validOut) {
+    if (modulus % 2 == 0 || modulus >> 63 != 0) {
+        for (int i = 0; i < count; i++) {
+            validOut[i] = modPowByDivision(checks[i].digitalSig, checks[i].publicKey, modulus) == checks[i].timestamp;
+        }
+    }
+#if defined(__x86_64__)
+    else if (count >= IFMA_MIN_BATCH && modulus >> IFMA_MODULUS_BITS == 0 && __builtin_cpu_supports("avx512ifma")) {
+        verifyIfma(checks, count, modulus, validOut);
+    }
+#endif
+    else {
+        verifyInterleaved(checks, count, modulus, validOut);
+    }
+
+    int validCount = 0;
+    for (int i = 0; i < count; i++) {
+        validCount += validOut[i];
+    }
+    return validCount;
+}
+
+/**
+ * Verifies signatures INTERLEAVED_LANES at a time. A Montgomery multiplication's steps each wait on the one before,
+ * so running several exponentiations in lockstep keeps the multiplier busy while each of them waits.
+ */
+static void verifyInterleaved(const SignatureCheck *checks, const int count, const unsigned long modulus,
+                              bool *validOut) {
+    const MontgomeryContext *context = getMontgomeryContext(modulus);
+    const unsigned long one = montgomeryMultiply(1, context->rSquared, context);
+
+    for (int start = 0; start < count; start += INTERLEAVED_LANES) {
+        const int laneCount = count - start < INTERLEAVED_LANES ? count - start : INTERLEAVED_LANES;
+        unsigned long x[INTERLEAVED_LANES];
+        unsigned long result[INTERLEAVED_LANES];
+        unsigned long exponentBits = 0;
+        for (int lane = 0; lane < laneCount; lane++) {
+            const unsigned long base = checks[start + lane].digitalSig;
+            x[lane] = montgomeryMultiply(base < modulus ? base : base % modulus, context->rSquared, context);
+            result[lane] = one;
+            exponentBits |= checks[start + lane].publicKey;
+        }
+        // every lane runs through the longest exponent's bits, shorter ones square 1 until their own bits start
+        for (int bit = 63 - __builtin_clzl(exponentBits | 1); bit >= 0; bit--) {
+            for (int lane = 0; lane < laneCount; lane++) {
+                result[lane] = montgomeryMultiply(result[lane], result[lane], context);
+                if ((checks[start + lane].publicKey >> bit) & 1) {
+                    result[lane] = montgomeryMultiply(result[lane], x[lane], context);
+                }
+            }
+        }
+        for (int lane = 0; lane < laneCount; lane++) {
+            validOut[start + lane] = montgomeryMultiply(result[lane], 1, context) == checks[start + lane].timestamp;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+#define IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+
+/**
+ * Montgomery multiplication in each of 8 lanes, with R = 2^52 so a product's halves come from a single IFMA
+ * instruction each.
+ *
+ * @param a multiplicands in Montgomery form
+ * @param b multipliers in Montgomery form
+ * @param modulus modulus in every lane, below 2^IFMA_MODULUS_BITS
+ * @param negatedInverse -modulus^-1 mod 2^52 in every lane
+ * @return a * b * R^-1 mod modulus in each lane
+ */
+IFMA_TARGET static inline __m512i montgomeryMultiply52(const __m512i a, const __m512i b, const __m512i modulus,
+                                                       const __m512i negatedInverse) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i low = _mm512_madd52lo_epu64(zero, a, b);
+    __m512i high = _mm512_madd52hi_epu64(zero, a, b);
+    const __m512i m = _mm512_madd52lo_epu64(zero, low, negatedInverse);
+    // low + the low half of m * modulus is either 0 or exactly 2^52, carrying into the high half
+    const __m512i carry = _mm512_srli_epi64(_mm512_madd52lo_epu64(low, m, modulus), 52);
+    high = _mm512_add_epi64(_mm512_madd52hi_epu64(high, m, modulus), carry);
+    // high < 2 * modulus - where high < modulus the subtraction wraps, and the minimum keeps high
+    return _mm512_min_epu64(high, _mm512_sub_epi64(high, modulus));
+}
+
+/**
+ * Verifies signatures IFMA_LANES * IFMA_VECTORS at a time, one per 64-bit lane. Like verifyInterleaved, several
+ * vectors run in lockstep so each multiplication's latency is hidden behind the others'.
+ */
+IFMA_TARGET static void verifyIfma(const SignatureCheck *checks, const int count, const unsigned long modulus,
+                                   bool *validOut) {
+    const MontgomeryContext *context = getMontgomeryContext(modulus);
+    const __m512i modulusLanes = _mm512_set1_epi64((long) modulus);
+    const __m512i inverseLanes = _mm512_set1_epi64((long) context->negatedInverse52);
+    const __m512i rSquared = _mm512_set1_epi64((long) context->rSquared52);
+    const __m512i one = _mm512_set1_epi64((long) context->one52);
+    const __m512i plainOne = _mm512_set1_epi64(1);
+    const int groupSize = IFMA_LANES * IFMA_VECTORS;
+
+    for (int start = 0; start < count; start += groupSize) {
+        const int laneCount = count - start < groupSize ? count - start : groupSize;
+        unsigned long bases[IFMA_LANES * IFMA_VECTORS] = {0};
+        unsigned long exponents[IFMA_LANES * IFMA_VECTORS] = {0};
+        unsigned long timestamps[IFMA_LANES * IFMA_VECTORS] = {0};
+        unsigned long exponentBits = 0;
+        for (int lane = 0; lane < laneCount; lane++) {
+            const SignatureCheck *check = &checks[start + lane];
+            bases[lane] = check->digitalSig < modulus ? check->digitalSig : check->digitalSig % modulus;
+            exponents[lane] = check->publicKey;
+            timestamps[lane] = check->timestamp;
+            exponentBits |= check->publicKey;
+        }
+
+        const int vectorCount = (laneCount + IFMA_LANES - 1) / IFMA_LANES;
+        const int topBit = 63 - __builtin_clzl(exponentBits | 1);
+        const __m512i topBitLanes = _mm512_set1_epi64((long) (1UL << topBit));
+        __m512i exponentLanes[IFMA_VECTORS];
+        __m512i x[IFMA_VECTORS];
+        __m512i result[IFMA_VECTORS];
+        for (int v = 0; v < vectorCount; v++) {
+            exponentLanes[v] = _mm512_loadu_si512(&exponents[v * IFMA_LANES]);
+            x[v] = montgomeryMultiply52(_mm512_loadu_si512(&bases[v * IFMA_LANES]), rSquared, modulusLanes,
+                                        inverseLanes);
+            // lanes whose exponent has the top bit start from the base, the others from 1
+            result[v] = _mm512_mask_mov_epi64(one, _mm512_test_epi64_mask(exponentLanes[v], topBitLanes), x[v]);
+        }
+        for (int bit = topBit - 1; bit >= 0; bit--) {
+            const __m512i bitLanes = _mm512_set1_epi64((long) (1UL << bit));
+            for (int v = 0; v < vectorCount; v++) {
+                result[v] = montgomeryMultiply52(result[v], result[v], modulusLanes, inverseLanes);
+            }
+            for (int v = 0; v < vectorCount; v++) {
+                const __mmask8 isSet = _mm512_test_epi64_mask(exponentLanes[v], bitLanes);
+                if (isSet != 0) {
+                    result[v] = _mm512_mask_mov_epi64(result[v], isSet,
+                                                      montgomeryMultiply52(result[v], x[v], modulusLanes,
+                                                                           inverseLanes));
+                }
+            }
+        }
+        for (int v = 0; v < vectorCount; v++) {
+            result[v] = montgomeryMultiply52(result[v], plainOne, modulusLanes, inverseLanes);
+            const __mmask8 isValid = _mm512_cmpeq_epu64_mask(result[v], _mm512_loadu_si512(&timestamps[v * IFMA_LANES]));
+            for (int lane = v * IFMA_LANES; lane < laneCount && lane < (v + 1) * IFMA_LANES; lane++) {
+                validOut[start + lane] = (isValid >> (lane - v * IFMA_LANES)) & 1;
+            }
+        }
+    }
+}
+#endif
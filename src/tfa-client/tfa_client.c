@@ -41,7 +41,9 @@ int main() {
     unsigned long privateKey = getLongInput("private key");
     unsigned long timestamp;
     time(&timestamp);
-    unsigned long digitalSignature = encryptTimestamp(timestamp, privateKey, MODULUS);
+    // MODULUS's factors are known, so the CRT form of the key is always available
+    const CrtPrivateKey crtKey = toCrtPrivateKey(privateKey, P, Q);
+    unsigned long digitalSignature = encryptTimestampCrt(timestamp, &crtKey);
 
     int registerStatus = registerTFAClient(userID, timestamp, digitalSignature);
     if (registerStatus == ERROR) {
@@ -68,6 +70,7 @@ void handleTFAPush() {
 
         if (pushRequest.messageType != pushTFA) {
             printf("Received non pushTFA messaging... discarding and continuing...\n");
+            continue;
         }
 
         printf("Received pushTFA message\n");
@@ -106,18 +109,12 @@ int registerTFAClient(const unsigned int userID, unsigned long timestamp, unsign
         .digitalSig = digitalSignature
     };
 
-    int sendStatus = tfaClient->send(tfaClient, (UserMessage *) &requestMessage);
-
-    if (sendStatus == DOMAIN_FAILURE) {
-        printf("Failed to send registration, aborting registration...\n");
-        return ERROR;
-    }
-    printf(" Sent registerTFA message with timestamp=%lu, digitalSignature=%lu\n",
+    printf(" Sending registerTFA message with timestamp=%lu, digitalSignature=%lu\n",
            timestamp, digitalSignature);
 
     TFAServerToTFAClient response;
-    int receiveStatus = tfaClient->receive(tfaClient, (UserMessage *) &response);
-    if (receiveStatus == DOMAIN_FAILURE) {
+    int requestStatus = tfaClient->request(tfaClient, (UserMessage *) &requestMessage, (UserMessage *) &response);
+    if (requestStatus == DOMAIN_FAILURE) {
         printf("Failed to receive registration, aborting registration...\n");
         return ERROR;
     }
@@ -130,15 +127,8 @@ int registerTFAClient(const unsigned int userID, unsigned long timestamp, unsign
 
     // AS PER REQUIREMENTS, SEND CONFIRMATION AGAIN
     requestMessage.messageType = ackRegTFA;
-    sendStatus = tfaClient->send(tfaClient, (UserMessage *) &requestMessage);
-    if (sendStatus == ERROR) {
-        printf("Key registration failed while sending ack...\n");
-        return ERROR;
-    }
-    printf("Key registration ack sent successful!\n");
-
-    receiveStatus = tfaClient->receive(tfaClient, (UserMessage *) &response);
-    if (receiveStatus == DOMAIN_FAILURE || response.messageType == tfaFailure) {
+    requestStatus = tfaClient->request(tfaClient, (UserMessage *) &requestMessage, (UserMessage *) &response);
+    if (requestStatus == DOMAIN_FAILURE || response.messageType == tfaFailure) {
         printf("Failed to receive final registration confirmation, aborting registration...\n");
         return ERROR;
     }
@@ -147,5 +137,5 @@ int registerTFAClient(const unsigned int userID, unsigned long timestamp, unsign
         "TFA registration successful and finally complete! Received: messageType=%u, userID=%u\n",
         response.messageType, response.userID);
 
-    return sendStatus;
+    return SUCCESS;
 }
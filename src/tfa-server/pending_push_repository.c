@@ -0,0 +1,74 @@
+/**
+* Provides persistence for push authentications awaiting approval
+ **/
+
+#include "pending_push_repository.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "collections/int_map.h"
+#include "shared.h"
+
+typedef struct PendingPush {
+  unsigned int userId;
+  unsigned int requestID; // requestID of the requestAuth to answer
+  ClientHandle requester;
+  Timer timeout;
+} PendingPush;
+
+#define PUSH_OF_TIMER(timerRef) ((PendingPush *) ((char *) (timerRef) - offsetof(PendingPush, timeout)))
+
+static void onPushTimeout(TimerWheel *timers, Timer *timer, void *context);
+
+static IntMap *pushStore = NULL; // userId -> PendingPush
+static TimerWheel *pushTimers = NULL;
+
+int initPendingPushes(TimerWheel *timers) {
+  pushTimers = timers;
+  return pushStore != NULL ? SUCCESS : createMap(&pushStore);
+}
+
+int addPendingPush(const unsigned int userId, const unsigned int requestID, const ClientHandle *requesterIn) {
+  PendingPush *push;
+  if (pushStore->get(pushStore, userId, (void **) &push) != SUCCESS) {
+    push = calloc(1, sizeof(PendingPush));
+    if (push == NULL || pushStore->add(pushStore, userId, push) == ERROR) {
+      free(push);
+      return ERROR;
+    }
+    push->userId = userId;
+  }
+  // a re-sent push replaces the old one, the user approves whichever arrives
+  push->requestID = requestID;
+  push->requester = *requesterIn;
+  pushTimers->schedule(pushTimers, &push->timeout, monotonicMs() + PUSH_TIMEOUT_MS, onPushTimeout, NULL);
+  return SUCCESS;
+}
+
+int takePendingPush(const unsigned int userId, unsigned int *requestIDOut, ClientHandle *requesterOut) {
+  PendingPush *push;
+  if (!pushStore || pushStore->remove(pushStore, userId, (void **) &push) != SUCCESS) {
+    return NOT_FOUND;
+  }
+  pushTimers->cancel(pushTimers, &push->timeout);
+  *requestIDOut = push->requestID;
+  *requesterOut = push->requester;
+  free(push);
+  return SUCCESS;
+}
+
+/**
+ * Discards a push that wasn't approved in time.
+ *
+ * @param timers the server's timers
+ * @param timer the push's timeout
+ * @param context unused
+ */
+static void onPushTimeout(TimerWheel *timers, Timer *timer, void *context) {
+  PendingPush *push = PUSH_OF_TIMER(timer);
+  printf("Push auth for userId=%u was not approved in time, discarding...\n", push->userId);
+  pushStore->remove(pushStore, push->userId, (void **) &push);
+  free(push);
+}
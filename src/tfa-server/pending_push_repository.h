@@ -0,0 +1,43 @@
+/**
+ * Tracks push authentications sent to TFA clients that are still waiting on the user's approval, one per user. Each
+ * push is discarded once PUSH_TIMEOUT_MS passes without approval, by a timer on the server's event loop.
+ */
+
+#ifndef COSC522_LODI_PENDING_PUSH_REPOSITORY_H
+#define COSC522_LODI_PENDING_PUSH_REPOSITORY_H
+
+#include "domain/domain.h"
+#include "domain/tfa.h"
+#include "domain/timer_wheel.h"
+
+#define PUSH_TIMEOUT_MS TFA_PUSH_TIMEOUT_MS
+
+/**
+ * Prepares the repository for use.
+ *
+ * @param timers wheel push timeouts are scheduled on
+ * @return SUCCESS or ERROR
+ */
+int initPendingPushes(TimerWheel *timers);
+
+/**
+ * Records a push that has just been sent, replacing any push still pending for the user.
+ *
+ * @param userId user the push was sent to
+ * @param requestID requestID of the Lodi server's requestAuth
+ * @param requesterIn Lodi server to answer once the user approves
+ * @return SUCCESS or ERROR
+ */
+int addPendingPush(unsigned int userId, unsigned int requestID, const ClientHandle *requesterIn);
+
+/**
+ * Removes the pending push for a user, e.g. once they've approved it.
+ *
+ * @param userId user the push was sent to
+ * @param requestIDOut requestID of the Lodi server's requestAuth
+ * @param requesterOut Lodi server that requested the push
+ * @return SUCCESS, or NOT_FOUND if no push is pending, e.g. because it already expired
+ */
+int takePendingPush(unsigned int userId, unsigned int *requestIDOut, ClientHandle *requesterOut);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+* Provides persistence for TFA client registrations in progress
+ **/
+
+#include "registration_handshake_repository.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "collections/int_map.h"
+#include "shared.h"
+
+#define HANDSHAKE_OF_TIMER(timerRef) ((Handshake *) ((char *) (timerRef) - offsetof(Handshake, timeout)))
+
+static void startStepTimeout(Handshake *handshake);
+
+static void onStepTimeout(TimerWheel *timers, Timer *timer, void *context);
+
+static IntMap *handshakeStore = NULL; // userId -> Handshake
+static TimerWheel *handshakeTimers = NULL;
+static HandshakeExpiry handshakeExpiry = NULL;
+
+int initHandshakes(TimerWheel *timers, const HandshakeExpiry onExpired) {
+  handshakeTimers = timers;
+  handshakeExpiry = onExpired;
+  return handshakeStore != NULL ? SUCCESS : createMap(&handshakeStore);
+}
+
+Handshake *startHandshake(const unsigned int userId, const ClientHandle *clientIn, const unsigned int requestID,
+                          const unsigned long timestamp, const unsigned long digitalSig) {
+  Handshake *handshake = getHandshake(userId);
+  if (handshake == NULL) {
+    handshake = calloc(1, sizeof(Handshake));
+    if (handshake == NULL || handshakeStore->add(handshakeStore, userId, handshake) == ERROR) {
+      free(handshake);
+      return NULL;
+    }
+    handshake->userId = userId;
+  }
+  handshake->state = AWAITING_PUBLIC_KEY;
+  handshake->client = *clientIn;
+  handshake->requestID = requestID;
+  handshake->timestamp = timestamp;
+  handshake->digitalSig = digitalSig;
+  startStepTimeout(handshake);
+  return handshake;
+}
+
+Handshake *getHandshake(const unsigned int userId) {
+  Handshake *handshake;
+  if (!handshakeStore || handshakeStore->get(handshakeStore, userId, (void **) &handshake) != SUCCESS) {
+    return NULL;
+  }
+  return handshake;
+}
+
+void advanceHandshake(Handshake *handshake, const enum HandshakeState state) {
+  handshake->state = state;
+  startStepTimeout(handshake);
+}
+
+void endHandshake(Handshake *handshake) {
+  handshakeTimers->cancel(handshakeTimers, &handshake->timeout);
+  handshakeStore->remove(handshakeStore, handshake->userId, (void **) &handshake);
+  free(handshake);
+}
+
+static void startStepTimeout(Handshake *handshake) {
+  handshakeTimers->schedule(handshakeTimers, &handshake->timeout, monotonicMs() + REGISTRATION_STEP_TIMEOUT_MS,
+                            onStepTimeout, NULL);
+}
+
+/**
+ * Hands a handshake whose current step has timed out to the expiry handler.
+ *
+ * @param timers the server's timers
+ * @param timer the handshake's timeout
+ * @param context unused
+ */
+static void onStepTimeout(TimerWheel *timers, Timer *timer, void *context) {
+  handshakeExpiry(HANDSHAKE_OF_TIMER(timer));
+}
@@ -0,0 +1,79 @@
+/**
+ * Tracks TFA client registrations that are part way through their handshake, one per user. Each step of a handshake
+ * has REGISTRATION_STEP_TIMEOUT_MS to complete, timed by a timer on the server's event loop.
+ */
+
+#ifndef COSC522_LODI_REGISTRATION_HANDSHAKE_REPOSITORY_H
+#define COSC522_LODI_REGISTRATION_HANDSHAKE_REPOSITORY_H
+
+#include "domain/domain.h"
+#include "domain/timer_wheel.h"
+
+#define REGISTRATION_STEP_TIMEOUT_MS DEFAULT_TIMEOUT_MS
+
+enum HandshakeState {
+  AWAITING_PUBLIC_KEY, // waiting on the PKE server for the user's public key
+  AWAITING_ACK // confirmTFA sent, waiting on the client's ackRegTFA
+};
+
+typedef struct Handshake {
+  unsigned int userId;
+  enum HandshakeState state;
+  ClientHandle client; // TFA client registering
+  unsigned int requestID; // requestID of the client's registerTFA
+  unsigned long timestamp; // registration request's nonce
+  unsigned long digitalSig; // registration request's signature over the nonce
+  Timer timeout; // times the current step
+} Handshake;
+
+/**
+ * Called once a handshake's current step has timed out. The handshake is still recorded, so the handler must end it.
+ *
+ * @param handshake the expired handshake
+ */
+typedef void (*HandshakeExpiry)(Handshake *handshake);
+
+/**
+ * Prepares the repository for use.
+ *
+ * @param timers wheel handshake timeouts are scheduled on
+ * @param onExpired handler for handshakes that time out
+ * @return SUCCESS or ERROR
+ */
+int initHandshakes(TimerWheel *timers, HandshakeExpiry onExpired);
+
+/**
+ * Starts a handshake in the AWAITING_PUBLIC_KEY state, abandoning any handshake already under way for the user.
+ *
+ * @param userId user registering
+ * @param clientIn TFA client registering
+ * @param requestID requestID of the registerTFA request
+ * @param timestamp registration request's nonce
+ * @param digitalSig registration request's signature
+ * @return the handshake, or NULL on allocation failure
+ */
+Handshake *startHandshake(unsigned int userId, const ClientHandle *clientIn, unsigned int requestID,
+                          unsigned long timestamp, unsigned long digitalSig);
+
+/**
+ * @param userId user registering
+ * @return the user's handshake, or NULL if none is under way
+ */
+Handshake *getHandshake(unsigned int userId);
+
+/**
+ * Moves a handshake on to its next step, restarting its timeout.
+ *
+ * @param handshake handshake to advance
+ * @param state the next step
+ */
+void advanceHandshake(Handshake *handshake, enum HandshakeState state);
+
+/**
+ * Removes and frees a handshake, whether it completed or failed.
+ *
+ * @param handshake handshake to end
+ */
+void endHandshake(Handshake *handshake);
+
+#endif
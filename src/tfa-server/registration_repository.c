@@ -26,6 +26,7 @@ int registerClient(const unsigned int userId, const ClientHandle *clientHandleIn
   ClientHandle *toPersist = malloc(sizeof(ClientHandle));
   memcpy(toPersist, clientHandleIn, sizeof(ClientHandle));
 
+  clientStore->remove(clientStore, userId, NULL); // a re-registration replaces the previous handle
   return clientStore->add(clientStore, userId, (void *) toPersist);
 }
 
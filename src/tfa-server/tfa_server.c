@@ -4,6 +4,11 @@
  *   1)  Registers client ip addresses and ports
  *   2)  Handles login authentication requests from the Lodi server
  *     i) Interfaces with registered TFA Clients to confirm the push authentication
+ *
+ * Nothing is waited on in place: pushes awaiting approval are kept in a pending-push table, and registrations are
+ * tracked as per-client handshakes that advance as PKE replies and client acks arrive. Both time out on the server's
+ * timers, and the server carries on receiving throughout, so any number of users can be registering or deciding on a
+ * push at once.
  **/
 
 #include <stdio.h>
@@ -11,14 +16,30 @@
 
 #include "domain/tfa.h"
 #include "domain/pke.h"
+#include "pending_push_repository.h"
+#include "registration_handshake_repository.h"
 #include "registration_repository.h"
 #include "shared.h"
 #include "util/rsa.h"
 
 void handleRegisterTfa(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle);
 
+void handleRegisterAck(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle);
+
+static void onPublicKeyReply(DomainServer *server, int pkeFd, void *context);
+
+static void flushVerifications(Handshake **handshakes, SignatureCheck *checks, int *count);
+
+static void failHandshake(Handshake *handshake);
+
+static void onHandshakeTimeout(Handshake *handshake);
+
 void handlePushTfa(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle);
 
+void handlePushAck(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle);
+
+#define VERIFY_BATCH_SIZE 64
+
 static DomainClient *pkeClient = NULL;
 static DomainServer *tfaServer = NULL;
 
@@ -29,7 +50,10 @@ int main() {
     if (initPkeClient(&pkeClient) == ERROR
         || pkeClient->base.start(&pkeClient->base) == ERROR
         || initTFAServerDomain(&tfaServer) == ERROR
-        || tfaServer->base.start(&tfaServer->base) == ERROR) {
+        || tfaServer->base.start(&tfaServer->base) == ERROR
+        || tfaServer->watch(tfaServer, pkeClient->base.sock, onPublicKeyReply, NULL) == DOMAIN_FAILURE
+        || initPendingPushes(tfaServer->timers) == ERROR
+        || initHandshakes(tfaServer->timers, onHandshakeTimeout) == ERROR) {
         printf("Error while initializing TFA Server\n");
         exit(ERROR);
     }
@@ -41,47 +65,183 @@ int main() {
             printf("Failed to handle incoming message, continuing...\n");
         } else if (request.messageType == registerTFA) {
             handleRegisterTfa(&request, &clientHandle);
+        } else if (request.messageType == ackRegTFA) {
+            handleRegisterAck(&request, &clientHandle);
         } else if (request.messageType == requestAuth) {
             handlePushTfa(&request, &clientHandle);
+        } else if (request.messageType == ackPushTFA) {
+            handlePushAck(&request, &clientHandle);
         }
     }
 }
 
+/**
+ * Starts a TFA client's registration handshake by looking up the user's public key. The handshake carries on in
+ * onPublicKeyReply.
+ */
 void handleRegisterTfa(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle) {
-    unsigned int publicKey;
+    printf("Received registerTFA message\n");
+    const Handshake *previous = getHandshake(request->userID);
+    // a handshake restarted before its key arrived can use the lookup already in flight
+    const bool isLookupPending = previous != NULL && previous->state == AWAITING_PUBLIC_KEY;
+
+    Handshake *handshake = startHandshake(request->userID, clientHandle, request->requestID, request->timestamp,
+                                          request->digitalSig);
+    if (handshake == NULL) {
+        const TFAServerToTFAClient response = {
+            tfaFailure,
+            request->userID,
+            request->requestID
+        };
+        tfaServer->send(tfaServer, (UserMessage *) &response, clientHandle);
+        return;
+    }
+    if (!isLookupPending) {
+        PClientToPKServer keyRequest = {
+            .messageType = requestKey,
+            .userID = request->userID
+        };
+        if (pkeClient->submit(pkeClient, (UserMessage *) &keyRequest, tfaServer->timers, REGISTRATION_STEP_TIMEOUT_MS)
+            == DOMAIN_FAILURE) {
+            printf("Failed to get public key from PKE server...\n");
+            failHandshake(handshake);
+        }
+    }
+}
+
+/**
+ * Called from the server's receive loop whenever the PKE server has replied. Authenticates the registration waiting on
+ * each public key, and asks the TFA client to acknowledge. The signatures of every registration answered by the
+ * replies at hand are verified together, in batches.
+ */
+static void onPublicKeyReply(DomainServer *server, const int pkeFd, void *context) {
+    Handshake *handshakes[VERIFY_BATCH_SIZE];
+    SignatureCheck checks[VERIFY_BATCH_SIZE];
+    int count = 0;
+    PKServerToLodiClient keyResponse;
+    int receiveStatus;
+    while ((receiveStatus = pkeClient->receiveAvailable(pkeClient, (UserMessage *) &keyResponse)) != WOULD_BLOCK) {
+        if (receiveStatus != DOMAIN_SUCCESS) {
+            continue;
+        }
+        Handshake *handshake = getHandshake(keyResponse.userID);
+        if (handshake == NULL || handshake->state != AWAITING_PUBLIC_KEY) {
+            printf("Received public key nobody is waiting for, userId=%u, discarding...\n", keyResponse.userID);
+            continue;
+        }
+        // a duplicate reply for a handshake already queued is dropped, the handshake stays in AWAITING_PUBLIC_KEY
+        bool isQueued = false;
+        for (int i = 0; i < count && !isQueued; i++) {
+            isQueued = handshakes[i] == handshake;
+        }
+        if (isQueued) {
+            continue;
+        }
+        if (keyResponse.messageType == ackPKFail) {
+            printf("Failed to get public key from PKE server...\n");
+            failHandshake(handshake);
+            continue;
+        }
+        handshakes[count] = handshake;
+        checks[count++] = (SignatureCheck){
+            .digitalSig = handshake->digitalSig,
+            .publicKey = keyResponse.publicKey,
+            .timestamp = handshake->timestamp
+        };
+        if (count == VERIFY_BATCH_SIZE) {
+            flushVerifications(handshakes, checks, &count);
+        }
+    }
+    flushVerifications(handshakes, checks, &count);
+}
+
+/**
+ * Verifies the signatures of registrations whose public keys have arrived, asking the TFA client of each authentic one
+ * to acknowledge.
+ *
+ * @param handshakes the registrations, awaiting their public keys
+ * @param checks the registrations' signatures
+ * @param count number of registrations, reset to 0
+ */
+static void flushVerifications(Handshake **handshakes, SignatureCheck *checks, int *count) {
+    bool isValid[VERIFY_BATCH_SIZE];
+    verifySignatures(checks, *count, MODULUS, isValid);
+    for (int i = 0; i < *count; i++) {
+        Handshake *handshake = handshakes[i];
+        if (!isValid[i]) {
+            printf("Authentication failed! Aborting TFA client registration...\n");
+            failHandshake(handshake);
+            continue;
+        }
 
-    TFAServerToTFAClient response = {
+        const TFAServerToTFAClient response = {
+            confirmTFA,
+            handshake->userId,
+            handshake->requestID
+        };
+        if (tfaServer->send(tfaServer, (UserMessage *) &response, &handshake->client) == ERROR) {
+            printf("Error while sending initial auth message to TFA Client.\n");
+            failHandshake(handshake);
+            continue;
+        }
+        advanceHandshake(handshake, AWAITING_ACK);
+    }
+    *count = 0;
+}
+
+/**
+ * Completes a registration handshake once the TFA client acknowledges.
+ */
+void handleRegisterAck(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle) {
+    Handshake *handshake = getHandshake(request->userID);
+    if (handshake == NULL
+        || handshake->state != AWAITING_ACK
+        || handshake->client.clientAddr.sin_addr.s_addr != clientHandle->clientAddr.sin_addr.s_addr
+        || handshake->client.clientAddr.sin_port != clientHandle->clientAddr.sin_port) {
+        printf("Did not expect ack register message for userId=%u, discarding...\n", request->userID);
+        return;
+    }
+    printf("Received expected ack register message! Finishing registration.\n");
+    registerClient(request->userID, &handshake->client);
+    printf("Registered client! Sending final TFA confirmation message!\n");
+
+    const TFAServerToTFAClient response = {
         confirmTFA,
-        clientHandle->userID,
+        request->userID,
+        request->requestID
     };
-    tfaServer->base.changeTimeout(&tfaServer->base, DEFAULT_TIMEOUT_MS);
-    if (getPublicKey(pkeClient, clientHandle->userID, &publicKey) == ERROR) {
-        printf("Failed to get public key from PKE server...\n");
-        response.messageType = tfaFailure;
-    } else if (decryptTimestamp( request->digitalSig, publicKey, MODULUS) != request->timestamp) {
-        printf("Authentication failed! Aborting TFA client registration...\n");
-        response.messageType = tfaFailure;
-    } else if (tfaServer->send(tfaServer, (UserMessage *) &response, clientHandle) == ERROR) {
-        printf("Error while sending initial auth message to TFA Client.\n");
-        response.messageType = tfaFailure;
-    } else if (tfaServer->receive(tfaServer, (UserMessage *) request, clientHandle) == ERROR) {
-        printf("Failed to handle incoming ACK TFAClientOrLodiServerToTFAServer message.\n");
-        response.messageType = tfaFailure;
-    } else if (request->messageType != ackRegTFA) {
-        printf("Did not receive expected ack register message, aborting registration...\n");
-        response.messageType = tfaFailure;
-    } else {
-        printf("Received expected ack register message! Finishing registration.\n");
-        registerClient(request->userID, clientHandle);
-        printf("Registered client! Sending final TFA confirmation message!\n");
-        response.messageType = confirmTFA;
+    if (tfaServer->send(tfaServer, (UserMessage *) &response, &handshake->client) == ERROR) {
+        printf("Warning: error while sending final message during client registration.\n");
     }
-    if (tfaServer->send(tfaServer, (UserMessage *) &response, clientHandle) == ERROR) {
+    endHandshake(handshake);
+}
+
+/**
+ * Tells a TFA client its registration failed, and ends the handshake.
+ */
+static void failHandshake(Handshake *handshake) {
+    const TFAServerToTFAClient response = {
+        tfaFailure,
+        handshake->userId,
+        handshake->requestID
+    };
+    if (tfaServer->send(tfaServer, (UserMessage *) &response, &handshake->client) == ERROR) {
         printf("Warning: error while sending final message during client registration.\n");
     }
-    tfaServer->base.changeTimeout(&tfaServer->base, 0);
+    endHandshake(handshake);
 }
 
+/**
+ * Called from the server's receive loop when a registration step times out.
+ */
+static void onHandshakeTimeout(Handshake *handshake) {
+    printf("Registration for userId=%u timed out, aborting...\n", handshake->userId);
+    failHandshake(handshake);
+}
+
+/**
+ * Sends a push to the user's TFA client. The Lodi server is answered by handlePushAck once the user approves.
+ */
 void handlePushTfa(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle) {
     printf("Received requestAuth message\n");
     ClientHandle *tfaClientHandle;
@@ -92,33 +252,46 @@ void handlePushTfa(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clie
 
     TFAServerToTFAClient pushRequest = {
         .messageType = pushTFA,
-        request->userID,
+        .userID = request->userID,
+        .requestID = 0 // sent unprompted, there's no request to answer
     };
-    int sendSuccess = tfaServer->send(tfaServer, (UserMessage *) &pushRequest, tfaClientHandle);
-    if (sendSuccess == DOMAIN_FAILURE) {
+    if (tfaServer->send(tfaServer, (UserMessage *) &pushRequest, tfaClientHandle) == DOMAIN_FAILURE) {
         printf("Failed to send push auth request to TFA client, aborting...\n");
         return;
     }
+    if (addPendingPush(request->userID, request->requestID, clientHandle) == ERROR) {
+        printf("Failed to record push auth request, aborting...\n");
+        return;
+    }
     printf("sent pushTFA message\n");
+}
 
-    TFAClientOrLodiServerToTFAServer pushResponse;
-    if (tfaServer->receive(tfaServer, (UserMessage *) &pushResponse, tfaClientHandle) == ERROR) {
-        printf("Error while receiving TFA client push auth message.\n");
+/**
+ * Answers the Lodi server waiting on a push, once the user's TFA client approves it.
+ */
+void handlePushAck(TFAClientOrLodiServerToTFAServer *request, ClientHandle *clientHandle) {
+    ClientHandle *tfaClientHandle;
+    if (getClient(request->userID, &tfaClientHandle) != SUCCESS
+        || tfaClientHandle->clientAddr.sin_addr.s_addr != clientHandle->clientAddr.sin_addr.s_addr
+        || tfaClientHandle->clientAddr.sin_port != clientHandle->clientAddr.sin_port) {
+        printf("Received ackPushTFA message from a client not registered for userId=%u, discarding...\n",
+               request->userID);
         return;
     }
-
-    if (pushResponse.messageType != ackPushTFA) {
-        printf("Did not receive expected ack push message, aborting push auth...\n");
+    unsigned int lodiRequestID;
+    ClientHandle lodiHandle;
+    if (takePendingPush(request->userID, &lodiRequestID, &lodiHandle) != SUCCESS) {
+        printf("Received ackPushTFA message with no pending push for userId=%u, discarding...\n", request->userID);
         return;
     }
     printf("Received ackPushTFA message\n");
 
     TFAServerToLodiServer pushNotificationResponse = {
         responseAuth,
-        request->userID
+        request->userID,
+        lodiRequestID
     };
-    sendSuccess = tfaServer->send(tfaServer, (UserMessage *) &pushNotificationResponse, clientHandle);
-    if (sendSuccess == ERROR) {
+    if (tfaServer->send(tfaServer, (UserMessage *) &pushNotificationResponse, &lodiHandle) == ERROR) {
         printf("Error while sending push response to Lodi server\n");
     }
     printf("ResponseAuth message\n");